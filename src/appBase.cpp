@@ -27,11 +27,18 @@ void VkAppBase::saveScreenshot(const char* filename)
 	screenshotSaved = false;
 	bool supportsBlit = true;
 
+	// The source image may still be written by a frame in flight
+	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+
 	// Check blit support for source and destination
 	VkFormatProperties formatProps;
 
+	// The color target is either the acquired swap chain image or the offscreen image in headless mode
+	VkFormat srcFormat = settings.headless ? offscreen.format : swapChain.colorFormat;
+	VkImageLayout srcLayout = settings.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
 	// Check if the device supports blitting from optimal images (the swapchain images are in optimal format)
-	vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChain.colorFormat, &formatProps);
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, srcFormat, &formatProps);
 	if (!(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT)) {
 		std::cerr << "Device does not support blitting from optimal tiled images, using copy instead of blit!" << std::endl;
 		supportsBlit = false;
@@ -45,7 +52,7 @@ void VkAppBase::saveScreenshot(const char* filename)
 	}
 
 	// Source for the copy is the last rendered swapchain image
-	VkImage srcImage = swapChain.images[currentBuffer];
+	VkImage srcImage = settings.headless ? offscreen.image : swapChain.images[currentBuffer];
 
 	// Create the linear tiled destination image to copy to and to read the memory from
 	VkImageCreateInfo imageCreateCI(vks::initializers::imageCreateInfo());
@@ -96,7 +103,7 @@ void VkAppBase::saveScreenshot(const char* filename)
 		srcImage,
 		VK_ACCESS_MEMORY_READ_BIT,
 		VK_ACCESS_TRANSFER_READ_BIT,
-		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		srcLayout,
 		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -167,7 +174,7 @@ void VkAppBase::saveScreenshot(const char* filename)
 		VK_ACCESS_TRANSFER_READ_BIT,
 		VK_ACCESS_MEMORY_READ_BIT,
 		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		srcLayout,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
 		VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
@@ -196,7 +203,7 @@ void VkAppBase::saveScreenshot(const char* filename)
 	if (!supportsBlit)
 	{
 		std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
-		colorSwizzle = (std::find(formatsBGR.begin(), formatsBGR.end(), swapChain.colorFormat) != formatsBGR.end());
+		colorSwizzle = (std::find(formatsBGR.begin(), formatsBGR.end(), srcFormat) != formatsBGR.end());
 	}
 
 	// ppm binary pixel data
@@ -248,12 +255,15 @@ VkResult VkAppBase::createInstance(bool enableValidation)
 	appInfo.pEngineName = name.c_str();
 	appInfo.apiVersion = apiVersion;
 
-	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+	std::vector<const char*> instanceExtensions;
 
-	// Enable surface extensions depending on os
+	// Enable surface extensions depending on os (headless rendering doesn't present and needs none)
+	if (!settings.headless) {
+		instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #if defined(_WIN32)
-	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #endif
+	}
 
 	// Get extensions supported by the instance and store for later use
 	uint32_t extCount = 0;
@@ -288,12 +298,12 @@ VkResult VkAppBase::createInstance(bool enableValidation)
 	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instanceCreateInfo.pNext = NULL;
 	instanceCreateInfo.pApplicationInfo = &appInfo;
+	if (settings.validation)
+	{
+		instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	}
 	if (instanceExtensions.size() > 0)
 	{
-		if (settings.validation)
-		{
-			instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-		}
 		instanceCreateInfo.enabledExtensionCount = (uint32_t)instanceExtensions.size();
 		instanceCreateInfo.ppEnabledExtensionNames = instanceExtensions.data();
 	}
@@ -327,10 +337,12 @@ VkResult VkAppBase::createInstance(bool enableValidation)
 
 void VkAppBase::renderFrame()
 {
-	VkAppBase::prepareFrame();
+	if (!VkAppBase::prepareFrame()) {
+		return;
+	}
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	submitInfo.pCommandBuffers = &drawCmdBuffers[currentFrame];
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentFrame]));
 	VkAppBase::submitFrame();
 }
 
@@ -347,8 +359,8 @@ std::string VkAppBase::getWindowTitle()
 
 void VkAppBase::createCommandBuffers()
 {
-	// Create one command buffer for each swap chain image and reuse for rendering
-	drawCmdBuffers.resize(swapChain.imageCount);
+	// Create one command buffer for each frame in flight, re-recorded once its fence has been waited on
+	drawCmdBuffers.resize(settings.framesInFlight);
 
 	VkCommandBufferAllocateInfo cmdBufAllocateInfo =
 		vks::initializers::commandBufferAllocateInfo(
@@ -381,15 +393,30 @@ void VkAppBase::prepare()
 	if (vulkanDevice->enableDebugMarkers) {
 		vks::debugmarker::setup(device);
 	}
-	initSwapchain();
+	if (!settings.headless) {
+		initSwapchain();
+	}
 	createCommandPool();
-	setupSwapChain();
+	if (!settings.headless) {
+		setupSwapChain();
+		// More frames in flight than swap chain images would only wait on image acquisition
+		settings.framesInFlight = std::min(settings.framesInFlight, swapChain.imageCount);
+	}
+	settings.framesInFlight = std::max(settings.framesInFlight, 1u);
 	createCommandBuffers();
 	createSynchronizationPrimitives();
 	setupDepthStencil();
 	setupRenderPass();
 	createPipelineCache();
 	setupFrameBuffer();
+	// GPU scope profiling, pipeline statistics are only available if the example enabled the feature
+	benchmark.profiler.prepare(
+		device,
+		deviceProperties.limits.timestampPeriod,
+		vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits,
+		settings.framesInFlight,
+		enabledFeatures.pipelineStatisticsQuery == VK_TRUE);
+	assetLoader.prepare(vulkanDevice);
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
@@ -455,7 +482,7 @@ void VkAppBase::nextFrame()
 	{
 		lastFPS = static_cast<uint32_t>((float)frameCounter * (1000.0f / fpsTimer));
 #if defined(_WIN32)
-		if (!settings.overlay) {
+		if (!settings.overlay && !settings.headless) {
 			std::string windowTitle = getWindowTitle();
 			SetWindowText(window, windowTitle.c_str());
 		}
@@ -467,11 +494,48 @@ void VkAppBase::nextFrame()
 	updateOverlay();
 }
 
+void VkAppBase::runBenchmarkSweep()
+{
+	std::vector<VkExtent2D> resolutions = benchmark.sweepResolutions;
+	if (resolutions.empty()) {
+		resolutions.push_back({ width, height });
+	}
+	for (VkExtent2D resolution : resolutions) {
+		if ((resolution.width != width) || (resolution.height != height)) {
+			if (!settings.headless) {
+				// The swap chain extent follows the window, only the offscreen target can be resized freely
+				std::cerr << "Resolution sweeps require headless mode, skipping " << resolution.width << "x" << resolution.height << "\n";
+				continue;
+			}
+			destWidth = resolution.width;
+			destHeight = resolution.height;
+			windowResize();
+		}
+		uint32_t configurationCount = getBenchmarkSweepConfigurationCount();
+		for (uint32_t i = 0; i < configurationCount; i++) {
+			std::string configuration = applyBenchmarkSweepConfiguration(i);
+			std::cout << "\n" << "Sweep configuration: " << configuration << " (" << width << "x" << height << ")" << "\n";
+			benchmark.run([=] { render(); }, vulkanDevice->properties);
+			vkDeviceWaitIdle(device);
+			benchmark.addSweepResult(configuration, width, height);
+		}
+	}
+	benchmark.printSweepResults(std::cout);
+	if (benchmark.filename != "") {
+		benchmark.saveSweepResults();
+	}
+}
+
 void VkAppBase::renderLoop()
 {
+	if (benchmark.active && benchmark.sweep) {
+		runBenchmarkSweep();
+		return;
+	}
 	if (benchmark.active) {
 		benchmark.run([=] { render(); }, vulkanDevice->properties);
 		vkDeviceWaitIdle(device);
+		vulkanDevice->allocator.printStats();
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
 		}
@@ -481,20 +545,42 @@ void VkAppBase::renderLoop()
 	destWidth = width;
 	destHeight = height;
 	lastTimestamp = std::chrono::high_resolution_clock::now();
-#if defined(_WIN32)
-	MSG msg;
-	bool quitMessageReceived = false;
-	while (!quitMessageReceived) {
-		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
-			TranslateMessage(&msg);
-			DispatchMessage(&msg);
-			if (msg.message == WM_QUIT) {
-				quitMessageReceived = true;
+	if (settings.headless) {
+		// No window messages to pump, render a fixed number of frames or for a fixed duration
+		auto tStart = std::chrono::high_resolution_clock::now();
+		uint32_t renderedFrames = 0;
+		double elapsed = 0.0;
+		while (prepared) {
+			nextFrame();
+			renderedFrames++;
+			elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			if (settings.headlessDuration > 0) {
+				if (elapsed >= settings.headlessDuration * 1000.0) {
+					break;
+				}
+			}
+			else if (renderedFrames >= settings.headlessFrames) {
 				break;
 			}
 		}
-		if (prepared && !IsIconic(window)) {
-			nextFrame();
+		std::cout << "Rendered " << renderedFrames << " headless frames in " << elapsed << " ms\n";
+	}
+#if defined(_WIN32)
+	else {
+		MSG msg;
+		bool quitMessageReceived = false;
+		while (!quitMessageReceived) {
+			while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+				if (msg.message == WM_QUIT) {
+					quitMessageReceived = true;
+					break;
+				}
+			}
+			if (prepared && !IsIconic(window)) {
+				nextFrame();
+			}
 		}
 	}
 #endif
@@ -558,33 +644,76 @@ void VkAppBase::drawUI(const VkCommandBuffer commandBuffer)
 	}
 }
 
-void VkAppBase::prepareFrame()
+bool VkAppBase::prepareFrame()
 {
-	// Acquire the next image from the swap chain
-	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
-	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
-	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
-		windowResize();
+	// Record the uploads of assets the background loader has finished decoding
+	assetLoader.update();
+
+	// Uploads recorded since the last frame go to the queues ahead of this frame's rendering
+	// Copies on the dedicated transfer queue run alongside rendering, only the graphics batch acquiring their resources waits for them
+	vulkanDevice->asyncTransfer.submit();
+	vulkanDevice->transfer.submit();
+
+	// Wait until the GPU has finished with the resources of this frame in flight
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentFrame], VK_TRUE, UINT64_MAX));
+
+	if (settings.headless) {
+		// There is no presentation engine, so the frame's submission neither waits for image availability nor signals a present
+		// Frames are ordered by submission on the queue and the offscreen dependency of the render pass
+		currentBuffer = 0;
+		submitInfo.waitSemaphoreCount = 0;
+		submitInfo.pWaitSemaphores = nullptr;
+		submitInfo.signalSemaphoreCount = 0;
+		submitInfo.pSignalSemaphores = nullptr;
 	}
 	else {
-		VK_CHECK_RESULT(result);
-	}
-}
-
-void VkAppBase::submitFrame()
-{
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
-	if (!((result == VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR))) {
+		// Acquire the next image from the swap chain
+		VkResult result = swapChain.acquireNextImage(semaphores.presentComplete[currentFrame], &currentBuffer);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-			// Swap chain is no longer compatible with the surface and needs to be recreated
+			// The swap chain is no longer compatible with the surface and no image has been acquired, so the semaphore won't be signaled
+			// The frame is skipped, its fence hasn't been reset yet and stays signaled for the next attempt
 			windowResize();
-			return;
+			return false;
 		}
-		else {
+		if (result != VK_SUBOPTIMAL_KHR) {
 			VK_CHECK_RESULT(result);
 		}
+		// A suboptimal swap chain can still be presented to, it is recreated after the image has been presented (see submitFrame)
+		swapChainSuboptimal = (result == VK_SUBOPTIMAL_KHR);
+
+		// Point the default submit info at this frame's semaphores
+		// The render complete semaphore belongs to the image, as only reacquiring the image guarantees that its last present has consumed it
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &semaphores.presentComplete[currentFrame];
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &semaphores.renderComplete[currentBuffer];
+	}
+
+	// The frame will be submitted now, which signals the fence again
+	VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentFrame]));
+	return true;
+}
+
+void VkAppBase::submitFrame()
+{
+	if (settings.headless) {
+		// Nothing to present
+		currentFrame = (currentFrame + 1) % settings.framesInFlight;
+		return;
+	}
+
+	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete[currentBuffer]);
+	// No wait idle here, the fence of a frame in flight is only waited on once its resources are reused
+	currentFrame = (currentFrame + 1) % settings.framesInFlight;
+	// Recreate the swap chain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
+	// The present still waits on the render complete semaphore in both cases
+	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR) || swapChainSuboptimal) {
+		swapChainSuboptimal = false;
+		windowResize();
+	}
+	else {
+		VK_CHECK_RESULT(result);
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 }
 
 VkAppBase::VkAppBase(bool enableValidation)
@@ -604,6 +733,11 @@ VkAppBase::VkAppBase(bool enableValidation)
 
 	settings.validation = enableValidation;
 
+#if !defined(_WIN32)
+	// Window and surface creation is only implemented for Windows
+	settings.headless = true;
+#endif
+
 	// Command line arguments
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -657,14 +791,54 @@ VkAppBase::VkAppBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("benchmarksweep")) {
+		benchmark.active = true;
+		benchmark.sweep = true;
+		vks::tools::errorModeSilent = true;
+	}
+	if (commandLineParser.isSet("benchmarksweepvalues")) {
+		// Comma separated list, e.g. "1,2,4,8,16,32,64"
+		std::stringstream values(commandLineParser.getValueAsString("benchmarksweepvalues", ""));
+		std::string value;
+		while (std::getline(values, value, ',')) {
+			benchmark.sweepValues.push_back(static_cast<uint32_t>(strtoul(value.c_str(), nullptr, 10)));
+		}
+	}
+	if (commandLineParser.isSet("benchmarksweepresolutions")) {
+		// Comma separated list of WIDTHxHEIGHT, e.g. "1280x720,1920x1080"
+		std::stringstream values(commandLineParser.getValueAsString("benchmarksweepresolutions", ""));
+		std::string value;
+		while (std::getline(values, value, ',')) {
+			VkExtent2D resolution{};
+			if (sscanf(value.c_str(), "%ux%u", &resolution.width, &resolution.height) == 2) {
+				benchmark.sweepResolutions.push_back(resolution);
+			}
+			else {
+				std::cerr << "Invalid sweep resolution \"" << value << "\", expected WIDTHxHEIGHT\n";
+			}
+		}
+	}
+	if (commandLineParser.isSet("headless")) {
+		settings.headless = true;
+	}
+	if (commandLineParser.isSet("headlessframes")) {
+		settings.headlessFrames = commandLineParser.getValueAsInt("headlessframes", settings.headlessFrames);
+	}
+	if (commandLineParser.isSet("headlessduration")) {
+		settings.headlessDuration = commandLineParser.getValueAsInt("headlessduration", settings.headlessDuration);
+	}
+	if (commandLineParser.isSet("framesinflight")) {
+		// At least one frame has to be in flight, the upper bound is the swap chain's image count (see prepare())
+		settings.framesInFlight = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("framesinflight", settings.framesInFlight), 1));
+	}
 	///@William
 	if (commandLineParser.isSet("sourcefile")) {
 		benchmark.sourcefile = commandLineParser.getValueAsString("sourcefile", benchmark.sourcefile);
 	}
 
 #if defined(_WIN32)
-	// Enable console if validation is active, debug message callback will output to it
-	if (this->settings.validation)
+	// Enable console if validation is active or running headless, debug message callback and results will output to it
+	if (this->settings.validation || this->settings.headless)
 	{
 		setupConsole("Vulkan App");
 	}
@@ -675,7 +849,10 @@ VkAppBase::VkAppBase(bool enableValidation)
 VkAppBase::~VkAppBase()
 {
 	// Clean up Vulkan resources
-	swapChain.cleanup();
+	if (!settings.headless) {
+		swapChain.cleanup();
+	}
+	destroyOffscreenTarget();
 	if (descriptorPool != VK_NULL_HANDLE)
 	{
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
@@ -700,14 +877,22 @@ VkAppBase::~VkAppBase()
 
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
+	benchmark.profiler.destroy();
+
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 
-	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
+	for (auto& semaphore : semaphores.presentComplete) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	for (auto& semaphore : semaphores.renderComplete) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
 	for (auto& fence : waitFences) {
 		vkDestroyFence(device, fence, nullptr);
 	}
 
+	assetLoader.destroy();
+
 	if (settings.overlay) {
 		UIOverlay.freeResources();
 	}
@@ -803,7 +988,7 @@ bool VkAppBase::initVulkan()
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
 	vulkanDevice = new vks::VulkanDevice(physicalDevice);
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, !settings.headless);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 		return false;
@@ -817,26 +1002,15 @@ bool VkAppBase::initVulkan()
 	VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
 	assert(validDepthFormat);
 
-	swapChain.connect(instance, physicalDevice, device);
-
-	// Create synchronization objects
-	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queue
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been submitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
+	if (!settings.headless) {
+		swapChain.connect(instance, physicalDevice, device);
+	}
 
 	// Set up submit info structure
-	// Semaphores will stay the same during application lifetime
+	// Semaphores get selected in prepareFrame (headless mode has none)
 	// Command buffer submission info is set by each example
 	submitInfo = vks::initializers::submitInfo();
 	submitInfo.pWaitDstStageMask = &submitPipelineStages;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &semaphores.presentComplete;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &semaphores.renderComplete;
 
 	return true;
 }
@@ -1133,19 +1307,45 @@ void VkAppBase::buildCommandBuffers() {}
 
 void VkAppBase::createSynchronizationPrimitives()
 {
-	// Wait fences to sync command buffer access
+	// Wait fences to sync command buffer access, created signaled so the first wait on each frame in flight returns immediately
 	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-	waitFences.resize(drawCmdBuffers.size());
+	waitFences.resize(settings.framesInFlight);
 	for (auto& fence : waitFences) {
 		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
 	}
+
+	// Create a semaphore per frame in flight used to synchronize image presentation
+	// Ensures that the image is displayed before we start submitting new commands to the queue
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	semaphores.presentComplete.resize(settings.headless ? 0 : settings.framesInFlight);
+	for (auto& semaphore : semaphores.presentComplete) {
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+	}
+
+	createRenderCompleteSemaphores();
+}
+
+void VkAppBase::createRenderCompleteSemaphores()
+{
+	// Create a semaphore per swap chain image used to synchronize command submission
+	// Ensures that the image is not presented until all commands have been submitted and executed
+	// A semaphore per frame in flight could be signaled again while the presentation engine still waits on it, as the frame's fence doesn't cover the present
+	for (auto& semaphore : semaphores.renderComplete) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	semaphores.renderComplete.resize(settings.headless ? 0 : swapChain.imageCount);
+	for (auto& semaphore : semaphores.renderComplete) {
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+	}
 }
 
 void VkAppBase::createCommandPool()
 {
 	VkCommandPoolCreateInfo cmdPoolInfo = {};
 	cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+	// Without a swap chain there is no present queue selection, the graphics queue is used instead
+	cmdPoolInfo.queueFamilyIndex = settings.headless ? vulkanDevice->queueFamilyIndices.graphics : swapChain.queueNodeIndex;
 	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &cmdPool));
 }
@@ -1191,6 +1391,47 @@ void VkAppBase::setupDepthStencil()
 	VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &depthStencil.view));
 }
 
+void VkAppBase::setupOffscreenTarget()
+{
+	destroyOffscreenTarget();
+
+	VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+	imageCI.imageType = VK_IMAGE_TYPE_2D;
+	imageCI.format = offscreen.format;
+	imageCI.extent = { width, height, 1 };
+	imageCI.mipLevels = 1;
+	imageCI.arrayLayers = 1;
+	imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+	// Transfer source is required for screenshots
+	imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &offscreen.image));
+
+	VkMemoryRequirements memReqs{};
+	vkGetImageMemoryRequirements(device, offscreen.image, &memReqs);
+	VK_CHECK_RESULT(vulkanDevice->allocateMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vks::AllocationType::Optimal, &offscreen.allocation));
+	VK_CHECK_RESULT(vkBindImageMemory(device, offscreen.image, offscreen.allocation.memory, offscreen.allocation.offset));
+
+	VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+	imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCI.image = offscreen.image;
+	imageViewCI.format = offscreen.format;
+	imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &offscreen.view));
+}
+
+void VkAppBase::destroyOffscreenTarget()
+{
+	if (offscreen.image == VK_NULL_HANDLE) {
+		return;
+	}
+	vkDestroyImageView(device, offscreen.view, nullptr);
+	vkDestroyImage(device, offscreen.image, nullptr);
+	offscreen.allocation.free();
+	offscreen.image = VK_NULL_HANDLE;
+	offscreen.view = VK_NULL_HANDLE;
+}
+
 void VkAppBase::setupFrameBuffer()
 {
 	VkImageView attachments[2];
@@ -1208,6 +1449,15 @@ void VkAppBase::setupFrameBuffer()
 	frameBufferCreateInfo.height = height;
 	frameBufferCreateInfo.layers = 1;
 
+	if (settings.headless) {
+		// A single offscreen color image stands in for the swap chain images
+		setupOffscreenTarget();
+		attachments[0] = offscreen.view;
+		frameBuffers.resize(1);
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &frameBuffers[0]));
+		return;
+	}
+
 	// Create frame buffers for every swap chain image
 	frameBuffers.resize(swapChain.imageCount);
 	//std::cout << "frameBuffers size =  " << frameBuffers.size() << std::endl;
@@ -1222,14 +1472,15 @@ void VkAppBase::setupRenderPass()
 {
 	std::array<VkAttachmentDescription, 2> attachments = {};
 	// Color attachment
-	attachments[0].format = swapChain.colorFormat;
+	attachments[0].format = settings.headless ? offscreen.format : swapChain.colorFormat;
 	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
 	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// The offscreen image isn't presented, leave it ready to be copied from for screenshots
+	attachments[0].finalLayout = settings.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 	// Depth attachment
 	attachments[1].format = depthFormat;
 	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -1260,7 +1511,7 @@ void VkAppBase::setupRenderPass()
 	subpassDescription.pResolveAttachments = nullptr;
 
 	// Subpass dependencies for layout transitions
-	std::array<VkSubpassDependency, 2> dependencies;
+	std::vector<VkSubpassDependency> dependencies(3);
 
 	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependencies[0].dstSubpass = 0;
@@ -1278,6 +1529,29 @@ void VkAppBase::setupRenderPass()
 	dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
 	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+	// The depth attachment is shared by all frames in flight, so depth writes of the previous frame have to finish before it gets cleared again
+	dependencies[2].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[2].dstSubpass = 0;
+	dependencies[2].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[2].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[2].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[2].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[2].dependencyFlags = 0;
+
+	// The offscreen color image of headless mode is shared by all frames in flight as well, so color writes and screenshot copies
+	// of the previous frame have to finish before it gets cleared again (swap chain images are ordered by image acquisition instead)
+	if (settings.headless) {
+		VkSubpassDependency offscreenDependency{};
+		offscreenDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		offscreenDependency.dstSubpass = 0;
+		offscreenDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+		offscreenDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		offscreenDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		offscreenDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		offscreenDependency.dependencyFlags = 0;
+		dependencies.push_back(offscreenDependency);
+	}
+
 	VkRenderPassCreateInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
@@ -1307,7 +1581,14 @@ void VkAppBase::windowResize()
 	// Recreate swap chain
 	width = destWidth;
 	height = destHeight;
-	setupSwapChain();
+	if (!settings.headless) {
+		setupSwapChain();
+		// The image count of the new swap chain may differ
+		createRenderCompleteSemaphores();
+		// Frames in flight only ever shrink, the per frame resources have been created for the initial count
+		settings.framesInFlight = std::min(settings.framesInFlight, swapChain.imageCount);
+		currentFrame = currentFrame % settings.framesInFlight;
+	}
 
 	// Recreate the frame buffers
 	vkDestroyImageView(device, depthStencil.view, nullptr);
@@ -1393,6 +1674,16 @@ void VkAppBase::setupSwapChain()
 
 void VkAppBase::OnUpdateUIOverlay(vks::UIOverlay* overlay) {}
 
+uint32_t VkAppBase::getBenchmarkSweepConfigurationCount()
+{
+	return 1;
+}
+
+std::string VkAppBase::applyBenchmarkSweepConfiguration(uint32_t index)
+{
+	return "default";
+}
+
 // Command line argument parser class
 
 CommandLineParser::CommandLineParser()
@@ -1412,6 +1703,13 @@ CommandLineParser::CommandLineParser()
 	add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	add("benchmarksweep", { "-benchmarksweep", "--benchmarksweep" }, 0, "Run the benchmark once for every sweep configuration and output a results table");
+	add("benchmarksweepvalues", { "-bsv", "--benchmarksweepvalues" }, 1, "Comma separated values the example sweeps over (e.g. tessellation levels)");
+	add("benchmarksweepresolutions", { "-bsr", "--benchmarksweepresolutions" }, 1, "Comma separated WIDTHxHEIGHT resolutions to sweep over (headless only)");
+	add("headless", { "-headless", "--headless" }, 0, "Render offscreen without a window or swap chain");
+	add("headlessframes", { "-hf", "--headlessframes" }, 1, "Set the number of frames rendered in headless mode (default 100)");
+	add("headlessduration", { "-hd", "--headlessduration" }, 1, "Set the duration of headless rendering in seconds, overrides the frame count");
+	add("framesinflight", { "-framesinflight", "--framesinflight" }, 1, "Set the number of frames that can be in flight at once (default 2)");
 	//@@@william
 	add("sourcefile", { "-sf", "--sourcefile" }, 1, "load ktx format source file for image processing");
 }
@@ -14,8 +14,11 @@
 */
 
 #pragma once
+// GLFW is only shipped for Windows (dep/glfw-3.3.3.bin.WIN64), other platforms have no window support and always run headless
+#if defined(_WIN32)
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#endif
 
  
 #ifdef _WIN32
@@ -62,6 +65,7 @@
 #include "vkbuffer.h"
 #include "vkdevice.h"
 #include "vktexture.h"
+#include "vkassetloader.h"
 
 #include "vkinitializers.h"
 #include "camera.h"
@@ -106,10 +110,14 @@ private:
 	void createPipelineCache();
 	void createCommandPool();
 	void createSynchronizationPrimitives();
+	void createRenderCompleteSemaphores();
 	void initSwapchain();
 	void setupSwapChain();
 	void createCommandBuffers();
 	void destroyCommandBuffers();
+	void setupOffscreenTarget();
+	void destroyOffscreenTarget();
+	void runBenchmarkSweep();
 	std::string shaderDir = "glsl";
 protected:
 	// Returns the path to the root of the glsl or hlsl shader directory.
@@ -149,14 +157,16 @@ protected:
 	VkPipelineStageFlags submitPipelineStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	// Contains command buffers and semaphores to be presented to the queue
 	VkSubmitInfo submitInfo;
-	// Command buffers used for rendering
+	// Command buffers used for rendering (one per frame in flight)
 	std::vector<VkCommandBuffer> drawCmdBuffers;
 	// Global render pass for frame buffer writes
 	VkRenderPass renderPass = VK_NULL_HANDLE;
 	// List of available frame buffers (same as number of swap chain images)
 	std::vector<VkFramebuffer> frameBuffers;
-	// Active frame buffer index
+	// Active frame buffer index (swap chain image acquired for the current frame)
 	uint32_t currentBuffer = 0;
+	// Index of the frame in flight whose command buffer, fence and semaphores are currently used
+	uint32_t currentFrame = 0;
 	// Descriptor set pool
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 	// List of shader modules created (stored for cleanup)
@@ -165,13 +175,23 @@ protected:
 	VkPipelineCache pipelineCache;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
+	// Color target that replaces the swap chain images in headless mode
+	struct {
+		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		VkImage image = VK_NULL_HANDLE;
+		vks::Allocation allocation;
+		VkImageView view = VK_NULL_HANDLE;
+	} offscreen;
 	// Synchronization semaphores
 	struct {
-		// Swap chain image presentation
-		VkSemaphore presentComplete;
-		// Command buffer submission and execution
-		VkSemaphore renderComplete;
+		// Swap chain image presentation (one per frame in flight)
+		std::vector<VkSemaphore> presentComplete;
+		// Command buffer submission and execution (one per swap chain image, waited on by the image's present)
+		std::vector<VkSemaphore> renderComplete;
 	} semaphores;
+	// Set if the current image has been acquired from a suboptimal swap chain, which is recreated once the image has been presented
+	bool swapChainSuboptimal = false;
+	// Signaled when the GPU has finished with a frame in flight, waited on before its resources are reused
 	std::vector<VkFence> waitFences;
 
 	////@William
@@ -193,6 +213,8 @@ public:
 
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice* vulkanDevice;
+	/** @brief Loads models and textures in the background, decoded assets are uploaded at the start of each frame */
+	vks::AssetLoader assetLoader;
 
 	/** @brief Example settings that can be changed e.g. by command line arguments */
 	struct Settings {
@@ -204,6 +226,14 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = false;
+		/** @brief Number of frames the CPU may record ahead of the GPU (set via -framesinflight) */
+		uint32_t framesInFlight = 2;
+		/** @brief Render into an offscreen image without a window, surface or swap chain (always set on platforms without window support) */
+		bool headless = false;
+		/** @brief Number of frames rendered by the headless render loop if no duration is set */
+		uint32_t headlessFrames = 100;
+		/** @brief Duration of the headless render loop in seconds, overrides the frame count if greater than zero */
+		uint32_t headlessDuration = 0;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -295,15 +325,21 @@ public:
 	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer */
 	void drawUI(const VkCommandBuffer commandBuffer);
 
-	/** Prepare the next frame for workload submission by acquiring the next swap chain image */
-	void prepareFrame();
-	/** @brief Presents the current image to the swap chain */
+	/** Prepare the next frame for workload submission by waiting for the current frame's fence and acquiring the next swap chain image
+	* Returns false if no image could be acquired and the swap chain has been recreated, the frame must then neither be recorded nor submitted */
+	bool prepareFrame();
+	/** @brief Presents the current image to the swap chain and advances to the next frame in flight */
 	void submitFrame();
 	/** @brief (Virtual) Default image acquire + submission and command buffer submission function */
 	virtual void renderFrame();
 
 	/** @brief (Virtual) Called when the UI overlay is updating, can be used to add custom elements to the overlay */
 	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay);
+
+	/** @brief (Virtual) Number of example specific configurations run per resolution in benchmark sweep mode */
+	virtual uint32_t getBenchmarkSweepConfigurationCount();
+	/** @brief (Virtual) Applies the given benchmark sweep configuration and returns a label for the results table */
+	virtual std::string applyBenchmarkSweepConfiguration(uint32_t index);
 };
 
 // OS specific macros for the example main entry points
@@ -324,7 +360,9 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)									\
 	for (int32_t i = 0; i < __argc; i++) { VulkanExample::args.push_back(__argv[i]); };  			\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
-	vulkanExample->setupWindow(hInstance, WndProc);													\
+	if (!vulkanExample->settings.headless) {														\
+		vulkanExample->setupWindow(hInstance, WndProc);												\
+	}																								\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
@@ -332,7 +370,20 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)									\
 }
 
 #else
-#define VULKAN_EXAMPLE_MAIN()
+// Linux/other entry point, there is no window support on these platforms so the example always runs headless
+#define VULKAN_EXAMPLE_MAIN()																		\
+VulkanExample *vulkanExample;																		\
+int main(const int argc, const char *argv[])														\
+{																									\
+	for (int32_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
+	vulkanExample = new VulkanExample();															\
+	vulkanExample->initVulkan();																	\
+	vulkanExample->setupWindow();																	\
+	vulkanExample->prepare();																		\
+	vulkanExample->renderLoop();																	\
+	delete(vulkanExample);																			\
+	return 0;																						\
+}
 #endif
  
 #pragma once
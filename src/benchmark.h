@@ -12,6 +12,8 @@
 * Copyright (C) 2022
 */
 
+#pragma once
+
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -19,13 +21,313 @@
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <unordered_map>
+#include <numeric>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "vulkan/vulkan.h"
+#include "vkinitializers.h"
+#include "vktools.h"
 
 namespace vks
 {
+	/**
+	* @brief Query pool based GPU profiler with named scopes
+	*
+	* Scopes write a timestamp at their begin and end and can optionally collect pipeline statistics.
+	* Every frame in flight owns its own range of queries, results of a frame are read back when that frame's
+	* resources are reused (i.e. after its fence has been waited on) so reading never stalls the GPU.
+	*/
+	class GpuProfiler {
+	public:
+		/** @brief Pipeline statistics collected for scopes that request them, in the order the results are written */
+		static constexpr VkQueryPipelineStatisticFlags pipelineStatisticFlags =
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_CONTROL_SHADER_PATCHES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT;
+		static constexpr uint32_t pipelineStatisticCount = 6;
+		/** @brief Names of the pipeline statistics (matching the bit order of pipelineStatisticFlags) */
+		static const char* pipelineStatisticName(uint32_t index)
+		{
+			static const char* names[pipelineStatisticCount] = {
+				"VS invocations", "clipping invocations", "clipping primitives", "FS invocations", "TCS patches", "TES invocations"
+			};
+			return names[index];
+		}
+
+		/** @brief Accumulated results of a named scope */
+		struct ScopeResult {
+			std::string name;
+			// Sum and number of GPU times in milliseconds
+			double gpuTime = 0.0;
+			double lastGpuTime = 0.0;
+			uint32_t samples = 0;
+			// Sums of the pipeline statistics (only valid if hasStatistics is set)
+			bool hasStatistics = false;
+			uint64_t statistics[pipelineStatisticCount] = {};
+			uint32_t statisticSamples = 0;
+
+			double averageGpuTime() const { return samples > 0 ? gpuTime / samples : 0.0; }
+			double averageStatistic(uint32_t index) const { return statisticSamples > 0 ? (double)statistics[index] / statisticSamples : 0.0; }
+		};
+
+		/** @brief True if timestamps are supported and the query pools have been created */
+		bool enabled = false;
+		/** @brief True if pipeline statistics are collected (requires the pipelineStatisticsQuery feature) */
+		bool statisticsEnabled = false;
+
+		/**
+		* Create the query pools
+		*
+		* @param device Logical device to create the query pools on
+		* @param timestampPeriod Nanoseconds per timestamp tick (VkPhysicalDeviceLimits::timestampPeriod)
+		* @param timestampValidBits Valid timestamp bits of the queue family the scopes are recorded for (0 disables the profiler)
+		* @param framesInFlight Number of frames in flight, each one gets a separate range of queries
+		* @param enableStatistics Create a pipeline statistics query pool (the pipelineStatisticsQuery feature must be enabled)
+		* @param maxScopes Maximum number of scopes per frame
+		*/
+		void prepare(VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t framesInFlight, bool enableStatistics, uint32_t maxScopes = 32)
+		{
+			this->device = device;
+			this->timestampPeriod = timestampPeriod;
+			this->maxScopes = maxScopes;
+			timestampMask = (timestampValidBits >= 64) ? ~0ULL : ((1ULL << timestampValidBits) - 1);
+			frames.resize(framesInFlight);
+			if (timestampValidBits == 0) {
+				std::cerr << "Timestamps are not supported by the graphics queue, GPU profiling is disabled\n";
+				return;
+			}
+			VkQueryPoolCreateInfo queryPoolCI = vks::initializers::queryPoolCreateInfo(VK_QUERY_TYPE_TIMESTAMP, framesInFlight * maxScopes * 2);
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &timestampPool));
+			if (enableStatistics) {
+				queryPoolCI = vks::initializers::queryPoolCreateInfo(VK_QUERY_TYPE_PIPELINE_STATISTICS, framesInFlight * maxScopes, pipelineStatisticFlags);
+				VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &statisticsPool));
+				statisticsEnabled = true;
+			}
+			enabled = true;
+		}
+
+		void destroy()
+		{
+			if (timestampPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device, timestampPool, nullptr);
+				timestampPool = VK_NULL_HANDLE;
+			}
+			if (statisticsPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device, statisticsPool, nullptr);
+				statisticsPool = VK_NULL_HANDLE;
+			}
+			enabled = false;
+			statisticsEnabled = false;
+		}
+
+		/**
+		* Collect the results of the last use of a frame slot and reset its queries
+		*
+		* @param commandBuffer Command buffer of the frame, must be outside of a render pass
+		* @param frameIndex Index of the frame in flight, the frame's fence must have been waited on before
+		*/
+		void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+		{
+			if (!enabled) {
+				return;
+			}
+			currentFrame = frameIndex;
+			collect(frameIndex);
+			vkCmdResetQueryPool(commandBuffer, timestampPool, frameIndex * maxScopes * 2, maxScopes * 2);
+			if (statisticsEnabled) {
+				vkCmdResetQueryPool(commandBuffer, statisticsPool, frameIndex * maxScopes, maxScopes);
+			}
+		}
+
+		/**
+		* Begin a named scope
+		*
+		* @param commandBuffer Command buffer to record the queries to
+		* @param name Name the results are accumulated under
+		* @param pipelineStatistics Also collect pipeline statistics (the scope must then begin and end within the same subpass)
+		*
+		* @return Handle to pass to endScope
+		*/
+		uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string& name, bool pipelineStatistics = false)
+		{
+			// A disabled or unprepared profiler has no per frame queries to index
+			if (!enabled) {
+				return UINT32_MAX;
+			}
+			FrameQueries& frame = frames[currentFrame];
+			if (frame.scopes.size() >= maxScopes) {
+				return UINT32_MAX;
+			}
+			RecordedScope scope{};
+			scope.result = findResult(name);
+			scope.statistics = pipelineStatistics && statisticsEnabled;
+			uint32_t slot = currentFrame * maxScopes + static_cast<uint32_t>(frame.scopes.size());
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, slot * 2);
+			if (scope.statistics) {
+				vkCmdBeginQuery(commandBuffer, statisticsPool, slot, 0);
+			}
+			frame.scopes.push_back(scope);
+			return static_cast<uint32_t>(frame.scopes.size()) - 1;
+		}
+
+		/** @brief End a scope started with beginScope */
+		void endScope(VkCommandBuffer commandBuffer, uint32_t scopeHandle)
+		{
+			if (!enabled || scopeHandle == UINT32_MAX) {
+				return;
+			}
+			FrameQueries& frame = frames[currentFrame];
+			uint32_t slot = currentFrame * maxScopes + scopeHandle;
+			if (frame.scopes[scopeHandle].statistics) {
+				vkCmdEndQuery(commandBuffer, statisticsPool, slot);
+			}
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, slot * 2 + 1);
+		}
+
+		/** @brief Discard all accumulated results (e.g. after a warmup phase) */
+		void resetResults()
+		{
+			for (auto& result : results) {
+				std::string name = result.name;
+				result = ScopeResult{};
+				result.name = name;
+			}
+		}
+
+		const std::vector<ScopeResult>& getResults() const { return results; }
+
+		/** @brief Print the average GPU time (and pipeline statistics) per scope */
+		void printResults(std::ostream& out) const
+		{
+			for (auto& result : results) {
+				if (result.samples == 0) {
+					continue;
+				}
+				out << "gpu    : " << result.name << " " << result.averageGpuTime() << " ms" << "\n";
+				if (result.hasStatistics) {
+					for (uint32_t i = 0; i < pipelineStatisticCount; i++) {
+						out << "         " << pipelineStatisticName(i) << ": " << result.averageStatistic(i) << "\n";
+					}
+				}
+			}
+		}
+
+	private:
+		struct RecordedScope {
+			uint32_t result;
+			bool statistics;
+		};
+		struct FrameQueries {
+			std::vector<RecordedScope> scopes;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueryPool timestampPool = VK_NULL_HANDLE;
+		VkQueryPool statisticsPool = VK_NULL_HANDLE;
+		float timestampPeriod = 1.0f;
+		uint64_t timestampMask = ~0ULL;
+		uint32_t maxScopes = 0;
+		uint32_t currentFrame = 0;
+		std::vector<FrameQueries> frames;
+		std::vector<ScopeResult> results;
+		std::unordered_map<std::string, uint32_t> resultIndices;
+		std::vector<uint64_t> queryData;
+
+		uint32_t findResult(const std::string& name)
+		{
+			auto it = resultIndices.find(name);
+			if (it != resultIndices.end()) {
+				return it->second;
+			}
+			uint32_t index = static_cast<uint32_t>(results.size());
+			results.push_back(ScopeResult{});
+			results.back().name = name;
+			resultIndices[name] = index;
+			return index;
+		}
+
+		// Read back the queries recorded the last time this frame slot was used
+		// Called after the frame's fence has been signaled, so the results are available and no wait flag is needed
+		void collect(uint32_t frameIndex)
+		{
+			FrameQueries& frame = frames[frameIndex];
+			uint32_t scopeCount = static_cast<uint32_t>(frame.scopes.size());
+			if (scopeCount == 0) {
+				return;
+			}
+			queryData.resize(scopeCount * 2);
+			VkResult res = vkGetQueryPoolResults(device, timestampPool, frameIndex * maxScopes * 2, scopeCount * 2, queryData.size() * sizeof(uint64_t), queryData.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+			if (res == VK_SUCCESS) {
+				for (uint32_t i = 0; i < scopeCount; i++) {
+					uint64_t begin = queryData[i * 2] & timestampMask;
+					uint64_t end = queryData[i * 2 + 1] & timestampMask;
+					ScopeResult& result = results[frame.scopes[i].result];
+					result.lastGpuTime = (double)((end - begin) & timestampMask) * timestampPeriod / 1000000.0;
+					result.gpuTime += result.lastGpuTime;
+					result.samples++;
+				}
+			}
+			if (statisticsEnabled) {
+				queryData.resize(pipelineStatisticCount);
+				for (uint32_t i = 0; i < scopeCount; i++) {
+					if (!frame.scopes[i].statistics) {
+						continue;
+					}
+					res = vkGetQueryPoolResults(device, statisticsPool, frameIndex * maxScopes + i, 1, pipelineStatisticCount * sizeof(uint64_t), queryData.data(), pipelineStatisticCount * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+					if (res != VK_SUCCESS) {
+						continue;
+					}
+					ScopeResult& result = results[frame.scopes[i].result];
+					result.hasStatistics = true;
+					for (uint32_t j = 0; j < pipelineStatisticCount; j++) {
+						result.statistics[j] += queryData[j];
+					}
+					result.statisticSamples++;
+				}
+			}
+			frame.scopes.clear();
+		}
+	};
+
 	class Benchmark {
 	private:
 		FILE* stream;
 		VkPhysicalDeviceProperties deviceProps;
+
+		static std::string jsonEscape(const std::string& str) {
+			std::string escaped;
+			for (char c : str) {
+				if (c == '"' || c == '\\') {
+					escaped += '\\';
+					escaped += c;
+				}
+				else if (static_cast<unsigned char>(c) < 0x20) {
+					// Control characters aren't allowed unescaped in JSON strings
+					char code[7];
+					snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+					escaped += code;
+				}
+				else {
+					escaped += c;
+				}
+			}
+			return escaped;
+		}
+
+		// Nearest rank percentile of an ascending sorted list
+		static double percentile(const std::vector<double>& sorted, double p) {
+			if (sorted.empty()) {
+				return 0.0;
+			}
+			size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+			return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+		}
 	public:
 		bool active = false;
 		bool outputFrameTimes = false;
@@ -40,6 +342,60 @@ namespace vks
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
+		/** @brief Average frame rate of the benchmark phase, 0 if no frame has been measured */
+		double fps() const {
+			return (frameCount > 0 && runtime > 0.0) ? frameCount / (runtime / 1000.0) : 0.0;
+		}
+
+		/** @brief Width of a frame time histogram bucket in milliseconds */
+		double histogramBucketWidth = 1.0;
+		/** @brief Number of histogram buckets, the last one also counts all longer frames */
+		uint32_t histogramBucketCount = 50;
+		/** @brief Leading frames slower than the median by this many robust standard deviations are treated as warmup tail */
+		double outlierThreshold = 6.0;
+
+		/** @brief Frame time statistics of the benchmark phase (without warmup tail outliers) */
+		struct Statistics {
+			uint32_t frames = 0;
+			uint32_t droppedFrames = 0;
+			double min = 0.0;
+			double max = 0.0;
+			double mean = 0.0;
+			double stddev = 0.0;
+			double p50 = 0.0;
+			double p90 = 0.0;
+			double p99 = 0.0;
+			double p999 = 0.0;
+			// Frames that missed a 60 / 30 fps budget
+			uint32_t framesOver16ms = 0;
+			uint32_t framesOver33ms = 0;
+			std::vector<uint32_t> histogram;
+		} statistics;
+
+		/** @brief GPU scope profiler, results of the benchmark phase are reported along with the frame times */
+		GpuProfiler profiler;
+
+		/** @brief Run the benchmark once per sweep configuration (resolution x example defined configuration) */
+		bool sweep = false;
+		/** @brief Example defined values to sweep over (e.g. tessellation levels), empty to use the example's defaults */
+		std::vector<uint32_t> sweepValues;
+		/** @brief Resolutions to sweep over, empty to only use the current resolution */
+		std::vector<VkExtent2D> sweepResolutions;
+		/** @brief Name of the profiler scope reported as GPU time of a sweep configuration */
+		std::string sweepScope = "frame";
+
+		struct SweepResult {
+			std::string configuration;
+			uint32_t width;
+			uint32_t height;
+			uint32_t frames;
+			double fps;
+			double p50;
+			double p99;
+			double gpuTime;
+		};
+		std::vector<SweepResult> sweepResults;
+
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
 			this->deviceProps = deviceProps;
@@ -50,17 +406,30 @@ namespace vks
 #endif
 			std::cout << std::fixed << std::setprecision(3);
 
+			runtime = 0.0;
+			frameCount = 0;
+			frameTimes.clear();
+
 			// Warm up phase to get more stable frame rates
+			uint32_t warmupFrames = 0;
+			double tWarmup = 0.0;
 			{
-				double tMeasured = 0.0;
-				while (tMeasured < (warmup * 1000)) {
+				while (tWarmup < (warmup * 1000)) {
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
-					tMeasured += tDiff;
+					tWarmup += tDiff;
+					warmupFrames++;
 				};
 			}
 
+			// Preallocate the frame times from the warmup frame rate (with some headroom) so the measurement doesn't reallocate
+			size_t expectedFrames = (outputFrames != -1) ? (size_t)outputFrames : (size_t)((double)warmupFrames / std::max(tWarmup, 1.0) * duration * 1000.0 * 1.5) + 1024;
+			frameTimes.reserve(expectedFrames);
+
+			// Don't report GPU times of the warmup phase
+			profiler.resetResults();
+
 			// Benchmark phase
 			{
 				while (runtime < (duration * 1000.0)) {
@@ -70,43 +439,248 @@ namespace vks
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
 					frameCount++;
-					if (outputFrames != -1 && outputFrames == frameCount) break;
+					if (outputFrames != -1 && static_cast<uint32_t>(outputFrames) == frameCount) break;
 				};
+				computeStatistics();
 				std::cout << "Benchmark finished" << "\n";
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
-				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				std::cout << "fps    : " << fps() << "\n";
+				printStatistics(std::cout);
+				profiler.printResults(std::cout);
 			}
 		}
 
+		/**
+		* Compute the frame time statistics
+		*
+		* @note Leading frames that are far slower than the rest (e.g. pipeline/shader compilation or clock ramp up the warmup didn't cover) are dropped
+		*/
+		void computeStatistics() {
+			statistics = Statistics{};
+			if (frameTimes.empty()) {
+				return;
+			}
+
+			std::vector<double> sorted(frameTimes);
+			std::sort(sorted.begin(), sorted.end());
+			double median = percentile(sorted, 50.0);
+
+			// Median absolute deviation scaled to a standard deviation estimate (robust against the outliers we're looking for)
+			std::vector<double> deviations(sorted.size());
+			for (size_t i = 0; i < sorted.size(); i++) {
+				deviations[i] = std::abs(sorted[i] - median);
+			}
+			std::sort(deviations.begin(), deviations.end());
+			double robustSigma = std::max(1.4826 * percentile(deviations, 50.0), median * 0.01);
+
+			// Drop the outliers at the start of the measurement, at most 5% of all frames
+			size_t maxDropped = frameTimes.size() / 20;
+			size_t dropped = 0;
+			while (dropped < maxDropped && frameTimes[dropped] > median + outlierThreshold * robustSigma) {
+				dropped++;
+			}
+			statistics.droppedFrames = static_cast<uint32_t>(dropped);
+
+			if (dropped > 0) {
+				sorted.assign(frameTimes.begin() + dropped, frameTimes.end());
+				std::sort(sorted.begin(), sorted.end());
+			}
+
+			statistics.frames = static_cast<uint32_t>(sorted.size());
+			statistics.min = sorted.front();
+			statistics.max = sorted.back();
+			statistics.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / (double)sorted.size();
+			double variance = 0.0;
+			for (double t : sorted) {
+				variance += (t - statistics.mean) * (t - statistics.mean);
+			}
+			statistics.stddev = std::sqrt(variance / (double)sorted.size());
+			statistics.p50 = percentile(sorted, 50.0);
+			statistics.p90 = percentile(sorted, 90.0);
+			statistics.p99 = percentile(sorted, 99.0);
+			statistics.p999 = percentile(sorted, 99.9);
+
+			statistics.histogram.assign(histogramBucketCount, 0);
+			for (double t : sorted) {
+				uint32_t bucket = std::min(static_cast<uint32_t>(t / histogramBucketWidth), histogramBucketCount - 1);
+				statistics.histogram[bucket]++;
+				if (t > 1000.0 / 60.0) {
+					statistics.framesOver16ms++;
+				}
+				if (t > 1000.0 / 30.0) {
+					statistics.framesOver33ms++;
+				}
+			}
+		}
+
+		void printStatistics(std::ostream& out) {
+			out << "dropped: " << statistics.droppedFrames << " warmup tail frames" << "\n";
+			out << "best   : " << (1000.0 / statistics.min) << " fps (" << statistics.min << " ms)" << "\n";
+			out << "worst  : " << (1000.0 / statistics.max) << " fps (" << statistics.max << " ms)" << "\n";
+			out << "avg    : " << (1000.0 / statistics.mean) << " fps (" << statistics.mean << " ms, stddev " << statistics.stddev << " ms)" << "\n";
+			out << "p50    : " << statistics.p50 << " ms" << "\n";
+			out << "p90    : " << statistics.p90 << " ms" << "\n";
+			out << "p99    : " << statistics.p99 << " ms" << "\n";
+			out << "p99.9  : " << statistics.p999 << " ms" << "\n";
+			out << ">16.6ms: " << statistics.framesOver16ms << " frames" << "\n";
+			out << ">33.3ms: " << statistics.framesOver33ms << " frames" << "\n";
+		}
+
+		/** @brief Store the results of the last run as one row of the sweep table */
+		void addSweepResult(const std::string& configuration, uint32_t width, uint32_t height) {
+			SweepResult result{};
+			result.configuration = configuration;
+			result.width = width;
+			result.height = height;
+			result.frames = frameCount;
+			result.fps = fps();
+			result.p50 = statistics.p50;
+			result.p99 = statistics.p99;
+			for (auto& scope : profiler.getResults()) {
+				if (scope.name == sweepScope) {
+					result.gpuTime = scope.averageGpuTime();
+				}
+			}
+			sweepResults.push_back(result);
+		}
+
+		void printSweepResults(std::ostream& out) {
+			out << "\n" << std::left << std::setw(32) << "configuration" << std::right << std::setw(12) << "resolution" << std::setw(10) << "fps" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "gpu ms" << "\n";
+			for (auto& result : sweepResults) {
+				std::string resolution = std::to_string(result.width) + "x" + std::to_string(result.height);
+				out << std::left << std::setw(32) << result.configuration << std::right << std::setw(12) << resolution << std::setw(10) << result.fps << std::setw(10) << result.p50 << std::setw(10) << result.p99 << std::setw(10) << result.gpuTime << "\n";
+			}
+		}
+
+		/** @brief Write the sweep table as CSV to filename */
+		void saveSweepResults() {
+			std::ofstream result(filename, std::ios::out);
+			if (!result.is_open()) {
+				return;
+			}
+			result << std::fixed << std::setprecision(4);
+			result << "device,driverversion" << "\n";
+			result << deviceProps.deviceName << "," << deviceProps.driverVersion << "\n";
+			result << "\n" << "configuration,width,height,frames,fps,p50 (ms),p99 (ms),gpu " << sweepScope << " (ms)" << "\n";
+			for (auto& sweepResult : sweepResults) {
+				result << sweepResult.configuration << "," << sweepResult.width << "," << sweepResult.height << "," << sweepResult.frames << "," << sweepResult.fps << ","
+					<< sweepResult.p50 << "," << sweepResult.p99 << "," << sweepResult.gpuTime << "\n";
+			}
+			result.flush();
+		}
+
+		/** @brief Write the results as CSV to filename and as JSON to the same file name with a .json extension */
 		void saveResults() {
 			std::ofstream result(filename, std::ios::out);
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
 				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
+				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << fps() << "\n";
+
+				result << "\n" << "frames,dropped,min (ms),max (ms),mean (ms),stddev (ms),p50 (ms),p90 (ms),p99 (ms),p99.9 (ms),over 16.6 ms,over 33.3 ms" << "\n";
+				result << statistics.frames << "," << statistics.droppedFrames << "," << statistics.min << "," << statistics.max << "," << statistics.mean << "," << statistics.stddev << ","
+					<< statistics.p50 << "," << statistics.p90 << "," << statistics.p99 << "," << statistics.p999 << "," << statistics.framesOver16ms << "," << statistics.framesOver33ms << "\n";
+
+				result << "\n" << "histogram bucket (ms),frames" << "\n";
+				for (size_t i = 0; i < statistics.histogram.size(); i++) {
+					result << (i * histogramBucketWidth) << "," << statistics.histogram[i] << "\n";
+				}
+
+				if (profiler.enabled) {
+					result << "\n" << "scope,gpu avg (ms),samples";
+					for (uint32_t i = 0; i < GpuProfiler::pipelineStatisticCount; i++) {
+						result << "," << GpuProfiler::pipelineStatisticName(i);
+					}
+					result << "\n";
+					for (auto& scope : profiler.getResults()) {
+						result << scope.name << "," << scope.averageGpuTime() << "," << scope.samples;
+						for (uint32_t i = 0; i < GpuProfiler::pipelineStatisticCount; i++) {
+							result << ",";
+							if (scope.hasStatistics) {
+								result << scope.averageStatistic(i);
+							}
+						}
+						result << "\n";
+					}
+				}
 
 				if (outputFrameTimes) {
 					result << "\n" << "frame,ms" << "\n";
 					for (size_t i = 0; i < frameTimes.size(); i++) {
 						result << i << "," << frameTimes[i] << "\n";
 					}
-					double tMin = *std::min_element(frameTimes.begin(), frameTimes.end());
-					double tMax = *std::max_element(frameTimes.begin(), frameTimes.end());
-					double tAvg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / (double)frameTimes.size();
-					std::cout << "best   : " << (1000.0 / tMin) << " fps (" << tMin << " ms)" << "\n";
-					std::cout << "worst  : " << (1000.0 / tMax) << " fps (" << tMax << " ms)" << "\n";
-					std::cout << "avg    : " << (1000.0 / tAvg) << " fps (" << tAvg << " ms)" << "\n";
-					std::cout << "\n";
 				}
 
 				result.flush();
+			}
+
+			// Replace the extension (if there is one in the file name part of the path)
+			size_t extension = filename.find_last_of('.');
+			size_t separator = filename.find_last_of("/\\");
+			bool hasExtension = (extension != std::string::npos) && ((separator == std::string::npos) || (extension > separator));
+			saveResultsJson((hasExtension ? filename.substr(0, extension) : filename) + ".json");
 #if defined(_WIN32)
-				FreeConsole();
+			FreeConsole();
 #endif
+		}
+
+		void saveResultsJson(const std::string& jsonFilename) {
+			std::ofstream json(jsonFilename, std::ios::out);
+			if (!json.is_open()) {
+				return;
+			}
+			json << std::fixed << std::setprecision(4);
+			json << "{\n";
+			json << "\t\"device\": \"" << jsonEscape(deviceProps.deviceName) << "\",\n";
+			json << "\t\"driverVersion\": " << deviceProps.driverVersion << ",\n";
+			json << "\t\"durationMs\": " << runtime << ",\n";
+			json << "\t\"frames\": " << frameCount << ",\n";
+			json << "\t\"fps\": " << fps() << ",\n";
+			json << "\t\"frameTimeMs\": {\n";
+			json << "\t\t\"frames\": " << statistics.frames << ",\n";
+			json << "\t\t\"droppedWarmupFrames\": " << statistics.droppedFrames << ",\n";
+			json << "\t\t\"min\": " << statistics.min << ",\n";
+			json << "\t\t\"max\": " << statistics.max << ",\n";
+			json << "\t\t\"mean\": " << statistics.mean << ",\n";
+			json << "\t\t\"stddev\": " << statistics.stddev << ",\n";
+			json << "\t\t\"p50\": " << statistics.p50 << ",\n";
+			json << "\t\t\"p90\": " << statistics.p90 << ",\n";
+			json << "\t\t\"p99\": " << statistics.p99 << ",\n";
+			json << "\t\t\"p99.9\": " << statistics.p999 << ",\n";
+			json << "\t\t\"over16.6ms\": " << statistics.framesOver16ms << ",\n";
+			json << "\t\t\"over33.3ms\": " << statistics.framesOver33ms << "\n";
+			json << "\t},\n";
+			json << "\t\"histogram\": { \"bucketWidthMs\": " << histogramBucketWidth << ", \"counts\": [";
+			for (size_t i = 0; i < statistics.histogram.size(); i++) {
+				json << (i > 0 ? ", " : "") << statistics.histogram[i];
+			}
+			json << "] },\n";
+			json << "\t\"gpuScopes\": [";
+			bool first = true;
+			for (auto& scope : profiler.getResults()) {
+				json << (first ? "\n" : ",\n") << "\t\t{ \"name\": \"" << jsonEscape(scope.name) << "\", \"avgMs\": " << scope.averageGpuTime() << ", \"samples\": " << scope.samples;
+				if (scope.hasStatistics) {
+					json << ", \"statistics\": {";
+					for (uint32_t i = 0; i < GpuProfiler::pipelineStatisticCount; i++) {
+						json << (i > 0 ? ", " : " ") << "\"" << GpuProfiler::pipelineStatisticName(i) << "\": " << scope.averageStatistic(i);
+					}
+					json << " }";
+				}
+				json << " }";
+				first = false;
+			}
+			json << (first ? "]" : "\n\t]") << ",\n";
+			json << "\t\"frameTimes\": [";
+			if (outputFrameTimes) {
+				for (size_t i = 0; i < frameTimes.size(); i++) {
+					json << (i > 0 ? ", " : "") << frameTimes[i];
+				}
 			}
+			json << "]\n";
+			json << "}\n";
 		}
 	};
-}
\ No newline at end of file
+}
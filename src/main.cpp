@@ -11,8 +11,10 @@
 *******************************************************************************/
 
 #include "appBase.h"
+#if defined(_WIN32)
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#endif
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION true
@@ -26,13 +28,14 @@ public:
   // Resources for the graphics part of the example
   struct {
     VkDescriptorSetLayout descriptorSetLayout;	// Image display shader binding layout
-    VkDescriptorSet descriptorSet;	            // Image display shader bindings
+    std::vector<VkDescriptorSet> descriptorSets;// Shader bindings, one per frame in flight
     VkPipeline pipelineFilled;						      // Filled pipeline
     VkPipeline pipelineWireframe;               // Wireframe pipeline
     VkPipelineLayout pipelineLayout;			      // Layout of the graphics pipeline
   } graphics;
 
-  vks::Buffer UBOGlobal_Device;
+  // one uniform buffer per frame in flight so the host never writes a buffer the GPU may still read
+  std::vector<vks::Buffer> UBOGlobal_Device;
 
   // use same uniform buffer for all shader stages out of laziness
   struct UBOGlobal
@@ -44,6 +47,9 @@ public:
     glm::vec4 m_ScaleAndTeslvl{ 0.25f, 0.5f, 0.25f, 64.0f };
   } UBOGlobal_Host;
 
+  // which halves of the screen get drawn, single pipelines are used by the benchmark sweep
+  enum class DrawMode { Both, Wireframe, Filled } drawMode = DrawMode::Both;
+
   VulkanExample() : VkAppBase(ENABLE_VALIDATION)
   {
     title = "CSD2170 Assignment 4 | Tessellation | Owen Huang Wensong";
@@ -61,7 +67,8 @@ public:
     vkDestroyPipelineLayout(device, graphics.pipelineLayout, nullptr);
     vkDestroyDescriptorSetLayout(device, graphics.descriptorSetLayout, nullptr);
 
-    UBOGlobal_Device.destroy();
+    for (vks::Buffer& buffer : UBOGlobal_Device)
+      buffer.destroy();
   }
 
   // Enable physical device features required for this example
@@ -81,6 +88,14 @@ public:
     else {
       std::cerr << "wireframe not supported :(" << std::endl;
     }
+    // Pipeline statistics are used to profile the tessellation stages
+    if (deviceFeatures.pipelineStatisticsQuery) {
+      enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+    }
+    // Indirect drawing of glTF models finds the draw data of each draw through its firstInstance
+    if (deviceFeatures.drawIndirectFirstInstance) {
+      enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+    }
   }
 
   void loadAssets()
@@ -88,7 +103,8 @@ public:
 
   }
 
-  void buildCommandBuffers()
+  // Records the current frame in flight's command buffer against the acquired swap chain image
+  void recordCommandBuffer()
   {
     VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -104,54 +120,62 @@ public:
     renderPassBeginInfo.renderArea.extent.height = height;
     renderPassBeginInfo.clearValueCount = 2;
     renderPassBeginInfo.pClearValues = clearValues;
-    //std::cout << "drawCmdBuffers size = " << drawCmdBuffers.size() << std::endl;
-    for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-    {
-      // Set target frame buffer
-      renderPassBeginInfo.framebuffer = frameBuffers[i];
+    // Set target frame buffer
+    renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
 
-      VkCommandBuffer cmdBuf{ drawCmdBuffers[i] };
+    VkCommandBuffer cmdBuf{ drawCmdBuffers[currentFrame] };
+    VkDescriptorSet descriptorSet{ graphics.descriptorSets[currentFrame] };
 
-      VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuf, &cmdBufInfo));
+    VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuf, &cmdBufInfo));
 
-      vkCmdBeginRenderPass(cmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // Reads back this frame slot's previous queries (its fence has been waited on) and resets them
+    vks::GpuProfiler& profiler = benchmark.profiler;
+    profiler.beginFrame(cmdBuf, currentFrame);
+    uint32_t frameScope = profiler.beginScope(cmdBuf, "frame");
 
-      VkViewport viewport = vks::initializers::viewport(width * 0.5f, static_cast<float>(height), 0.0f, 1.0f);
-      VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-      vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
+    vkCmdBeginRenderPass(cmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-      { // LEFT
-        vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
-        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineWireframe);
-        vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, nullptr);
-        vkCmdDraw(cmdBuf, 1, 1, 0, 0);
-      }
-
-      viewport.x += viewport.width; // right side viewport rect min
+    VkViewport viewport = vks::initializers::viewport(width * 0.5f, static_cast<float>(height), 0.0f, 1.0f);
+    VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+    vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
 
-      { // RIGHT
-        vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
-        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineFilled);
-        vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, nullptr);
-        vkCmdDraw(cmdBuf, 1, 1, 0, 0);
-      }
-      
-      //drawUI(cmdBuf);
+    if (drawMode != DrawMode::Filled)
+    { // LEFT
+      vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
+      vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineWireframe);
+      vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+      uint32_t scope = profiler.beginScope(cmdBuf, "ellipsoid wireframe", true);
+      vkCmdDraw(cmdBuf, 1, 1, 0, 0);
+      profiler.endScope(cmdBuf, scope);
+    }
 
-      vkCmdEndRenderPass(cmdBuf);
+    viewport.x += viewport.width; // right side viewport rect min
 
-      VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuf));
+    if (drawMode != DrawMode::Wireframe)
+    { // RIGHT
+      vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
+      vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineFilled);
+      vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+      uint32_t scope = profiler.beginScope(cmdBuf, "ellipsoid filled", true);
+      vkCmdDraw(cmdBuf, 1, 1, 0, 0);
+      profiler.endScope(cmdBuf, scope);
     }
 
+    //drawUI(cmdBuf);
+
+    vkCmdEndRenderPass(cmdBuf);
+    profiler.endScope(cmdBuf, frameScope);
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuf));
   }
 
   void setupDescriptorPool()
   {
     std::vector<VkDescriptorPoolSize> poolSizes = {
       // Graphics pipelines uniform buffers
-      vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
+      vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, settings.framesInFlight)
     };
-    VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+    VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, settings.framesInFlight);
     VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
   }
 
@@ -171,15 +195,20 @@ public:
 
   void setupDescriptorSet()
   {
+    std::vector<VkDescriptorSetLayout> setLayouts(settings.framesInFlight, graphics.descriptorSetLayout);
     VkDescriptorSetAllocateInfo allocInfo =
-      vks::initializers::descriptorSetAllocateInfo(descriptorPool, &graphics.descriptorSetLayout, 1);
+      vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), settings.framesInFlight);
 
     // Graphics
-    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &graphics.descriptorSet));
-    std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-      vks::initializers::writeDescriptorSet(graphics.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &UBOGlobal_Device.descriptor)
-    };
-    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+    graphics.descriptorSets.resize(settings.framesInFlight);
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, graphics.descriptorSets.data()));
+    for (uint32_t i = 0; i < settings.framesInFlight; ++i)
+    {
+      std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+        vks::initializers::writeDescriptorSet(graphics.descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &UBOGlobal_Device[i].descriptor)
+      };
+      vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+    }
   }
 
   void preparePipelines()
@@ -271,47 +300,48 @@ public:
     VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipelineWireframe));
   }
 
-  // Prepare and initialize uniform buffer containing shader uniforms
+  // Prepare and initialize uniform buffers containing shader uniforms
   void prepareUniformBuffers()
   {
-    // Vertex shader uniform buffer block
-    VK_CHECK_RESULT(vulkanDevice->createBuffer(
-      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      &UBOGlobal_Device,
-      sizeof(UBOGlobal)));
-
-    // Map persistent
-    VK_CHECK_RESULT(UBOGlobal_Device.map());
+    UBOGlobal_Device.resize(settings.framesInFlight);
+    for (vks::Buffer& buffer : UBOGlobal_Device)
+    {
+      // Vertex shader uniform buffer block
+      VK_CHECK_RESULT(vulkanDevice->createBuffer(
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &buffer,
+        sizeof(UBOGlobal)));
+
+      // Map persistent
+      VK_CHECK_RESULT(buffer.map());
+    }
 
     updateUniformBuffers();
   }
 
+  // Only updates the host copy, it is written to the current frame's buffer in draw()
   void updateUniformBuffers()
   {
     UBOGlobal_Host.m_View = camera.matrices.view;
     UBOGlobal_Host.m_Proj = camera.matrices.perspective;
-    memcpy(UBOGlobal_Device.mapped, &UBOGlobal_Host, sizeof(UBOGlobal));
   }
 
   // Ignoring template 7: using in-queue execution barriers
   void draw()
   {
-    VkAppBase::prepareFrame();
+    // Waits for this frame in flight's fence, after which its uniform buffer and command buffer can be reused
+    if (!VkAppBase::prepareFrame()) {
+      return;
+    }
 
-    VkPipelineStageFlags graphicsWaitStageMasks[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    VkSemaphore graphicsWaitSemaphores[] = { semaphores.presentComplete };
-    VkSemaphore graphicsSignalSemaphores[] = { semaphores.renderComplete };
+    memcpy(UBOGlobal_Device[currentFrame].mapped, &UBOGlobal_Host, sizeof(UBOGlobal));
+    recordCommandBuffer();
 
-    // Submit graphics commands
+    // Submit graphics commands, prepareFrame has pointed the submit info at this frame's semaphores
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = graphicsWaitSemaphores;
-    submitInfo.pWaitDstStageMask = graphicsWaitStageMasks;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = graphicsSignalSemaphores;
-    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+    submitInfo.pCommandBuffers = &drawCmdBuffers[currentFrame];
+    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentFrame]));
 
     VkAppBase::submitFrame();
   }
@@ -326,7 +356,6 @@ public:
     preparePipelines();
     setupDescriptorPool();
     setupDescriptorSet();
-    buildCommandBuffers();
     prepared = true;
   }
 
@@ -340,6 +369,33 @@ public:
     }
   }
 
+  // each side of the screen only gets half of the width
+  virtual void windowResized()
+  {
+    camera.updateAspectRatio(width * 0.5f / static_cast<float>(height));
+  }
+
+  // benchmark sweep: every tessellation level with the wireframe and the filled pipeline
+  std::vector<uint32_t> sweepTessellationLevels() const
+  {
+    if (!benchmark.sweepValues.empty())
+      return benchmark.sweepValues;
+    return { 1, 2, 4, 8, 16, 32, 64 };
+  }
+
+  virtual uint32_t getBenchmarkSweepConfigurationCount()
+  {
+    return static_cast<uint32_t>(sweepTessellationLevels().size()) * 2;
+  }
+
+  virtual std::string applyBenchmarkSweepConfiguration(uint32_t index)
+  {
+    uint32_t level = sweepTessellationLevels()[index / 2];
+    drawMode = (index % 2 == 0) ? DrawMode::Wireframe : DrawMode::Filled;
+    UBOGlobal_Host.m_ScaleAndTeslvl.w = static_cast<float>(level);
+    return std::string(drawMode == DrawMode::Wireframe ? "wireframe" : "filled") + " tess " + std::to_string(level);
+  }
+
   virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay)
   {
     if (overlay->header("Settings"))
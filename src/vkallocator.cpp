@@ -0,0 +1,366 @@
+/*
+* Vulkan memory allocator
+*
+* Sub-allocates buffers and images from large per-memory-type device memory blocks
+*
+* Copyright (C)
+*
+*/
+
+#include "vkallocator.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+
+namespace vks
+{
+	namespace
+	{
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		/** @brief Returns true if the last byte of resource A and the first byte of resource B share a bufferImageGranularity page */
+		bool onSamePage(VkDeviceSize aOffset, VkDeviceSize aSize, VkDeviceSize bOffset, VkDeviceSize pageSize)
+		{
+			VkDeviceSize aEndPage = (aOffset + aSize - 1) & ~(pageSize - 1);
+			VkDeviceSize bStartPage = bOffset & ~(pageSize - 1);
+			return aEndPage == bStartPage;
+		}
+
+		bool typesConflict(AllocationType a, AllocationType b)
+		{
+			return a != AllocationType::Free && b != AllocationType::Free && a != b;
+		}
+	}
+
+	/**
+	* Return the allocation to the allocator it was taken from
+	*/
+	void Allocation::free()
+	{
+		if (allocator)
+		{
+			allocator->free(*this);
+		}
+	}
+
+	/**
+	* Setup the allocator for a logical device
+	*
+	* @param device Logical device to allocate memory from
+	* @param memoryProperties Memory types and heaps of the physical device
+	* @param limits Physical device limits (bufferImageGranularity, nonCoherentAtomSize)
+	*/
+	void MemoryAllocator::prepare(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits)
+	{
+		this->device = device;
+		this->memoryProperties = memoryProperties;
+		bufferImageGranularity = std::max<VkDeviceSize>(limits.bufferImageGranularity, 1);
+		nonCoherentAtomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+		blocks.resize(memoryProperties.memoryTypeCount);
+	}
+
+	/**
+	* Release all device memory blocks
+	*
+	* @note All resources that were bound to allocations must have been destroyed before
+	*/
+	void MemoryAllocator::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& typeBlocks : blocks)
+		{
+			for (auto& block : typeBlocks)
+			{
+				if (block->allocationCount > 0)
+				{
+					std::cerr << "Memory allocator: " << block->allocationCount << " allocation(s) still alive in memory type " << block->memoryTypeIndex << " on destruction\n";
+				}
+				destroyBlock(block.get());
+			}
+			typeBlocks.clear();
+		}
+	}
+
+	VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const
+	{
+		const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		// Small heaps (e.g. the 256 MB host visible device local heap without resizable BAR) get smaller blocks
+		return heapSize <= 1024ull * 1024 * 1024 ? alignUp(heapSize / 8, 1024) : defaultBlockSize;
+	}
+
+	VkResult MemoryAllocator::createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated, const void* pNext, Block** block)
+	{
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.pNext = pNext;
+		memAlloc.allocationSize = size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VkDeviceMemory memory;
+		VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, &memory);
+		if (result != VK_SUCCESS)
+		{
+			return result;
+		}
+		deviceAllocations++;
+
+		std::unique_ptr<Block> newBlock(new Block());
+		newBlock->memory = memory;
+		newBlock->size = size;
+		newBlock->memoryTypeIndex = memoryTypeIndex;
+		newBlock->dedicated = dedicated;
+		newBlock->ranges[0] = { size, AllocationType::Free };
+		// Host visible blocks stay mapped for their whole lifetime, as a memory object can only be mapped once at a time
+		if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			void* mapped;
+			VK_CHECK_RESULT(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+			newBlock->mapped = static_cast<uint8_t*>(mapped);
+		}
+		*block = newBlock.get();
+		blocks[memoryTypeIndex].push_back(std::move(newBlock));
+		return VK_SUCCESS;
+	}
+
+	void MemoryAllocator::destroyBlock(Block* block)
+	{
+		if (block->mapped)
+		{
+			vkUnmapMemory(device, block->memory);
+		}
+		vkFreeMemory(device, block->memory, nullptr);
+	}
+
+	/**
+	* First fit search over the free ranges of a block
+	*
+	* @return True if the allocation could be placed in this block
+	*/
+	bool MemoryAllocator::allocateFromBlock(Block* block, VkDeviceSize size, VkDeviceSize alignment, AllocationType type, Allocation* allocation)
+	{
+		for (auto it = block->ranges.begin(); it != block->ranges.end(); ++it)
+		{
+			if (it->second.type != AllocationType::Free || it->second.size < size)
+			{
+				continue;
+			}
+			const VkDeviceSize rangeOffset = it->first;
+			const VkDeviceSize rangeEnd = rangeOffset + it->second.size;
+			VkDeviceSize offset = alignUp(rangeOffset, alignment);
+
+			// Free ranges are always merged, so both neighbours are in use
+			if (bufferImageGranularity > 1 && it != block->ranges.begin())
+			{
+				auto prev = std::prev(it);
+				if (typesConflict(prev->second.type, type) && onSamePage(prev->first, prev->second.size, offset, bufferImageGranularity))
+				{
+					offset = alignUp(offset, bufferImageGranularity);
+				}
+			}
+			if (offset + size > rangeEnd)
+			{
+				continue;
+			}
+			if (bufferImageGranularity > 1)
+			{
+				auto next = std::next(it);
+				if (next != block->ranges.end() && typesConflict(next->second.type, type) && onSamePage(offset, size, next->first, bufferImageGranularity))
+				{
+					continue;
+				}
+			}
+
+			// Split the free range into [padding][allocation][remainder]
+			block->ranges.erase(it);
+			if (offset > rangeOffset)
+			{
+				block->ranges[rangeOffset] = { offset - rangeOffset, AllocationType::Free };
+			}
+			block->ranges[offset] = { size, type };
+			if (offset + size < rangeEnd)
+			{
+				block->ranges[offset + size] = { rangeEnd - offset - size, AllocationType::Free };
+			}
+			block->allocationCount++;
+			block->usedBytes += size;
+
+			allocation->allocator = this;
+			allocation->memory = block->memory;
+			allocation->offset = offset;
+			allocation->size = size;
+			allocation->memoryTypeIndex = block->memoryTypeIndex;
+			allocation->mapped = block->mapped ? block->mapped + offset : nullptr;
+			allocation->block = block;
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	* Sub-allocate device memory
+	*
+	* @param memReqs Memory requirements of the resource (size, alignment)
+	* @param memoryTypeIndex Memory type to allocate from (see VulkanDevice::getMemoryType)
+	* @param type Linear for buffers and linear tiled images, Optimal for optimal tiled images
+	* @param allocation Pointer to the allocation handle filled by the function
+	* @param pNext (Optional) Extension structures for vkAllocateMemory, forces a dedicated block
+	*
+	* @return VK_SUCCESS or the error of the failed vkAllocateMemory call
+	*/
+	VkResult MemoryAllocator::allocate(const VkMemoryRequirements& memReqs, uint32_t memoryTypeIndex, AllocationType type, Allocation* allocation, const void* pNext)
+	{
+		assert(device);
+		assert(type != AllocationType::Free);
+		std::lock_guard<std::mutex> lock(mutex);
+
+		VkDeviceSize alignment = std::max<VkDeviceSize>(memReqs.alignment, 1);
+		VkDeviceSize size = memReqs.size;
+		// Keep flush and invalidate ranges of non-coherent memory on atom boundaries
+		const VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+		{
+			alignment = std::max(alignment, nonCoherentAtomSize);
+			size = alignUp(size, nonCoherentAtomSize);
+		}
+
+		const VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+		Block* block = nullptr;
+		if (pNext != nullptr || size > blockSize / 2)
+		{
+			VkResult result = createBlock(memoryTypeIndex, size, true, pNext, &block);
+			if (result != VK_SUCCESS)
+			{
+				return result;
+			}
+			allocateFromBlock(block, size, alignment, type, allocation);
+			return VK_SUCCESS;
+		}
+
+		for (auto& candidate : blocks[memoryTypeIndex])
+		{
+			if (!candidate->dedicated && candidate->size - candidate->usedBytes >= size && allocateFromBlock(candidate.get(), size, alignment, type, allocation))
+			{
+				return VK_SUCCESS;
+			}
+		}
+
+		VkResult result = createBlock(memoryTypeIndex, blockSize, false, nullptr, &block);
+		if (result != VK_SUCCESS)
+		{
+			return result;
+		}
+		allocateFromBlock(block, size, alignment, type, allocation);
+		return VK_SUCCESS;
+	}
+
+	/**
+	* Return an allocation to its block and merge it with adjacent free ranges
+	*
+	* @note Empty dedicated blocks and empty pooled blocks, except for the last one of a memory type, are released to the device
+	*/
+	void MemoryAllocator::free(Allocation& allocation)
+	{
+		if (!allocation)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		Block* block = static_cast<Block*>(allocation.block);
+		auto it = block->ranges.find(allocation.offset);
+		assert(it != block->ranges.end() && it->second.type != AllocationType::Free);
+
+		block->allocationCount--;
+		block->usedBytes -= it->second.size;
+		it->second.type = AllocationType::Free;
+		auto next = std::next(it);
+		if (next != block->ranges.end() && next->second.type == AllocationType::Free)
+		{
+			it->second.size += next->second.size;
+			block->ranges.erase(next);
+		}
+		if (it != block->ranges.begin())
+		{
+			auto prev = std::prev(it);
+			if (prev->second.type == AllocationType::Free)
+			{
+				prev->second.size += it->second.size;
+				block->ranges.erase(it);
+			}
+		}
+
+		auto& typeBlocks = blocks[block->memoryTypeIndex];
+		const auto pooledBlocks = std::count_if(typeBlocks.begin(), typeBlocks.end(), [](const std::unique_ptr<Block>& b) { return !b->dedicated; });
+		if (block->allocationCount == 0 && (block->dedicated || pooledBlocks > 1))
+		{
+			destroyBlock(block);
+			typeBlocks.erase(std::find_if(typeBlocks.begin(), typeBlocks.end(), [block](const std::unique_ptr<Block>& b) { return b.get() == block; }));
+		}
+
+		allocation = Allocation();
+	}
+
+	void MemoryAllocator::fillStats(const Block* block, Stats& stats) const
+	{
+		stats.blockCount++;
+		stats.allocationCount += block->allocationCount;
+		stats.blockBytes += block->size;
+		stats.usedBytes += block->usedBytes;
+	}
+
+	/**
+	* Get usage statistics over all memory types
+	*/
+	MemoryAllocator::Stats MemoryAllocator::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Stats stats;
+		for (auto& typeBlocks : blocks)
+		{
+			for (auto& block : typeBlocks)
+			{
+				fillStats(block.get(), stats);
+			}
+		}
+		stats.deviceAllocations = deviceAllocations;
+		return stats;
+	}
+
+	/**
+	* Get usage statistics of a single memory type
+	*/
+	MemoryAllocator::Stats MemoryAllocator::getStats(uint32_t memoryTypeIndex) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Stats stats;
+		for (auto& block : blocks[memoryTypeIndex])
+		{
+			fillStats(block.get(), stats);
+		}
+		stats.deviceAllocations = deviceAllocations;
+		return stats;
+	}
+
+	void MemoryAllocator::printStats() const
+	{
+		const double toMB = 1.0 / (1024.0 * 1024.0);
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "Device memory (allocator)\n";
+		for (uint32_t i = 0; i < static_cast<uint32_t>(blocks.size()); i++)
+		{
+			Stats stats = getStats(i);
+			if (stats.blockCount == 0)
+			{
+				continue;
+			}
+			std::cout << "  type " << i << " (heap " << memoryProperties.memoryTypes[i].heapIndex << "): "
+				<< stats.blockCount << " block(s), " << stats.allocationCount << " allocation(s), "
+				<< stats.usedBytes * toMB << " / " << stats.blockBytes * toMB << " MB used\n";
+		}
+		Stats total = getStats();
+		std::cout << "  total: " << total.usedBytes * toMB << " / " << total.blockBytes * toMB << " MB used in " << total.blockCount << " block(s), "
+			<< total.deviceAllocations << " vkAllocateMemory call(s)\n";
+	}
+}
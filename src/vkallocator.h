@@ -0,0 +1,133 @@
+/*
+* Vulkan memory allocator
+*
+* Sub-allocates buffers and images from large per-memory-type device memory blocks
+*
+* Copyright (C)
+*
+*/
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "vktools.h"
+
+namespace vks
+{
+	class MemoryAllocator;
+
+	/**
+	* @brief Resource type of a sub-allocation
+	* @note Linear (buffers, linear images) and optimal (tiled images) resources must not share a bufferImageGranularity page
+	*/
+	enum class AllocationType
+	{
+		Free,
+		Linear,
+		Optimal
+	};
+
+	/**
+	* @brief Handle to a range of device memory handed out by the memory allocator
+	*/
+	struct Allocation
+	{
+		/** @brief Allocator that owns this allocation, nullptr if empty */
+		MemoryAllocator* allocator = nullptr;
+		/** @brief Device memory block the allocation lives in */
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		/** @brief Byte offset of the allocation inside the memory block */
+		VkDeviceSize offset = 0;
+		/** @brief Size of the allocation in bytes */
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		/** @brief Host pointer to the start of the allocation if the block is host visible (blocks are mapped persistently) */
+		void* mapped = nullptr;
+		/** @brief Opaque pointer to the owning block, used when freeing */
+		void* block = nullptr;
+
+		operator bool() const
+		{
+			return memory != VK_NULL_HANDLE;
+		}
+		void free();
+	};
+
+	/**
+	* @brief Pooled device memory allocator
+	*
+	* Keeps a list of large device memory blocks per memory type and hands out aligned ranges from them
+	* using a first fit free list. Freed ranges are merged with their free neighbours and go back to the pool.
+	* Requests that are larger than half of the block size get a dedicated block of their own.
+	*/
+	class MemoryAllocator
+	{
+	public:
+		struct Stats
+		{
+			/** @brief Number of VkDeviceMemory objects currently allocated */
+			uint32_t blockCount = 0;
+			/** @brief Number of live sub-allocations */
+			uint32_t allocationCount = 0;
+			/** @brief Bytes reserved from the device */
+			VkDeviceSize blockBytes = 0;
+			/** @brief Bytes handed out to resources, alignment padding between them stays free and is not counted */
+			VkDeviceSize usedBytes = 0;
+			/** @brief Total number of vkAllocateMemory calls issued so far */
+			uint32_t deviceAllocations = 0;
+		};
+
+		/** @brief Default size of a memory block, smaller heaps use an eighth of the heap size */
+		static constexpr VkDeviceSize defaultBlockSize = 256ull * 1024 * 1024;
+
+		void prepare(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits);
+		void destroy();
+
+		VkResult allocate(const VkMemoryRequirements& memReqs, uint32_t memoryTypeIndex, AllocationType type, Allocation* allocation, const void* pNext = nullptr);
+		void free(Allocation& allocation);
+
+		Stats getStats() const;
+		Stats getStats(uint32_t memoryTypeIndex) const;
+		void printStats() const;
+
+	private:
+		struct Suballocation
+		{
+			VkDeviceSize size;
+			AllocationType type;
+		};
+
+		struct Block
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeIndex = 0;
+			uint8_t* mapped = nullptr;
+			/** @brief Dedicated blocks hold exactly one allocation and are released when it is freed */
+			bool dedicated = false;
+			uint32_t allocationCount = 0;
+			VkDeviceSize usedBytes = 0;
+			/** @brief All ranges of the block, free and used, keyed by offset */
+			std::map<VkDeviceSize, Suballocation> ranges;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		VkDeviceSize bufferImageGranularity = 1;
+		VkDeviceSize nonCoherentAtomSize = 1;
+		std::vector<std::vector<std::unique_ptr<Block>>> blocks;
+		uint32_t deviceAllocations = 0;
+		mutable std::mutex mutex;
+
+		VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+		VkResult createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated, const void* pNext, Block** block);
+		void destroyBlock(Block* block);
+		bool allocateFromBlock(Block* block, VkDeviceSize size, VkDeviceSize alignment, AllocationType type, Allocation* allocation);
+		void fillStats(const Block* block, Stats& stats) const;
+	};
+}
@@ -0,0 +1,307 @@
+/*
+* Background asset loader
+*
+* Loads glTF models and textures on worker threads and uploads them once they have been decoded
+*
+* Copyright (C)
+*
+*/
+
+#include "vkassetloader.h"
+
+#include <algorithm>
+
+#include "stb_image.h"
+
+namespace vks
+{
+	/**
+	* @return True for the last decode job of the asset to finish
+	*/
+	bool AsyncAsset::jobFinished()
+	{
+		return pendingJobs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+	}
+
+	void AsyncAsset::decoded()
+	{
+		state.store(AssetState::Decoded, std::memory_order_release);
+	}
+
+	void AsyncAsset::fail(const std::string& reason)
+	{
+		error = reason;
+		state.store(AssetState::Failed, std::memory_order_release);
+	}
+
+	/**
+	* Draw the model once it is resident, does nothing before
+	*/
+	void AsyncModel::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t bindNodeSet)
+	{
+		if (resident())
+		{
+			model.draw(commandBuffer, renderFlags, pipelineLayout, bindImageSet, bindNodeSet);
+		}
+	}
+
+	AsyncTexture::~AsyncTexture()
+	{
+		const AssetState currentState = getState();
+		if ((currentState == AssetState::Uploading) || (currentState == AssetState::Resident))
+		{
+			// The upload may still be writing to the image
+			uploadTicket.wait();
+			texture.destroy();
+		}
+		if (ktx)
+		{
+			ktxTexture_Destroy(ktx);
+		}
+	}
+
+	/**
+	* @return Descriptor of the texture if it is resident, the descriptor of the loader's placeholder otherwise
+	*/
+	const VkDescriptorImageInfo& AsyncTexture::getDescriptor() const
+	{
+		return resident() ? texture.descriptor : placeholder->descriptor;
+	}
+
+	/**
+	* Start the worker threads and create the placeholder texture
+	*
+	* @param device Device the assets are created on
+	* @param threadCount (Optional) Number of worker threads, 0 picks one per hardware thread except for the calling one
+	*/
+	void AssetLoader::prepare(vks::VulkanDevice* device, uint32_t threadCount)
+	{
+		this->device = device;
+		copyQueue = device->transferQueue;
+		pool.prepare(threadCount);
+
+		// Mid grey, so assets that are still streaming in stand out neither on bright nor on dark scenes
+		uint8_t texel[4] = { 128, 128, 128, 255 };
+		placeholder.fromBuffer(texel, sizeof(texel), VK_FORMAT_R8G8B8A8_UNORM, 1, 1, device, device->graphicsQueue);
+	}
+
+	/**
+	* Finish all decode jobs and release the assets that are not resident yet
+	*/
+	void AssetLoader::destroy()
+	{
+		if (!device)
+		{
+			return;
+		}
+		pool.destroy();
+		models.clear();
+		textures.clear();
+		device->transfer.waitIdle();
+		placeholder.destroy();
+		device = nullptr;
+	}
+
+	/**
+	* Queue a glTF model for loading
+	*
+	* @param filename glTF file to load
+	* @param fileLoadingFlags (Optional) vkglTF::FileLoadingFlags to load the file with
+	* @param scale (Optional) Scale applied to the vertex positions
+	* @param vertexLayout (Optional) Layout the vertices are stored in, defaults to the one of vkglTF::Vertex
+	*
+	* @return Handle to the model, the model can be drawn once the handle is resident
+	*/
+	std::shared_ptr<AsyncModel> AssetLoader::loadModel(std::string filename, uint32_t fileLoadingFlags, float scale, const vkglTF::VertexLayout& vertexLayout)
+	{
+		std::shared_ptr<AsyncModel> asset = std::make_shared<AsyncModel>();
+		asset->filename = filename;
+		asset->fileLoadingFlags = fileLoadingFlags;
+		asset->scale = scale;
+		asset->vertexLayout = vertexLayout;
+		// The jobs only get a plain pointer, the loader keeps the asset alive until it leaves the decoding states
+		models.push_back(asset);
+		AsyncModel* target = asset.get();
+		pool.push([this, target] { decodeModel(target); });
+		return asset;
+	}
+
+	/**
+	* Queue a 2D texture for loading
+	*
+	* @param filename Image file to load (ktx files are uploaded as stored, all other formats are decoded to 8 bit RGBA)
+	* @param format Vulkan format of the image data
+	*
+	* @return Handle to the texture, its descriptor points at the placeholder until the handle is resident
+	*/
+	std::shared_ptr<AsyncTexture> AssetLoader::loadTexture(std::string filename, VkFormat format)
+	{
+		std::shared_ptr<AsyncTexture> asset = std::make_shared<AsyncTexture>();
+		asset->filename = filename;
+		asset->format = format;
+		asset->placeholder = &placeholder;
+		textures.push_back(asset);
+		AsyncTexture* target = asset.get();
+		pool.push([this, target] { decodeTexture(target); });
+		return asset;
+	}
+
+	/**
+	* Upload decoded assets and advance the state of submitted ones
+	*
+	* @note Call once per frame on the rendering thread, before the transfer contexts are submitted
+	*/
+	void AssetLoader::update()
+	{
+		VkDeviceSize uploaded = 0;
+		bool budgetLeft = true;
+
+		for (std::shared_ptr<AsyncModel>& asset : models)
+		{
+			if (budgetLeft && (asset->getState() == AssetState::Decoded))
+			{
+				uploaded += uploadModel(*asset);
+				budgetLeft = uploaded < uploadBudget;
+			}
+		}
+		for (std::shared_ptr<AsyncTexture>& asset : textures)
+		{
+			if (budgetLeft && (asset->getState() == AssetState::Decoded))
+			{
+				uploaded += uploadTexture(*asset);
+				budgetLeft = uploaded < uploadBudget;
+			}
+		}
+
+		// Work submitted after the upload batch sees the data, as the uploads end with barriers to the consuming stages
+		auto settle = [](const std::shared_ptr<AsyncAsset>& asset)
+		{
+			if ((asset->getState() == AssetState::Uploading) && asset->uploadTicket.submitted())
+			{
+				asset->state.store(AssetState::Resident, std::memory_order_release);
+			}
+			const AssetState state = asset->getState();
+			return (state == AssetState::Resident) || (state == AssetState::Failed);
+		};
+		models.erase(std::remove_if(models.begin(), models.end(), settle), models.end());
+		textures.erase(std::remove_if(textures.begin(), textures.end(), settle), textures.end());
+	}
+
+	/**
+	* @return True if no asset is waiting to be decoded or uploaded
+	*/
+	bool AssetLoader::idle() const
+	{
+		return models.empty() && textures.empty();
+	}
+
+	void AssetLoader::decodeModel(AsyncModel* asset)
+	{
+		std::string error;
+		if (!asset->model.parseFile(asset->filename, device, asset->fileLoadingFlags, asset->scale, asset->vertexLayout, &error))
+		{
+			asset->fail("Could not load glTF file \"" + asset->filename + "\": " + error);
+			return;
+		}
+
+		// Every image gets a job of its own, the scene structure is built alongside them
+		// Once the structure is known, the geometry conversion is split into batches of its own as well
+		// The last job to finish bakes the model cache (if needed) before the asset is handed to update()
+		auto finishJob = [asset]
+		{
+			if (asset->jobFinished())
+			{
+				asset->model.finishDecode();
+				asset->decoded();
+			}
+		};
+		const uint32_t imageCount = static_cast<uint32_t>(asset->model.textures.size());
+		asset->pendingJobs.store(imageCount + 1, std::memory_order_relaxed);
+		for (uint32_t i = 0; i < imageCount; i++)
+		{
+			pool.push([asset, i, finishJob]
+			{
+				asset->model.decodeImage(i);
+				finishJob();
+			});
+		}
+		asset->model.decodeScene();
+		// This job still counts as pending, so the count can't drop to zero before the batches have been added
+		const uint32_t batchCount = asset->model.getGeometryBatchCount();
+		asset->pendingJobs.fetch_add(batchCount, std::memory_order_relaxed);
+		for (uint32_t i = 0; i < batchCount; i++)
+		{
+			pool.push([asset, i, finishJob]
+			{
+				asset->model.decodeGeometry(i);
+				finishJob();
+			});
+		}
+		finishJob();
+	}
+
+	void AssetLoader::decodeTexture(AsyncTexture* asset)
+	{
+		if (!vks::tools::fileExists(asset->filename))
+		{
+			asset->fail("Could not load texture from " + asset->filename);
+			return;
+		}
+
+		std::string extension = asset->filename.substr(asset->filename.find_last_of(".") + 1);
+		if (extension == "ktx")
+		{
+			if (ktxTexture_CreateFromNamedFile(asset->filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &asset->ktx) != KTX_SUCCESS)
+			{
+				asset->fail("Could not load ktx texture " + asset->filename);
+				return;
+			}
+		}
+		else
+		{
+			int texWidth, texHeight, texComponents;
+			stbi_uc* pixels = stbi_load(asset->filename.c_str(), &texWidth, &texHeight, &texComponents, STBI_rgb_alpha);
+			if (!pixels)
+			{
+				asset->fail("Could not decode image " + asset->filename + ": " + stbi_failure_reason());
+				return;
+			}
+			asset->width = static_cast<uint32_t>(texWidth);
+			asset->height = static_cast<uint32_t>(texHeight);
+			asset->pixels.assign(pixels, pixels + asset->width * asset->height * 4);
+			stbi_image_free(pixels);
+		}
+		asset->decoded();
+	}
+
+	VkDeviceSize AssetLoader::uploadModel(AsyncModel& asset)
+	{
+		VkDeviceSize size = asset.model.getPendingUploadSize();
+		asset.model.upload(copyQueue);
+		asset.uploadTicket = asset.model.uploadTicket;
+		asset.state.store(AssetState::Uploading, std::memory_order_release);
+		return size;
+	}
+
+	VkDeviceSize AssetLoader::uploadTexture(AsyncTexture& asset)
+	{
+		VkDeviceSize size;
+		if (asset.ktx)
+		{
+			size = ktxTexture_GetSize(asset.ktx);
+			asset.texture.fromKtxTexture(asset.ktx, asset.format, device, copyQueue);
+			ktxTexture_Destroy(asset.ktx);
+			asset.ktx = nullptr;
+		}
+		else
+		{
+			size = asset.pixels.size();
+			asset.texture.fromBuffer(asset.pixels.data(), size, asset.format, asset.width, asset.height, device, copyQueue);
+			asset.pixels = std::vector<unsigned char>();
+		}
+		// On the dedicated transfer queue the ticket is the one of the graphics batch that acquires the image
+		asset.uploadTicket = (device->getOwnerQueue(copyQueue) != copyQueue) ? device->transfer.currentTicket(device->graphicsQueue) : device->getTransferContext(copyQueue).currentTicket(copyQueue);
+		asset.state.store(AssetState::Uploading, std::memory_order_release);
+		return size;
+	}
+}
@@ -0,0 +1,160 @@
+/*
+* Background asset loader
+*
+* Loads glTF models and textures on worker threads and uploads them once they have been decoded
+*
+* Copyright (C)
+*
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "vkdevice.h"
+#include "vkgltf.h"
+#include "vktexture.h"
+#include "vkthreadpool.h"
+#include "vktransfer.h"
+
+namespace vks
+{
+	enum class AssetState
+	{
+		/** @brief File is being parsed and decoded on the worker threads */
+		Decoding,
+		/** @brief CPU side data is complete and waits for its upload */
+		Decoded,
+		/** @brief Upload has been recorded, the transfer batch has not been submitted yet */
+		Uploading,
+		/** @brief Upload has been submitted, the asset can be used by work submitted from now on */
+		Resident,
+		/** @brief Loading failed, see error */
+		Failed
+	};
+
+	/**
+	* @brief Handle to an asset that is loaded in the background
+	*
+	* Handles are shared between the application and the loader. The state advances as the loader
+	* works on the asset, so the application polls resident() instead of blocking on the load.
+	*/
+	class AsyncAsset
+	{
+	public:
+		std::string filename;
+		/** @brief Reason for the failure, only valid in the Failed state */
+		std::string error;
+		/** @brief Ticket of the transfer batch that uploads the asset, valid from the Uploading state on */
+		vks::TransferTicket uploadTicket;
+
+		AssetState getState() const
+		{
+			return state.load(std::memory_order_acquire);
+		}
+		bool resident() const
+		{
+			return getState() == AssetState::Resident;
+		}
+		bool failed() const
+		{
+			return getState() == AssetState::Failed;
+		}
+
+	protected:
+		friend class AssetLoader;
+		std::atomic<AssetState> state{ AssetState::Decoding };
+		/** @brief Decode jobs of the asset that have not finished yet, the last one to finish moves the asset to Decoded */
+		std::atomic<uint32_t> pendingJobs{ 0 };
+
+		bool jobFinished();
+		void decoded();
+		void fail(const std::string& reason);
+	};
+
+	/** @brief Handle to a glTF model loaded in the background */
+	class AsyncModel : public AsyncAsset
+	{
+	public:
+		vkglTF::Model model;
+
+		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t bindNodeSet = 2);
+
+	private:
+		friend class AssetLoader;
+		uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None;
+		float scale = 1.0f;
+		vkglTF::VertexLayout vertexLayout;
+	};
+
+	/** @brief Handle to a 2D texture loaded in the background */
+	class AsyncTexture : public AsyncAsset
+	{
+	public:
+		vks::Texture2D texture;
+
+		~AsyncTexture();
+		const VkDescriptorImageInfo& getDescriptor() const;
+
+	private:
+		friend class AssetLoader;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		/** @brief Texture whose descriptor is handed out until this one is resident */
+		const vks::Texture2D* placeholder = nullptr;
+		/** @brief Decoded data of ktx files */
+		ktxTexture* ktx = nullptr;
+		/** @brief Decoded RGBA data of all other image files */
+		std::vector<unsigned char> pixels;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	/**
+	* @brief Loads models and textures without stalling the render loop
+	*
+	* File parsing, image decoding and vertex conversion run as jobs on a pool of worker threads,
+	* with every image and every batch of a model's geometry decoded by a job of its own. Decoded assets are uploaded by update(),
+	* which records their copies through the device's staging ring and transfer contexts, so the uploads
+	* use the transfer contexts' own command pools and go to the queue with the next transfer submit.
+	*
+	* @note The queues, the staging ring and the transfer contexts are externally synchronized, so the loader records and submits nothing
+	* on the worker threads. update() has to be called on the thread that renders, before the transfer contexts are submitted for a frame.
+	*/
+	class AssetLoader
+	{
+	public:
+		/** @brief 1x1 texture bound in place of textures that are not resident yet */
+		vks::Texture2D placeholder;
+		/** @brief Upper bound for the decoded bytes uploaded by one update(), at least one asset is uploaded per call */
+		VkDeviceSize uploadBudget = 32ull * 1024 * 1024;
+
+		void prepare(vks::VulkanDevice* device, uint32_t threadCount = 0);
+		void destroy();
+
+		std::shared_ptr<AsyncModel> loadModel(std::string filename, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f, const vkglTF::VertexLayout& vertexLayout = vkglTF::VertexLayout());
+		std::shared_ptr<AsyncTexture> loadTexture(std::string filename, VkFormat format);
+		void update();
+		bool idle() const;
+
+	private:
+		vks::VulkanDevice* device = nullptr;
+		/** @brief Queue the uploads are recorded for, the dedicated transfer queue if the device has one */
+		VkQueue copyQueue = VK_NULL_HANDLE;
+		vks::ThreadPool pool;
+		/**
+		* @brief Assets that are not resident yet, only accessed on the thread calling update()
+		* @note Holding the references here keeps an asset alive while jobs work on it, even if the application has dropped its handle
+		*/
+		std::vector<std::shared_ptr<AsyncModel>> models;
+		std::vector<std::shared_ptr<AsyncTexture>> textures;
+
+		void decodeModel(AsyncModel* asset);
+		void decodeTexture(AsyncTexture* asset);
+		VkDeviceSize uploadModel(AsyncModel& asset);
+		VkDeviceSize uploadTexture(AsyncTexture& asset);
+	};
+}
@@ -22,28 +22,31 @@ namespace vks
 	/**
 	* Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
 	*
+	* @note Host visible memory blocks are persistently mapped by the allocator, so this only hands out a pointer into that mapping
+	*
 	* @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete buffer range.
 	* @param offset (Optional) Byte offset from beginning
 	*
-	* @return VkResult of the buffer mapping call
+	* @return VK_SUCCESS, or VK_ERROR_MEMORY_MAP_FAILED if the buffer is not backed by host visible memory
 	*/
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
-		return vkMapMemory(device, memory, offset, size, 0, &mapped);
+		if (!allocation.mapped)
+		{
+			return VK_ERROR_MEMORY_MAP_FAILED;
+		}
+		mapped = static_cast<uint8_t*>(allocation.mapped) + offset;
+		return VK_SUCCESS;
 	}
 
 	/**
 	* Unmap a mapped memory range
 	*
-	* @note Does not return a result as vkUnmapMemory can't fail
+	* @note The underlying memory block stays mapped until it is released by the allocator
 	*/
 	void Buffer::unmap()
 	{
-		if (mapped)
-		{
-			vkUnmapMemory(device, memory);
-			mapped = nullptr;
-		}
+		mapped = nullptr;
 	}
 
 	/**
@@ -55,7 +58,7 @@ namespace vks
 	*/
 	VkResult Buffer::bind(VkDeviceSize offset)
 	{
-		return vkBindBufferMemory(device, buffer, memory, offset);
+		return vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset + offset);
 	}
 
 	/**
@@ -99,9 +102,9 @@ namespace vks
 	{
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		mappedRange.memory = allocation.memory;
+		mappedRange.offset = allocation.offset + offset;
+		mappedRange.size = (size == VK_WHOLE_SIZE) ? allocation.size - offset : size;
 		return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -119,9 +122,9 @@ namespace vks
 	{
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		mappedRange.memory = allocation.memory;
+		mappedRange.offset = allocation.offset + offset;
+		mappedRange.size = (size == VK_WHOLE_SIZE) ? allocation.size - offset : size;
 		return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -134,9 +137,7 @@ namespace vks
 		{
 			vkDestroyBuffer(device, buffer, nullptr);
 		}
-		if (memory)
-		{
-			vkFreeMemory(device, memory, nullptr);
-		}
+		allocation.free();
+		mapped = nullptr;
 	}
 };
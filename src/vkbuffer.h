@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "vulkan/vulkan.h"
+#include "vkallocator.h"
 #include "vktools.h"
 
 namespace vks
@@ -31,7 +32,8 @@ namespace vks
 	{
 		VkDevice device;
 		VkBuffer buffer = VK_NULL_HANDLE;
-		VkDeviceMemory memory = VK_NULL_HANDLE;
+		/** @brief Sub-allocated range of device memory backing the buffer */
+		vks::Allocation allocation;
 		VkDescriptorBufferInfo descriptor;
 		VkDeviceSize size = 0;
 		VkDeviceSize alignment = 0;
@@ -62,7 +62,7 @@ namespace vks
 	/**
 	* Default destructor
 	*
-	* @note Frees the logical device
+	* @note Waits for pending uploads, frees the memory allocator's blocks and the logical device
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
@@ -72,6 +72,10 @@ namespace vks
 		}
 		if (logicalDevice)
 		{
+			stagingRing.destroy();
+			transfer.destroy();
+			asyncTransfer.destroy();
+			allocator.destroy();
 			vkDestroyDevice(logicalDevice, nullptr);
 		}
 	}
@@ -291,6 +295,29 @@ namespace vks
 		}
 
 		this->enabledFeatures = enabledFeatures;
+		this->enabledExtensions.assign(deviceExtensions.begin(), deviceExtensions.end());
+
+		// Keep track of the enabled descriptor indexing features, either from the extension's structure or from the Vulkan 1.2 features
+		enabledDescriptorIndexingFeatures = {};
+		enabledDrawIndirectCount = false;
+		for (const VkBaseOutStructure* next = static_cast<const VkBaseOutStructure*>(pNextChain); next; next = next->pNext)
+		{
+			if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT)
+			{
+				enabledDescriptorIndexingFeatures = *reinterpret_cast<const VkPhysicalDeviceDescriptorIndexingFeaturesEXT*>(next);
+			}
+			if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES)
+			{
+				const VkPhysicalDeviceVulkan12Features* features12 = reinterpret_cast<const VkPhysicalDeviceVulkan12Features*>(next);
+				enabledDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = features12->shaderSampledImageArrayNonUniformIndexing;
+				enabledDescriptorIndexingFeatures.descriptorBindingPartiallyBound = features12->descriptorBindingPartiallyBound;
+				enabledDescriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = features12->descriptorBindingVariableDescriptorCount;
+				enabledDescriptorIndexingFeatures.runtimeDescriptorArray = features12->runtimeDescriptorArray;
+				enabledDrawIndirectCount = features12->drawIndirectCount == VK_TRUE;
+			}
+		}
+		enabledDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		enabledDescriptorIndexingFeatures.pNext = nullptr;
 
 		VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice);
 		if (result != VK_SUCCESS)
@@ -301,9 +328,36 @@ namespace vks
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		vkGetDeviceQueue(logicalDevice, queueFamilyIndices.graphics, 0, &graphicsQueue);
+		vkGetDeviceQueue(logicalDevice, queueFamilyIndices.transfer, 0, &transferQueue);
+
+		allocator.prepare(logicalDevice, memoryProperties, properties.limits);
+		transfer.prepare(this, queueFamilyIndices.graphics);
+		if (hasDedicatedTransferQueue())
+		{
+			asyncTransfer.prepare(this, queueFamilyIndices.transfer);
+		}
+		stagingRing.prepare(this);
+
 		return result;
 	}
 
+	/**
+	* Sub-allocate device memory for a resource from the device's memory allocator
+	*
+	* @param memReqs Memory requirements of the resource (from vkGet*MemoryRequirements)
+	* @param memoryPropertyFlags Memory properties the allocation needs (i.e. device local, host visible, coherent)
+	* @param type Linear for buffers and linear tiled images, Optimal for optimal tiled images
+	* @param allocation Pointer to the allocation handle acquired by the function
+	* @param pNext (Optional) Extension structures passed to vkAllocateMemory, these get a dedicated memory block
+	*
+	* @return VK_SUCCESS if the memory could be allocated
+	*/
+	VkResult VulkanDevice::allocateMemory(const VkMemoryRequirements& memReqs, VkMemoryPropertyFlags memoryPropertyFlags, vks::AllocationType type, vks::Allocation* allocation, const void* pNext)
+	{
+		return allocator.allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), type, allocation, pNext);
+	}
+
 	/**
 	* Create a buffer on the device
 	*
@@ -311,54 +365,49 @@ namespace vks
 	* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
 	* @param size Size of the buffer in byes
 	* @param buffer Pointer to the buffer handle acquired by the function
-	* @param memory Pointer to the memory handle acquired by the function
+	* @param allocation Pointer to the memory allocation acquired by the function
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 	*/
-	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, void* data)
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, vks::Allocation* allocation, void* data)
 	{
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
 
-		// Create the memory backing up the buffer handle
+		// Sub-allocate the memory backing up the buffer handle
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, *buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
 		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
 		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		const void* pNext = nullptr;
 		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
 			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
 			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
+			pNext = &allocFlagsInfo;
 		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, memory));
+		VK_CHECK_RESULT(allocateMemory(memReqs, memoryPropertyFlags, vks::AllocationType::Linear, allocation, pNext));
 
-		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
+		// If a pointer to the buffer data has been passed, copy it into the (persistently mapped) allocation
 		if (data != nullptr)
 		{
-			void* mapped;
-			VK_CHECK_RESULT(vkMapMemory(logicalDevice, *memory, 0, size, 0, &mapped));
-			memcpy(mapped, data, size);
+			assert(allocation->mapped);
+			memcpy(allocation->mapped, data, size);
 			// If host coherency hasn't been requested, do a manual flush to make writes visible
 			if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
 			{
 				VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-				mappedRange.memory = *memory;
-				mappedRange.offset = 0;
-				mappedRange.size = size;
+				mappedRange.memory = allocation->memory;
+				mappedRange.offset = allocation->offset;
+				mappedRange.size = allocation->size;
 				vkFlushMappedMemoryRanges(logicalDevice, 1, &mappedRange);
 			}
-			vkUnmapMemory(logicalDevice, *memory);
 		}
 
 		// Attach the memory to the buffer object
-		VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, *buffer, *memory, 0));
+		VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, *buffer, allocation->memory, allocation->offset));
 
 		return VK_SUCCESS;
 	}
@@ -382,21 +431,18 @@ namespace vks
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
-		// Create the memory backing up the buffer handle
+		// Sub-allocate the memory backing up the buffer handle
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
 		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
 		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		const void* pNext = nullptr;
 		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
 			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
 			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
+			pNext = &allocFlagsInfo;
 		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+		VK_CHECK_RESULT(allocateMemory(memReqs, memoryPropertyFlags, vks::AllocationType::Linear, &buffer->allocation, pNext));
 
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
@@ -430,12 +476,12 @@ namespace vks
 	* @param copyRegion (Optional) Pointer to a copy region, if NULL, the whole buffer is copied
 	*
 	* @note Source and destination pointers must have the appropriate transfer usage flags set (TRANSFER_SRC / TRANSFER_DST)
+	* @note Submits together with all other pending uploads of the transfer context and blocks until they have finished
 	*/
 	void VulkanDevice::copyBuffer(vks::Buffer* src, vks::Buffer* dst, VkQueue queue, VkBufferCopy* copyRegion)
 	{
 		assert(dst->size <= src->size);
 		assert(src->buffer);
-		VkCommandBuffer copyCmd = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy bufferCopy{};
 		if (copyRegion == nullptr)
 		{
@@ -446,9 +492,10 @@ namespace vks
 			bufferCopy = *copyRegion;
 		}
 
-		vkCmdCopyBuffer(copyCmd, src->buffer, dst->buffer, 1, &bufferCopy);
+		vkCmdCopyBuffer(transfer.getCommandBuffer(queue), src->buffer, dst->buffer, 1, &bufferCopy);
 
-		flushCommandBuffer(copyCmd, queue);
+		// Callers expect the data to be in place on return
+		transfer.submit().wait();
 	}
 
 	/**
@@ -510,6 +557,7 @@ namespace vks
 	*
 	* @note The queue that the command buffer is submitted to must be from the same family index as the pool it was allocated from
 	* @note Uses a fence to ensure command buffer has finished executing
+	* @note Blocks on every call, uploads should record into the open batch of the transfer context instead
 	*/
 	void VulkanDevice::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free)
 	{
@@ -543,6 +591,92 @@ namespace vks
 		return flushCommandBuffer(commandBuffer, queue, commandPool, free);
 	}
 
+	/**
+	* @return True if uploads on transferQueue run on a different queue family than rendering
+	*/
+	bool VulkanDevice::hasDedicatedTransferQueue() const
+	{
+		return queueFamilyIndices.transfer != queueFamilyIndices.graphics;
+	}
+
+	/**
+	* Get the transfer context whose batches are submitted to the given queue
+	*
+	* @param queue Queue uploads are recorded for
+	*
+	* @return The context of the dedicated transfer family for transferQueue, the graphics family context otherwise
+	*/
+	vks::TransferContext& VulkanDevice::getTransferContext(VkQueue queue)
+	{
+		return (hasDedicatedTransferQueue() && queue == transferQueue) ? asyncTransfer : transfer;
+	}
+
+	/**
+	* Get the queue that owns resources uploaded on copyQueue once the upload is finished
+	*
+	* @return The graphics queue for uploads on the dedicated transfer queue, copyQueue otherwise
+	*/
+	VkQueue VulkanDevice::getOwnerQueue(VkQueue copyQueue) const
+	{
+		return (hasDedicatedTransferQueue() && copyQueue == transferQueue) ? graphicsQueue : copyQueue;
+	}
+
+	/**
+	* Record the transition of an uploaded image to the layout it is used in
+	*
+	* @param copyQueue Queue the upload has been recorded for
+	* @param image Uploaded image
+	* @param subresourceRange Subresources to transition
+	* @param oldLayout Layout the upload left the image in
+	* @param newLayout Layout to transition to
+	* @param dstAccessMask (Optional) First access to the image after the upload (defaults to shader reads)
+	* @param dstStageMask (Optional) Stages of that access (defaults to the fragment shader)
+	*
+	* @note On the dedicated transfer queue this is a queue family ownership transfer to the graphics queue, chained to it with a semaphore
+	*/
+	void VulkanDevice::finishImageUpload(VkQueue copyQueue, VkImage image, VkImageSubresourceRange subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask)
+	{
+		if (getOwnerQueue(copyQueue) == copyQueue)
+		{
+			vks::tools::setImageLayout(transfer.getCommandBuffer(copyQueue), image, oldLayout, newLayout, subresourceRange);
+			return;
+		}
+		VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = dstAccessMask;
+		imageMemoryBarrier.oldLayout = oldLayout;
+		imageMemoryBarrier.newLayout = newLayout;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		asyncTransfer.handOff(copyQueue, transfer, graphicsQueue, dstStageMask, 0, nullptr, 1, &imageMemoryBarrier);
+	}
+
+	/**
+	* Record the barrier that makes an uploaded buffer visible to its first use
+	*
+	* @param copyQueue Queue the upload has been recorded for
+	* @param buffer Uploaded buffer
+	* @param dstAccessMask First access to the buffer after the upload (i.e. vertex attribute or index reads)
+	* @param dstStageMask Stages of that access
+	*
+	* @note On the dedicated transfer queue this is a queue family ownership transfer to the graphics queue, chained to it with a semaphore
+	*/
+	void VulkanDevice::finishBufferUpload(VkQueue copyQueue, VkBuffer buffer, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask)
+	{
+		VkBufferMemoryBarrier bufferMemoryBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferMemoryBarrier.dstAccessMask = dstAccessMask;
+		bufferMemoryBarrier.buffer = buffer;
+		bufferMemoryBarrier.offset = 0;
+		bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+		if (getOwnerQueue(copyQueue) == copyQueue)
+		{
+			vkCmdPipelineBarrier(transfer.getCommandBuffer(copyQueue), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+			return;
+		}
+		asyncTransfer.handOff(copyQueue, transfer, graphicsQueue, dstStageMask, 1, &bufferMemoryBarrier, 0, nullptr);
+	}
+
 	/**
 	* Check if an extension is supported by the (physical device)
 	*
@@ -555,6 +689,18 @@ namespace vks
 		return (std::find(supportedExtensions.begin(), supportedExtensions.end(), extension) != supportedExtensions.end());
 	}
 
+	/**
+	* Check if an extension has been enabled on the logical device
+	*
+	* @param extension Name of the extension to check
+	*
+	* @return True if the extension has been passed to (or added by) createLogicalDevice
+	*/
+	bool VulkanDevice::extensionEnabled(std::string extension)
+	{
+		return (std::find(enabledExtensions.begin(), enabledExtensions.end(), extension) != enabledExtensions.end());
+	}
+
 	/**
 	* Select the best-fit depth format for this device from a list of possible depth (and stencil) formats
 	*
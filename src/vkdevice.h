@@ -9,8 +9,11 @@
 
 #pragma once
 
+#include "vkallocator.h"
 #include "vkbuffer.h"
+#include "vkstaging.h"
 #include "vktools.h"
+#include "vktransfer.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
 #include <assert.h>
@@ -30,14 +33,32 @@ namespace vks
 		VkPhysicalDeviceFeatures features;
 		/** Features that have been enabled for use on the physical device */
 		VkPhysicalDeviceFeatures enabledFeatures;
+		/** Descriptor indexing features that have been enabled through the pNext chain of device creation (all false if none were) */
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledDescriptorIndexingFeatures{};
 		/** Memory types and heaps of the physical device */
 		VkPhysicalDeviceMemoryProperties memoryProperties;
 		/** Queue family properties of the physical device */
 		std::vector<VkQueueFamilyProperties> queueFamilyProperties;
 		/** List of extensions supported by the device */
 		std::vector<std::string> supportedExtensions;
+		/** List of extensions that have been enabled on the logical device */
+		std::vector<std::string> enabledExtensions;
+		/** True if drawIndirectCount of the Vulkan 1.2 features has been enabled through the pNext chain of device creation */
+		bool enabledDrawIndirectCount = false;
 		/** Default command pool for the graphics queue family index */
 		VkCommandPool commandPool = VK_NULL_HANDLE;
+		/** Pooled allocator that all buffers and images of this device sub-allocate their memory from */
+		vks::MemoryAllocator allocator;
+		/** Batched upload submission on the graphics queue family, replaces one-off flushCommandBuffer round trips for uploads */
+		vks::TransferContext transfer;
+		/** Batched upload submission on the dedicated transfer queue family (only prepared if the device has one) */
+		vks::TransferContext asyncTransfer;
+		/** First queue of the graphics family, the same handle the application renders on */
+		VkQueue graphicsQueue = VK_NULL_HANDLE;
+		/** Queue to pass to upload functions, the dedicated transfer queue if the device has one, else the graphics queue */
+		VkQueue transferQueue = VK_NULL_HANDLE;
+		/** Persistently mapped staging ring that texture and buffer uploads copy their data from */
+		vks::StagingRing stagingRing;
 		/** Set to true when the debug marker extension is detected */
 		bool enableDebugMarkers = false;
 		/** Contains queue family indices */
@@ -55,8 +76,9 @@ namespace vks
 		~VulkanDevice();
 		uint32_t        getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32* memTypeFound = nullptr) const;
 		uint32_t        getQueueFamilyIndex(VkQueueFlagBits queueFlags) const;
-		VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char*> enabledExtensions, void* pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
-		VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, void* data = nullptr);
+		VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char*> enabledExtensions, void* pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
+		VkResult        allocateMemory(const VkMemoryRequirements& memReqs, VkMemoryPropertyFlags memoryPropertyFlags, vks::AllocationType type, vks::Allocation* allocation, const void* pNext = nullptr);
+		VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, vks::Allocation* allocation, void* data = nullptr);
 		VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer* buffer, VkDeviceSize size, void* data = nullptr);
 		void            copyBuffer(vks::Buffer* src, vks::Buffer* dst, VkQueue queue, VkBufferCopy* copyRegion = nullptr);
 		VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
@@ -64,7 +86,13 @@ namespace vks
 		VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, bool begin = false);
 		void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free = true);
 		void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true);
+		bool            hasDedicatedTransferQueue() const;
+		vks::TransferContext& getTransferContext(VkQueue queue);
+		VkQueue         getOwnerQueue(VkQueue copyQueue) const;
+		void            finishImageUpload(VkQueue copyQueue, VkImage image, VkImageSubresourceRange subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags dstAccessMask = VK_ACCESS_SHADER_READ_BIT, VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		void            finishBufferUpload(VkQueue copyQueue, VkBuffer buffer, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
 		bool            extensionSupported(std::string extension);
+		bool            extensionEnabled(std::string extension);
 		VkFormat        getSupportedDepthFormat(bool checkSamplingSupport);
 	};
 }         
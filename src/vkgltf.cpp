@@ -17,14 +17,26 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "vkgltf.h"
+#include "vkgltfcache.h"
+#include "vkthreadpool.h"
+
+#include <algorithm>
+#include <functional>
+#include <glm/gtc/packing.hpp>
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
+VkDescriptorSetLayout vkglTF::descriptorSetLayoutIndirect = VK_NULL_HANDLE;
+VkDescriptorSetLayout vkglTF::descriptorSetLayoutBindless = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+uint32_t vkglTF::bindlessPushConstantOffset = 0;
+VkShaderStageFlags vkglTF::bindlessPushConstantStages = VK_SHADER_STAGE_FRAGMENT_BIT;
+uint32_t vkglTF::framesInFlight = 1;
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
+	Decoding is deferred to vkglTF::Texture::decode, so the images of a model can be decoded in parallel
 */
 bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
 {
@@ -35,7 +47,10 @@ bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string
 		}
 	}
 
-	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+	// Keep the encoded file data
+	image->image.assign(bytes, bytes + size);
+	image->as_is = true;
+	return true;
 }
 
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
@@ -45,6 +60,162 @@ bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::s
 }
 
 
+/*
+	Flags that change vertex data after it has been loaded, vertices are always converted to the CPU vertex buffer then
+*/
+const uint32_t vertexModifyingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::OptimizeMeshes | vkglTF::FileLoadingFlags::BuildMeshlets | vkglTF::FileLoadingFlags::GenerateLods;
+
+/*
+	True if the file stores an accessor's elements in the given vertex format, so they can be copied without conversion
+*/
+bool storedInFormat(const tinygltf::Accessor& accessor, VkFormat format)
+{
+	int componentType = -1;
+	bool normalized = false;
+	int32_t componentCount = 0;
+	switch (format) {
+	case VK_FORMAT_R32G32_SFLOAT:
+		componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+		componentCount = 2;
+		break;
+	case VK_FORMAT_R32G32B32_SFLOAT:
+		componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+		componentCount = 3;
+		break;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+		componentCount = 4;
+		break;
+	case VK_FORMAT_R16G16B16A16_SNORM:
+		componentType = TINYGLTF_COMPONENT_TYPE_SHORT;
+		normalized = true;
+		componentCount = 4;
+		break;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		normalized = true;
+		componentCount = 4;
+		break;
+	case VK_FORMAT_R8G8B8A8_UINT:
+		componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		componentCount = 4;
+		break;
+	default:
+		// Half floats don't exist in glTF
+		return false;
+	}
+	return (accessor.componentType == componentType) && (accessor.normalized == normalized) && (tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type)) == componentCount);
+}
+
+/*
+	Returns the start of a primitive's vertex data if the file stores all components of the vertex layout interleaved in a single view,
+	with the layout's stride, offsets and formats, so the vertices can be copied as they are, nullptr otherwise
+	Attributes the layout doesn't have may be stored anywhere else, components without an attribute would need their default values
+*/
+const unsigned char* interleavedVertexData(const tinygltf::Model& model, const tinygltf::Primitive& primitive, const vkglTF::VertexLayout& layout)
+{
+	// Indexed by vkglTF::VertexComponent
+	static const char* const attributeNames[] = { "POSITION", "NORMAL", "TEXCOORD_0", "COLOR_0", "TANGENT", "JOINTS_0", "WEIGHTS_0" };
+	// Joints and weights are only read if both are present
+	if (layout.has(vkglTF::VertexComponent::Joint0) || layout.has(vkglTF::VertexComponent::Weight0)) {
+		if ((primitive.attributes.find("JOINTS_0") == primitive.attributes.end()) || (primitive.attributes.find("WEIGHTS_0") == primitive.attributes.end())) {
+			return nullptr;
+		}
+	}
+	int viewIndex = -1;
+	size_t vertexStart = 0;
+	size_t vertexCount = 0;
+	size_t viewStride = 0;
+	for (vkglTF::VertexComponent component : layout.components) {
+		auto it = primitive.attributes.find(attributeNames[static_cast<uint32_t>(component)]);
+		if (it == primitive.attributes.end()) {
+			return nullptr;
+		}
+		const tinygltf::Accessor& accessor = model.accessors[it->second];
+		const size_t offset = layout.offsets[static_cast<uint32_t>(component)];
+		if ((accessor.bufferView < 0) || accessor.sparse.isSparse || !storedInFormat(accessor, layout.format(component)) || (accessor.byteOffset < offset)) {
+			return nullptr;
+		}
+		// All components have to live in one view with the stride of the layout, at the offsets of the layout
+		if (viewIndex == -1) {
+			viewIndex = accessor.bufferView;
+			vertexStart = accessor.byteOffset - offset;
+			vertexCount = accessor.count;
+			// Tightly packed views (a stride of 0) only hold a single attribute
+			viewStride = static_cast<size_t>(accessor.ByteStride(model.bufferViews[viewIndex]));
+		}
+		if ((accessor.bufferView != viewIndex) || (accessor.byteOffset - offset != vertexStart)) {
+			return nullptr;
+		}
+	}
+	if ((viewIndex == -1) || (viewStride != layout.stride)) {
+		return nullptr;
+	}
+	// The copy includes the padding behind the last vertex, which the file doesn't have to store
+	const tinygltf::BufferView& view = model.bufferViews[viewIndex];
+	const std::vector<unsigned char>& data = model.buffers[view.buffer].data;
+	if (view.byteOffset + vertexStart + vertexCount * layout.stride > data.size()) {
+		return nullptr;
+	}
+	return &data[view.byteOffset + vertexStart];
+}
+
+/*
+	Returns the first index of a primitive's index accessor in the file data, or nullptr if the accessor points outside of its buffer
+*/
+const unsigned char* indexData(const tinygltf::Model& model, const tinygltf::Accessor& accessor)
+{
+	if ((accessor.bufferView < 0) || (accessor.bufferView >= static_cast<int>(model.bufferViews.size()))) {
+		return nullptr;
+	}
+	const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+	if ((view.buffer < 0) || (view.buffer >= static_cast<int>(model.buffers.size()))) {
+		return nullptr;
+	}
+	// Indices are always tightly packed
+	const size_t componentSize = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType)));
+	if (static_cast<size_t>(accessor.ByteStride(view)) != componentSize) {
+		return nullptr;
+	}
+	const std::vector<unsigned char>& data = model.buffers[view.buffer].data;
+	const size_t start = view.byteOffset + accessor.byteOffset;
+	if ((start > data.size()) || (accessor.count * componentSize > data.size() - start)) {
+		return nullptr;
+	}
+	return data.data() + start;
+}
+
+/*
+	Converts a range of glTF indices of any component type to the index type of the model's index buffer
+*/
+template <typename T>
+void convertIndices(int componentType, const unsigned char* data, size_t begin, size_t end, T* dst)
+{
+	switch (componentType) {
+	case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
+		const uint32_t* buf = reinterpret_cast<const uint32_t*>(data);
+		for (size_t i = begin; i < end; i++) {
+			dst[i] = static_cast<T>(buf[i]);
+		}
+		break;
+	}
+	case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
+		const uint16_t* buf = reinterpret_cast<const uint16_t*>(data);
+		for (size_t i = begin; i < end; i++) {
+			dst[i] = static_cast<T>(buf[i]);
+		}
+		break;
+	}
+	case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
+		const uint8_t* buf = reinterpret_cast<const uint8_t*>(data);
+		for (size_t i = begin; i < end; i++) {
+			dst[i] = static_cast<T>(buf[i]);
+		}
+		break;
+	}
+	}
+}
+
 /*
 	glTF texture loading class
 */
@@ -62,87 +233,102 @@ void vkglTF::Texture::destroy()
 	{
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		allocation.free();
 		vkDestroySampler(device->logicalDevice, sampler, nullptr);
 	}
 }
 
 void vkglTF::Texture::fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue)
 {
-	this->device = device;
+	decode(gltfimage, path);
+	upload(device, copyQueue);
+}
+
+/*
+	Decodes the image into CPU memory, doesn't touch the device so it can run on a worker thread
+*/
+void vkglTF::Texture::decode(tinygltf::Image& gltfimage, std::string path)
+{
+	source = std::make_shared<Source>();
 
-	bool isKtx = false;
 	// Image points to an external ktx file
 	if (gltfimage.uri.find_last_of(".") != std::string::npos) {
 		if (gltfimage.uri.substr(gltfimage.uri.find_last_of(".") + 1) == "ktx") {
-			isKtx = true;
+			std::string filename = path + "/" + gltfimage.uri;
+			if (!vks::tools::fileExists(filename)) {
+				vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+			}
+			ktxResult result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &source->ktx);
+			assert(result == KTX_SUCCESS);
+			width = source->ktx->baseWidth;
+			height = source->ktx->baseHeight;
+			mipLevels = source->ktx->numLevels;
+			return;
 		}
 	}
 
-	VkFormat format;
-
-	if (!isKtx) {
-		// Texture was loaded using STB_Image
-
-		unsigned char* buffer = nullptr;
-		VkDeviceSize bufferSize = 0;
-		bool deleteBuffer = false;
-		if (gltfimage.component == 3) {
-			// Most devices don't support RGB only on Vulkan so convert if necessary
-			// TODO: Check actual format support and transform only if required
-			bufferSize = gltfimage.width * gltfimage.height * 4;
-			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &gltfimage.image[0];
-			for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-				for (int32_t j = 0; j < 3; ++j) {
-					rgba[j] = rgb[j];
-				}
-				rgba += 4;
-				rgb += 3;
-			}
-			deleteBuffer = true;
+	if (gltfimage.as_is) {
+		// Encoded file data deferred by the image loader, decode straight to RGBA
+		int texWidth, texHeight, texComponents;
+		stbi_uc* pixels = stbi_load_from_memory(gltfimage.image.data(), static_cast<int>(gltfimage.image.size()), &texWidth, &texHeight, &texComponents, STBI_rgb_alpha);
+		if (!pixels) {
+			vks::tools::exitFatal("Could not decode image \"" + gltfimage.uri + "\": " + stbi_failure_reason(), -1);
 		}
-		else {
-			buffer = &gltfimage.image[0];
-			bufferSize = gltfimage.image.size();
+		width = texWidth;
+		height = texHeight;
+		source->pixels.assign(pixels, pixels + width * height * 4);
+		stbi_image_free(pixels);
+		// The encoded data isn't needed anymore
+		gltfimage.image.clear();
+		gltfimage.image.shrink_to_fit();
+	}
+	else if (gltfimage.component == 3) {
+		// Most devices don't support RGB only on Vulkan so convert if necessary
+		// TODO: Check actual format support and transform only if required
+		width = gltfimage.width;
+		height = gltfimage.height;
+		source->pixels.resize(width * height * 4);
+		unsigned char* rgba = source->pixels.data();
+		unsigned char* rgb = &gltfimage.image[0];
+		for (size_t i = 0; i < width * height; ++i) {
+			for (int32_t j = 0; j < 3; ++j) {
+				rgba[j] = rgb[j];
+			}
+			rgba += 4;
+			rgb += 3;
 		}
+	}
+	else {
+		width = gltfimage.width;
+		height = gltfimage.height;
+		source->pixels = gltfimage.image;
+	}
+	mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+}
 
-		format = VK_FORMAT_R8G8B8A8_UNORM;
+/*
+	Creates the image from the decoded data and records its upload, has to run on the thread that owns the transfer contexts
+*/
+void vkglTF::Texture::upload(vks::VulkanDevice* device, VkQueue copyQueue)
+{
+	assert(source);
+	this->device = device;
 
-		VkFormatProperties formatProperties;
+	VkFormat format;
 
-		width = gltfimage.width;
-		height = gltfimage.height;
-		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+	if (!source->ktx && !source->mipChain) {
+		// Texture was decoded using STB_Image
+		format = VK_FORMAT_R8G8B8A8_UNORM;
 
+		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 
-		VkMemoryAllocateInfo memAllocInfo{};
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		VkMemoryRequirements memReqs{};
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = bufferSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		// Copy the pixels into the device's staging ring
+		vks::StagingRing::Region staging = device->stagingRing.upload(copyQueue, source->pixels.data(), source->pixels.size());
 
 		VkImageCreateInfo imageCreateInfo{};
 		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -159,12 +345,11 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image& gltfimage, std::string path
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		VK_CHECK_RESULT(device->allocateMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vks::AllocationType::Optimal, &allocation));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, allocation.memory, allocation.offset));
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// The copy and the mip chain generation are batched with other uploads in the open batch of the device's transfer context
+		VkCommandBuffer copyCmd = device->getTransferContext(copyQueue).getCommandBuffer(copyQueue);
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -191,28 +376,15 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image& gltfimage, std::string path
 		bufferCopyRegion.imageExtent.width = width;
 		bufferCopyRegion.imageExtent.height = height;
 		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = staging.offset;
 
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
-
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+		// Blits need a graphics queue, so on the dedicated transfer queue the base level is handed over before the mip chain is generated
+		device->finishImageUpload(copyQueue, image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
 		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer blitCmd = device->transfer.getCommandBuffer(device->getOwnerQueue(copyQueue));
 		for (uint32_t i = 1; i < mipLevels; i++) {
 			VkImageBlit imageBlit{};
 
@@ -277,31 +449,15 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image& gltfimage, std::string path
 			imageMemoryBarrier.subresourceRange = subresourceRange;
 			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 		}
-
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
 	}
 	else {
-		// Texture is stored in an external ktx file
-		std::string filename = path + "/" + gltfimage.uri;
-
-		ktxTexture* ktxTexture;
-
-		ktxResult result = KTX_SUCCESS;
-		
-		if (!vks::tools::fileExists(filename)) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+		// Texture comes with its complete mip chain, stored in an external ktx file or baked into the model cache
+		const void* levelData = source->mipChain;
+		VkDeviceSize levelDataSize = source->mipChainSize;
+		if (source->ktx) {
+			levelData = ktxTexture_GetData(source->ktx);
+			levelDataSize = ktxTexture_GetSize(source->ktx);
 		}
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-	
-		assert(result == KTX_SUCCESS);
-
-		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		mipLevels = ktxTexture->numLevels;
-
-		ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
 		// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
 		format = VK_FORMAT_R8G8B8A8_UNORM;
 
@@ -309,46 +465,33 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image& gltfimage, std::string path
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		// Copy the raw image data into the device's staging ring
+		vks::StagingRing::Region staging = device->stagingRing.upload(copyQueue, levelData, levelDataSize, vks::tools::formatTexelBlockSize(format));
 		VkMemoryRequirements memReqs;
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
 
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		// Cached mip chains store the levels tightly packed one after another
+		VkDeviceSize packedOffset = 0;
 		for (uint32_t i = 0; i < mipLevels; i++)
 		{
-			ktx_size_t offset;
-			KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-			assert(result == KTX_SUCCESS);
+			VkDeviceSize offset = packedOffset;
+			if (source->ktx) {
+				ktx_size_t ktxOffset;
+				KTX_error_code result = ktxTexture_GetImageOffset(source->ktx, i, 0, 0, &ktxOffset);
+				assert(result == KTX_SUCCESS);
+				offset = ktxOffset;
+			}
 			VkBufferImageCopy bufferCopyRegion = {};
 			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			bufferCopyRegion.imageSubresource.mipLevel = i;
 			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
 			bufferCopyRegion.imageSubresource.layerCount = 1;
-			bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
-			bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
+			bufferCopyRegion.imageExtent.width = std::max(1u, width >> i);
+			bufferCopyRegion.imageExtent.height = std::max(1u, height >> i);
 			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegion.bufferOffset = staging.offset + offset;
 			bufferCopyRegions.push_back(bufferCopyRegion);
+			packedOffset += bufferCopyRegion.imageExtent.width * bufferCopyRegion.imageExtent.height * 4;
 		}
 
 		// Create optimal tiled target image
@@ -366,10 +509,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image& gltfimage, std::string path
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		VK_CHECK_RESULT(device->allocateMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vks::AllocationType::Optimal, &allocation));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, allocation.memory, allocation.offset));
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -377,17 +518,14 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image& gltfimage, std::string path
 		subresourceRange.levelCount = mipLevels;
 		subresourceRange.layerCount = 1;
 
+		VkCommandBuffer copyCmd = device->getTransferContext(copyQueue).getCommandBuffer(copyQueue);
 		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		device->finishImageUpload(copyQueue, image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
-		ktxTexture_Destroy(ktxTexture);
 	}
+	// The staging ring holds a copy of the data now
+	source.reset();
 
 	VkSamplerCreateInfo samplerInfo{};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -472,28 +610,40 @@ void vkglTF::Primitive::setDimensions(glm::vec3 min, glm::vec3 max) {
 	dimensions.radius = glm::distance(min, max) / 2.0f;
 }
 
+/*
+	Picks the coarsest level of detail whose error stays below threshold pixels when drawn with the given node matrix
+	The error of a level is measured relative to the bounding sphere, so it's projected by the sphere's size on screen
+*/
+uint32_t vkglTF::Primitive::selectLod(const glm::mat4& matrix, const glm::vec3& cameraPosition, float projectionScale, float threshold) const
+{
+	if ((lods.size() < 2) || (dimensions.radius <= 0.0f)) {
+		return 0;
+	}
+	const float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+	const glm::vec3 center = glm::vec3(matrix * glm::vec4(dimensions.center, 1.0f));
+	const float radius = dimensions.radius * scale;
+	const float distance = glm::distance(center, cameraPosition);
+	if (distance <= radius) {
+		return 0;
+	}
+	const float projectedRadius = radius / distance * projectionScale;
+	for (uint32_t lod = static_cast<uint32_t>(lods.size()) - 1; lod > 0; lod--) {
+		if (lods[lod].error / dimensions.radius * projectedRadius <= threshold) {
+			return lod;
+		}
+	}
+	return 0;
+}
+
 /*
 	glTF mesh
 */
 vkglTF::Mesh::Mesh(vks::VulkanDevice* device, glm::mat4 matrix) {
 	this->device = device;
 	this->uniformBlock.matrix = matrix;
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		sizeof(uniformBlock),
-		&uniformBuffer.buffer,
-		&uniformBuffer.memory,
-		&uniformBlock));
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
-	uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
+	// The uniform buffer slot is assigned by Model::createNodeTransforms() once all meshes of the model exist
 };
 
-vkglTF::Mesh::~Mesh() {
-	vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
-}
-
 /*
 	glTF node
 */
@@ -512,10 +662,13 @@ glm::mat4 vkglTF::Node::getMatrix() {
 }
 
 void vkglTF::Node::update() {
+	worldMatrix = getMatrix();
+	dirty = false;
 	if (mesh) {
-		glm::mat4 m = getMatrix();
-		if (skin) {
-			mesh->uniformBlock.matrix = m;
+		glm::mat4 m = worldMatrix;
+		// Kept on the host for level of detail selection and the transforms of indirect drawing
+		mesh->uniformBlock.matrix = m;
+		if (skin && !skin->computeSkinning) {
 			// Update join matrices
 			glm::mat4 inverseTransform = glm::inverse(m);
 			for (size_t i = 0; i < skin->joints.size(); i++) {
@@ -530,6 +683,7 @@ void vkglTF::Node::update() {
 		else {
 			memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
 		}
+		mesh->uniformBuffer.dirty = true;
 	}
 
 	for (auto& child : children) {
@@ -537,6 +691,130 @@ void vkglTF::Node::update() {
 	}
 }
 
+/*
+	Recomputes the world matrices of nodes that changed since the last call and of everything below them
+	Parents are visited first, so a node's world matrix is built from its parent's cached one
+*/
+void vkglTF::Node::updateMatrices(bool parentChanged)
+{
+	matrixChanged = dirty || parentChanged;
+	if (matrixChanged) {
+		worldMatrix = parent ? parent->worldMatrix * localMatrix() : localMatrix();
+		dirty = false;
+	}
+	for (Node* child : children) {
+		child->updateMatrices(matrixChanged);
+	}
+}
+
+/*
+	Writes the mesh's uniform buffer if the node or, for skinned meshes, any of its joints moved in the last updateMatrices()
+*/
+void vkglTF::Node::uploadMatrices()
+{
+	if (!mesh) {
+		return;
+	}
+	const bool skinned = skin && !skin->computeSkinning;
+	bool jointsChanged = false;
+	if (skinned) {
+		for (const Node* joint : skin->joints) {
+			jointsChanged = jointsChanged || joint->matrixChanged;
+		}
+	}
+	if (!matrixChanged && !jointsChanged) {
+		return;
+	}
+	mesh->uniformBlock.matrix = worldMatrix;
+	if (skinned) {
+		glm::mat4 inverseTransform = glm::inverse(worldMatrix);
+		for (size_t i = 0; i < skin->joints.size(); i++) {
+			mesh->uniformBlock.jointMatrix[i] = inverseTransform * skin->joints[i]->worldMatrix * skin->inverseBindMatrices[i];
+		}
+		mesh->uniformBlock.jointcount = (float)skin->joints.size();
+		memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
+	}
+	else {
+		memcpy(mesh->uniformBuffer.mapped, &worldMatrix, sizeof(glm::mat4));
+	}
+	mesh->uniformBuffer.dirty = true;
+}
+
+/*
+	glTF animation sampler
+*/
+bool vkglTF::AnimationSampler::valid() const
+{
+	const size_t valuesPerKey = (interpolation == InterpolationType::CUBICSPLINE) ? 3 : 1;
+	return !inputs.empty() && (outputsVec4.size() >= inputs.size() * valuesPerKey);
+}
+
+/*
+	Returns the key starting the interval time lies in, for times between the first and the last key
+	Checks the cached interval and the one after it first, and falls back to a binary search when playback jumps
+	The cursor is passed in, so instances playing the same sampler at different times each keep their own
+*/
+size_t vkglTF::AnimationSampler::findKey(float time, size_t& cursor) const
+{
+	const size_t lastInterval = inputs.size() - 2;
+	if (cursor <= lastInterval) {
+		if ((time >= inputs[cursor]) && (time < inputs[cursor + 1])) {
+			return cursor;
+		}
+		if ((cursor + 1 <= lastInterval) && (time >= inputs[cursor + 1]) && (time < inputs[cursor + 2])) {
+			return ++cursor;
+		}
+	}
+	const size_t key = static_cast<size_t>(std::upper_bound(inputs.begin(), inputs.end(), time) - inputs.begin());
+	cursor = std::min(key > 0 ? key - 1 : 0, lastInterval);
+	return cursor;
+}
+
+glm::vec4 vkglTF::AnimationSampler::sample(float time, bool rotation)
+{
+	return sample(time, rotation, cursor);
+}
+
+glm::vec4 vkglTF::AnimationSampler::sample(float time, bool rotation, size_t& cursor) const
+{
+	const bool cubic = (interpolation == InterpolationType::CUBICSPLINE);
+	auto value = [&](size_t key) {
+		return outputsVec4[cubic ? key * 3 + 1 : key];
+	};
+	if ((inputs.size() == 1) || (time <= inputs.front())) {
+		return value(0);
+	}
+	if (time >= inputs.back()) {
+		return value(inputs.size() - 1);
+	}
+	const size_t key = findKey(time, cursor);
+	const float delta = inputs[key + 1] - inputs[key];
+	const float u = (delta > 0.0f) ? (time - inputs[key]) / delta : 0.0f;
+	switch (interpolation) {
+	case InterpolationType::STEP:
+		return value(key);
+	case InterpolationType::CUBICSPLINE: {
+		// Hermite spline between the two keys, tangents are scaled by the interval length (glTF 2.0 appendix C)
+		const float u2 = u * u;
+		const float u3 = u2 * u;
+		const glm::vec4 result =
+			(2.0f * u3 - 3.0f * u2 + 1.0f) * value(key) +
+			(u3 - 2.0f * u2 + u) * delta * outputsVec4[key * 3 + 2] +
+			(-2.0f * u3 + 3.0f * u2) * value(key + 1) +
+			(u3 - u2) * delta * outputsVec4[(key + 1) * 3];
+		return rotation ? glm::normalize(result) : result;
+	}
+	default:
+		if (rotation) {
+			const glm::vec4 a = value(key);
+			const glm::vec4 b = value(key + 1);
+			const glm::quat q = glm::normalize(glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), u));
+			return glm::vec4(q.x, q.y, q.z, q.w);
+		}
+		return glm::mix(value(key), value(key + 1), u);
+	}
+}
+
 vkglTF::Node::~Node() {
 	if (mesh) {
 		delete mesh;
@@ -601,6 +879,212 @@ VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputStat
 	return &pipelineVertexInputStateCreateInfo;
 }
 
+/*
+	glTF vertex layout
+*/
+
+/*
+	Components in the order of vkglTF::Vertex, a function local static as layouts may be constructed during static initialization
+*/
+static const std::vector<vkglTF::VertexComponent>& defaultVertexComponents() {
+	static const std::vector<vkglTF::VertexComponent> components = {
+		vkglTF::VertexComponent::Position,
+		vkglTF::VertexComponent::Normal,
+		vkglTF::VertexComponent::UV,
+		vkglTF::VertexComponent::Color,
+		vkglTF::VertexComponent::Joint0,
+		vkglTF::VertexComponent::Weight0,
+		vkglTF::VertexComponent::Tangent
+	};
+	return components;
+}
+
+static uint32_t vertexFormatSize(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_UINT:
+	case VK_FORMAT_R16G16_SFLOAT:
+		return 4;
+	case VK_FORMAT_R32G32_SFLOAT:
+	case VK_FORMAT_R16G16B16A16_SNORM:
+		return 8;
+	case VK_FORMAT_R32G32B32_SFLOAT:
+		return 12;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+vkglTF::VertexLayout::VertexLayout() : VertexLayout(defaultVertexComponents()) {}
+
+vkglTF::VertexLayout::VertexLayout(const std::vector<VertexComponent> components, uint32_t quantization) : components(components), quantization(quantization) {
+	// Attributes are packed in the order of the list, 4 byte aligned
+	for (VertexComponent component : components) {
+		offsets[static_cast<uint32_t>(component)] = stride;
+		stride += (vertexFormatSize(format(component)) + 3) & ~3u;
+	}
+}
+
+bool vkglTF::VertexLayout::has(VertexComponent component) const {
+	return std::find(components.begin(), components.end(), component) != components.end();
+}
+
+bool vkglTF::VertexLayout::isDefault() const {
+	return (quantization == 0) && (components == defaultVertexComponents());
+}
+
+uint32_t vkglTF::VertexLayout::componentKey() const {
+	// Four bits per component, zero marks the end of the list
+	uint32_t key = 0;
+	for (size_t i = 0; i < components.size(); i++) {
+		key |= (static_cast<uint32_t>(components[i]) + 1) << (i * 4);
+	}
+	return key;
+}
+
+VkFormat vkglTF::VertexLayout::format(VertexComponent component) const {
+	switch (component) {
+	case VertexComponent::Position:
+		return VK_FORMAT_R32G32B32_SFLOAT;
+	case VertexComponent::Normal:
+		// Three component 16 bit formats are rarely supported for vertex buffers, the fourth component is padding
+		return (quantization & QuantizeNormals) ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+	case VertexComponent::UV:
+		return (quantization & QuantizeUVs) ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT;
+	case VertexComponent::Color:
+		return (quantization & QuantizeColors) ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+	case VertexComponent::Tangent:
+		return (quantization & QuantizeNormals) ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+	case VertexComponent::Joint0:
+		return (quantization & QuantizeSkin) ? VK_FORMAT_R8G8B8A8_UINT : VK_FORMAT_R32G32B32A32_SFLOAT;
+	case VertexComponent::Weight0:
+		return (quantization & QuantizeSkin) ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+	default:
+		return VK_FORMAT_UNDEFINED;
+	}
+}
+
+/*
+	Writes the layout's components of a converted vertex to dst, encoded in the layout's formats
+*/
+void vkglTF::VertexLayout::pack(const Vertex& vertex, unsigned char* dst) const {
+	for (VertexComponent component : components) {
+		unsigned char* out = dst + offsets[static_cast<uint32_t>(component)];
+		switch (component) {
+		case VertexComponent::Position:
+			memcpy(out, &vertex.pos, sizeof(vertex.pos));
+			break;
+		case VertexComponent::Normal:
+			if (quantization & QuantizeNormals) {
+				const uint64_t packed = glm::packSnorm4x16(glm::vec4(vertex.normal, 0.0f));
+				memcpy(out, &packed, sizeof(packed));
+			}
+			else {
+				memcpy(out, &vertex.normal, sizeof(vertex.normal));
+			}
+			break;
+		case VertexComponent::UV:
+			if (quantization & QuantizeUVs) {
+				const uint32_t packed = glm::packHalf2x16(vertex.uv);
+				memcpy(out, &packed, sizeof(packed));
+			}
+			else {
+				memcpy(out, &vertex.uv, sizeof(vertex.uv));
+			}
+			break;
+		case VertexComponent::Color:
+			if (quantization & QuantizeColors) {
+				const uint32_t packed = glm::packUnorm4x8(vertex.color);
+				memcpy(out, &packed, sizeof(packed));
+			}
+			else {
+				memcpy(out, &vertex.color, sizeof(vertex.color));
+			}
+			break;
+		case VertexComponent::Tangent:
+			if (quantization & QuantizeNormals) {
+				const uint64_t packed = glm::packSnorm4x16(vertex.tangent);
+				memcpy(out, &packed, sizeof(packed));
+			}
+			else {
+				memcpy(out, &vertex.tangent, sizeof(vertex.tangent));
+			}
+			break;
+		case VertexComponent::Joint0:
+			if (quantization & QuantizeSkin) {
+				// parseFile() refuses models with skins of more than 255 joints for this layout, so joint indices always fit
+				for (uint32_t i = 0; i < 4; i++) {
+					out[i] = static_cast<uint8_t>(vertex.joint0[i]);
+				}
+			}
+			else {
+				memcpy(out, &vertex.joint0, sizeof(vertex.joint0));
+			}
+			break;
+		case VertexComponent::Weight0:
+			if (quantization & QuantizeSkin) {
+				// Rounding each weight on its own may change their sum, the difference goes to the largest weight so they still add up to one
+				uint8_t weights[4];
+				int32_t sum = 0;
+				uint32_t largest = 0;
+				for (uint32_t i = 0; i < 4; i++) {
+					weights[i] = static_cast<uint8_t>(glm::round(glm::clamp(vertex.weight0[i], 0.0f, 1.0f) * 255.0f));
+					sum += weights[i];
+					largest = (weights[i] > weights[largest]) ? i : largest;
+				}
+				if (sum > 0) {
+					weights[largest] = static_cast<uint8_t>(glm::clamp(static_cast<int32_t>(weights[largest]) + 255 - sum, 0, 255));
+				}
+				memcpy(out, weights, sizeof(weights));
+			}
+			else {
+				memcpy(out, &vertex.weight0, sizeof(vertex.weight0));
+			}
+			break;
+		}
+	}
+}
+
+VkVertexInputBindingDescription vkglTF::VertexLayout::inputBindingDescription(uint32_t binding) const {
+	return VkVertexInputBindingDescription({ binding, stride, VK_VERTEX_INPUT_RATE_VERTEX });
+}
+
+VkVertexInputAttributeDescription vkglTF::VertexLayout::inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component) const {
+	assert(has(component));
+	return VkVertexInputAttributeDescription({ location, binding, format(component), offsets[static_cast<uint32_t>(component)] });
+}
+
+std::vector<VkVertexInputAttributeDescription> vkglTF::VertexLayout::inputAttributeDescriptions(uint32_t binding) const {
+	return inputAttributeDescriptions(binding, components);
+}
+
+std::vector<VkVertexInputAttributeDescription> vkglTF::VertexLayout::inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components) const {
+	std::vector<VkVertexInputAttributeDescription> result;
+	uint32_t location = 0;
+	for (VertexComponent component : components) {
+		result.push_back(inputAttributeDescription(binding, location, component));
+		location++;
+	}
+	return result;
+}
+
+VkPipelineVertexInputStateCreateInfo* vkglTF::VertexLayout::getPipelineVertexInputState() {
+	return getPipelineVertexInputState(components);
+}
+
+VkPipelineVertexInputStateCreateInfo* vkglTF::VertexLayout::getPipelineVertexInputState(const std::vector<VertexComponent> components) {
+	vertexInputBindingDescription = inputBindingDescription(0);
+	vertexInputAttributeDescriptions = inputAttributeDescriptions(0, components);
+	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &vertexInputBindingDescription;
+	pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributeDescriptions.size());
+	pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexInputAttributeDescriptions.data();
+	return &pipelineVertexInputStateCreateInfo;
+}
+
 vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
 {
 
@@ -618,32 +1102,11 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	emptyTexture.layerCount = 1;
 	emptyTexture.mipLevels = 1;
 
+	// Clear the texel directly in the device's staging ring
 	size_t bufferSize = emptyTexture.width * emptyTexture.height * 4;
-	unsigned char* buffer = new unsigned char[bufferSize];
-	memset(buffer, 0, bufferSize);
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
-	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-	bufferCreateInfo.size = bufferSize;
-	// This buffer is used as a transfer source for the buffer copy
-	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+	vks::StagingRing::Region staging = device->stagingRing.allocate(transferQueue, bufferSize);
+	memset(staging.data, 0, bufferSize);
 	VkMemoryRequirements memReqs;
-	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-	// Copy texture data into staging buffer
-	uint8_t* data;
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-	memcpy(data, buffer, bufferSize);
-	vkUnmapMemory(device->logicalDevice, stagingMemory);
 
 	VkBufferImageCopy bufferCopyRegion = {};
 	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -651,6 +1114,7 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	bufferCopyRegion.imageExtent.width = emptyTexture.width;
 	bufferCopyRegion.imageExtent.height = emptyTexture.height;
 	bufferCopyRegion.imageExtent.depth = 1;
+	bufferCopyRegion.bufferOffset = staging.offset;
 
 	// Create optimal tiled target image
 	VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -667,10 +1131,8 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &emptyTexture.image));
 
 	vkGetImageMemoryRequirements(device->logicalDevice, emptyTexture.image, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &emptyTexture.deviceMemory));
-	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.deviceMemory, 0));
+	VK_CHECK_RESULT(device->allocateMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vks::AllocationType::Optimal, &emptyTexture.allocation));
+	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.allocation.memory, emptyTexture.allocation.offset));
 
 	VkImageSubresourceRange subresourceRange{};
 	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -678,17 +1140,12 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	subresourceRange.levelCount = 1;
 	subresourceRange.layerCount = 1;
 
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	VkCommandBuffer copyCmd = device->getTransferContext(transferQueue).getCommandBuffer(transferQueue);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-	device->flushCommandBuffer(copyCmd, transferQueue);
+	vkCmdCopyBufferToImage(copyCmd, staging.buffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+	device->finishImageUpload(transferQueue, emptyTexture.image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	emptyTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	// Clean up staging resources
-	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 	VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
 	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
 	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
@@ -719,10 +1176,23 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 */
 vkglTF::Model::~Model()
 {
+	// Uploads may still be reading from or writing to the resources
+	uploadTicket.wait();
 	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
+	vertices.allocation.free();
 	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	indices.allocation.free();
+	indirect.commands.destroy();
+	indirect.sourceCommands.destroy();
+	indirect.bounds.destroy();
+	indirect.lods.destroy();
+	indirect.counts.destroy();
+	indirect.drawData.destroy();
+	indirect.transforms.destroy();
+	indirect.materials.destroy();
+	bindless.materials.destroy();
+	vkDestroyBuffer(device->logicalDevice, nodeTransforms.buffer, nullptr);
+	nodeTransforms.allocation.free();
 	for (auto texture : textures) {
 		texture.destroy();
 	}
@@ -737,11 +1207,23 @@ vkglTF::Model::~Model()
 		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutImage, nullptr);
 		descriptorSetLayoutImage = VK_NULL_HANDLE;
 	}
+	if (descriptorSetLayoutIndirect != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutIndirect, nullptr);
+		descriptorSetLayoutIndirect = VK_NULL_HANDLE;
+	}
+	if (descriptorSetLayoutBindless != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutBindless, nullptr);
+		descriptorSetLayoutBindless = VK_NULL_HANDLE;
+	}
 	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
 	emptyTexture.destroy();
 }
 
-void vkglTF::Model::loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
+/*
+	First phase of the geometry conversion: builds the node, mesh and primitive objects and reserves each primitive's
+	place in the vertex and index buffers, the vertices and indices themselves are converted by decodeGeometry()
+*/
+void vkglTF::Model::loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, float globalscale)
 {
 	vkglTF::Node* newNode = new Node{};
 	newNode->index = nodeIndex;
@@ -776,158 +1258,97 @@ void vkglTF::Model::loadNode(vkglTF::Node* parent, const tinygltf::Node& node, u
 	// Node with children
 	if (node.children.size() > 0) {
 		for (auto i = 0; i < node.children.size(); i++) {
-			loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, indexBuffer, vertexBuffer, globalscale);
+			loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, globalscale);
 		}
 	}
 
 	// Node contains mesh data
 	if (node.mesh > -1) {
-		const tinygltf::Mesh mesh = model.meshes[node.mesh];
+		const tinygltf::Mesh& mesh = model.meshes[node.mesh];
 		Mesh* newMesh = new Mesh(device, newNode->matrix);
 		newMesh->name = mesh.name;
 		for (size_t j = 0; j < mesh.primitives.size(); j++) {
 			const tinygltf::Primitive& primitive = mesh.primitives[j];
-			if (primitive.indices < 0) {
-				continue;
-			}
-			uint32_t indexStart = static_cast<uint32_t>(indexBuffer.size());
-			uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
-			uint32_t indexCount = 0;
-			uint32_t vertexCount = 0;
-			glm::vec3 posMin{};
-			glm::vec3 posMax{};
-			bool hasSkin = false;
-			// Vertices
-			{
-				const float* bufferPos = nullptr;
-				const float* bufferNormals = nullptr;
-				const float* bufferTexCoords = nullptr;
-				const float* bufferColors = nullptr;
-				const float* bufferTangents = nullptr;
-				uint32_t numColorComponents;
-				const uint16_t* bufferJoints = nullptr;
-				const float* bufferWeights = nullptr;
-
-				// Position attribute is required
-				assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-				const tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-				const tinygltf::BufferView& posView = model.bufferViews[posAccessor.bufferView];
-				bufferPos = reinterpret_cast<const float*>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-
-				if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-					const tinygltf::Accessor& normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-					const tinygltf::BufferView& normView = model.bufferViews[normAccessor.bufferView];
-					bufferNormals = reinterpret_cast<const float*>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-				}
 
-				if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-					const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoords = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+			// Position attribute is required
+			assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
+			const tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+			// Non-indexed primitives get sequential indices generated, so all primitives are drawn the same way
+			const bool indexed = (primitive.indices > -1);
+			const tinygltf::Accessor* indexAccessor = indexed ? &model.accessors[primitive.indices] : nullptr;
+			const unsigned char* indexSource = nullptr;
+			if (indexed) {
+				if ((indexAccessor->componentType != TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT) && (indexAccessor->componentType != TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT) && (indexAccessor->componentType != TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE)) {
+					std::cerr << "Index component type " << indexAccessor->componentType << " not supported!" << std::endl;
+					continue;
 				}
-
-				if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-					const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
-					// Color buffer are either of type vec3 or vec4
-					numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
-					bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor& tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-					const tinygltf::BufferView& tangentView = model.bufferViews[tangentAccessor.bufferView];
-					bufferTangents = reinterpret_cast<const float*>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
-				}
-
-				// Skinning
-				// Joints
-				if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor& jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-					const tinygltf::BufferView& jointView = model.bufferViews[jointAccessor.bufferView];
-					bufferJoints = reinterpret_cast<const uint16_t*>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
+				indexSource = indexData(model, *indexAccessor);
+				if (!indexSource) {
+					std::cerr << "Index accessor " << primitive.indices << " is out of the bounds of its buffer!" << std::endl;
+					continue;
 				}
+			}
 
-				if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-					const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferWeights = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
+			LoadState::PrimitiveDecode decode{};
+			decode.primitive = &primitive;
+			decode.node = newNode;
+			decode.vertexOffset = LoadState::notConverted;
+			decode.indexOffset = LoadState::notConverted;
+			// The optimization reorders both vertices and indices, so both are converted to the CPU buffers
+			decode.optimize = (loadState->fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) && (primitive.mode == TINYGLTF_MODE_TRIANGLES);
+			// Meshlets are built from the final positions and indices
+			decode.buildMeshlets = (loadState->fileLoadingFlags & FileLoadingFlags::BuildMeshlets) && (primitive.mode == TINYGLTF_MODE_TRIANGLES);
+			decode.generateLods = (loadState->fileLoadingFlags & FileLoadingFlags::GenerateLods) && (primitive.mode == TINYGLTF_MODE_TRIANGLES);
 
-				hasSkin = (bufferJoints && bufferWeights);
-
-				vertexCount = static_cast<uint32_t>(posAccessor.count);
-
-				for (size_t v = 0; v < posAccessor.count; v++) {
-					Vertex vert{};
-					vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-					vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-					vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
-					if (bufferColors) {
-						switch (numColorComponents) {
-						case 3:
-							vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
-						case 4:
-							vert.color = glm::make_vec4(&bufferColors[v * 4]);
-						}
-					}
-					else {
-						vert.color = glm::vec4(1.0f);
-					}
-					vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
-					vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-					vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
-					vertexBuffer.push_back(vert);
-				}
+			// Vertices
+			const uint32_t vertexCount = static_cast<uint32_t>(posAccessor.count);
+			const size_t stride = vertexLayout.stride;
+			const unsigned char* interleaved = (loadState->fileLoadingFlags & vertexModifyingFlags) ? nullptr : interleavedVertexData(model, primitive, vertexLayout);
+			if (interleaved) {
+				// Stored exactly like the GPU vertex layout, copied from the file data into the staging ring by upload()
+				loadState->vertexRanges.push_back({ interleaved, 0, vertexCount * stride });
+			}
+			else {
+				// Converted to its reserved place in the CPU vertex buffer
+				decode.vertexOffset = loadState->convertedVertexCount;
+				loadState->vertexRanges.push_back({ nullptr, decode.vertexOffset * stride, vertexCount * stride });
+				loadState->convertedVertexCount += vertexCount;
 			}
-			// Indices
-			{
-				const tinygltf::Accessor& accessor = model.accessors[primitive.indices];
-				const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-
-				indexCount = static_cast<uint32_t>(accessor.count);
 
-				switch (accessor.componentType) {
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-					uint32_t* buf = new uint32_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-					break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-					uint16_t* buf = new uint16_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-					break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-					uint8_t* buf = new uint8_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-					break;
-				}
-				default:
-					std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-					return;
-				}
+			// Indices
+			// Indices are relative to the primitive's first vertex, which is passed as the vertex offset when drawing
+			const uint32_t indexCount = indexed ? static_cast<uint32_t>(indexAccessor->count) : vertexCount;
+			const int storedType = (indices.type == VK_INDEX_TYPE_UINT16) ? TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT : TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT;
+			if (indexed && (indexAccessor->componentType == storedType) && !decode.optimize && !decode.buildMeshlets && !decode.generateLods) {
+				// Matches the index buffer format, copied from the file data into the staging ring by upload()
+				loadState->indexRanges.push_back({ indexSource, 0, indexCount * indices.stride() });
 			}
-			Primitive* newPrimitive = new Primitive(indexStart, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
-			newPrimitive->firstVertex = vertexStart;
+			else {
+				// Converted, copied or generated to its reserved place in the CPU index buffer
+				decode.indexOffset = loadState->convertedIndexCount;
+				loadState->indexRanges.push_back({ nullptr, decode.indexOffset * indices.stride(), indexCount * indices.stride() });
+				loadState->convertedIndexCount += indexCount;
+			}
+
+			Primitive* newPrimitive = new Primitive(loadState->indexCount, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
+			newPrimitive->firstVertex = loadState->vertexCount;
 			newPrimitive->vertexCount = vertexCount;
-			newPrimitive->setDimensions(posMin, posMax);
+			newPrimitive->setDimensions(glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]), glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]));
 			newMesh->primitives.push_back(newPrimitive);
+			loadState->vertexCount += vertexCount;
+			// Levels of detail are only known once simplified, finishDecode() places them behind the indices of all primitives
+			loadState->indexCount += indexCount;
+
+			// Large primitives are split into slices, so a single mesh still spreads over all workers
+			// Primitives that get optimized, split into meshlets or simplified need all of their data at once and stay in one piece
+			const uint32_t convertedCount = std::max(decode.vertexOffset != LoadState::notConverted ? vertexCount : 0, decode.indexOffset != LoadState::notConverted ? indexCount : 0);
+			const uint32_t sliceSize = (decode.optimize || decode.buildMeshlets || decode.generateLods) ? convertedCount : LoadState::geometryBatchSize;
+			decode.target = newPrimitive;
+			for (uint32_t begin = 0; begin < convertedCount; begin += sliceSize) {
+				decode.begin = begin;
+				decode.end = std::min(begin + sliceSize, convertedCount);
+				loadState->primitiveDecodes.push_back(decode);
+			}
 		}
 		newNode->mesh = newMesh;
 	}
@@ -940,11 +1361,236 @@ void vkglTF::Model::loadNode(vkglTF::Node* parent, const tinygltf::Node& node, u
 	linearNodes.push_back(newNode);
 }
 
+/*
+	Second phase of the geometry conversion: converts a slice of a primitive's vertices and indices to the places
+	loadNode() reserved for them, only reads the parsed file and writes the slice's own part of the CPU buffers
+*/
+void vkglTF::Model::decodePrimitive(LoadState::PrimitiveDecode& decode)
+{
+	const tinygltf::Model& model = loadState->gltfModel;
+	const tinygltf::Primitive& primitive = *decode.primitive;
+
+	// Vertices
+	if (decode.vertexOffset != LoadState::notConverted) {
+		const float* bufferPos = nullptr;
+		const float* bufferNormals = nullptr;
+		const float* bufferTexCoords = nullptr;
+		const float* bufferColors = nullptr;
+		const float* bufferTangents = nullptr;
+		uint32_t numColorComponents;
+		const uint16_t* bufferJoints = nullptr;
+		const float* bufferWeights = nullptr;
+		// Strides in elements of the attribute's component type, views may interleave attributes
+		size_t posStride = 3, normStride = 3, uvStride = 2, colorStride = 4, tangentStride = 4, jointStride = 4, weightStride = 4;
+
+		const tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+		const tinygltf::BufferView& posView = model.bufferViews[posAccessor.bufferView];
+		bufferPos = reinterpret_cast<const float*>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
+		posStride = posAccessor.ByteStride(posView) / sizeof(float);
+
+		if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
+			const tinygltf::Accessor& normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
+			const tinygltf::BufferView& normView = model.bufferViews[normAccessor.bufferView];
+			bufferNormals = reinterpret_cast<const float*>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
+			normStride = normAccessor.ByteStride(normView) / sizeof(float);
+		}
+
+		if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
+			const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
+			bufferTexCoords = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+			uvStride = uvAccessor.ByteStride(uvView) / sizeof(float);
+		}
+
+		if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
+		{
+			const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
+			const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
+			// Color buffer are either of type vec3 or vec4
+			numColorComponents = colorAccessor.type == TINYGLTF_TYPE_VEC3 ? 3 : 4;
+			bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
+			colorStride = colorAccessor.ByteStride(colorView) / sizeof(float);
+		}
+
+		if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
+		{
+			const tinygltf::Accessor& tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
+			const tinygltf::BufferView& tangentView = model.bufferViews[tangentAccessor.bufferView];
+			bufferTangents = reinterpret_cast<const float*>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
+			tangentStride = tangentAccessor.ByteStride(tangentView) / sizeof(float);
+		}
+
+		// Skinning
+		// Joints
+		if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor& jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
+			const tinygltf::BufferView& jointView = model.bufferViews[jointAccessor.bufferView];
+			bufferJoints = reinterpret_cast<const uint16_t*>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
+			jointStride = jointAccessor.ByteStride(jointView) / sizeof(uint16_t);
+		}
+
+		if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
+			const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
+			bufferWeights = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+			weightStride = uvAccessor.ByteStride(uvView) / sizeof(float);
+		}
+
+		const bool hasSkin = (bufferJoints && bufferWeights);
+
+		// Pre-Calculations for requested features
+		const uint32_t fileLoadingFlags = loadState->fileLoadingFlags;
+		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
+		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+		const glm::mat4 localMatrix = preTransform ? decode.node->getMatrix() : glm::mat4(1.0f);
+
+		// Every vertex is converted to the full vertex struct first and then packed in the model's layout
+		const size_t stride = vertexLayout.stride;
+		unsigned char* vertices = &loadState->vertexBuffer[decode.vertexOffset * stride];
+		const size_t end = std::min<size_t>(decode.end, posAccessor.count);
+		for (size_t v = decode.begin; v < end; v++) {
+			Vertex vert;
+			vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * posStride]), 1.0f);
+			vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * normStride]) : glm::vec3(0.0f)));
+			vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * uvStride]) : glm::vec3(0.0f);
+			if (bufferColors) {
+				switch (numColorComponents) {
+				case 3:
+					vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * colorStride]), 1.0f);
+					break;
+				case 4:
+					vert.color = glm::make_vec4(&bufferColors[v * colorStride]);
+					break;
+				}
+			}
+			else {
+				vert.color = glm::vec4(1.0f);
+			}
+			vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * tangentStride])) : glm::vec4(0.0f);
+			vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * jointStride])) : glm::vec4(0.0f);
+			vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * weightStride]) : glm::vec4(0.0f);
+			// Pre-transform vertex positions by node-hierarchy
+			if (preTransform) {
+				vert.pos = glm::vec3(localMatrix * glm::vec4(vert.pos, 1.0f));
+				vert.normal = glm::normalize(glm::mat3(localMatrix) * vert.normal);
+			}
+			// Flip Y-Axis of vertex positions
+			if (flipY) {
+				vert.pos.y *= -1.0f;
+				vert.normal.y *= -1.0f;
+			}
+			// Pre-Multiply vertex colors with material base color
+			if (preMultiplyColor) {
+				vert.color = decode.target->material.baseColorFactor * vert.color;
+			}
+			vertexLayout.pack(vert, vertices + v * stride);
+		}
+	}
+
+	// Indices
+	if (decode.indexOffset != LoadState::notConverted) {
+		unsigned char* dst = &loadState->indexBuffer[decode.indexOffset * indices.stride()];
+		if (primitive.indices > -1) {
+			const tinygltf::Accessor& accessor = model.accessors[primitive.indices];
+			// Checked to be within its buffer when the primitive was added
+			const unsigned char* data = indexData(model, accessor);
+			const size_t begin = std::min<size_t>(decode.begin, accessor.count);
+			const size_t end = std::min<size_t>(decode.end, accessor.count);
+			if (indices.type == VK_INDEX_TYPE_UINT16) {
+				convertIndices(accessor.componentType, data, begin, end, reinterpret_cast<uint16_t*>(dst));
+			}
+			else {
+				convertIndices(accessor.componentType, data, begin, end, reinterpret_cast<uint32_t*>(dst));
+			}
+		}
+		else {
+			// Sequential indices of a non-indexed primitive
+			const size_t end = std::min<size_t>(decode.end, decode.target->indexCount);
+			for (size_t i = decode.begin; i < end; i++) {
+				if (indices.type == VK_INDEX_TYPE_UINT16) {
+					reinterpret_cast<uint16_t*>(dst)[i] = static_cast<uint16_t>(i);
+				}
+				else {
+					reinterpret_cast<uint32_t*>(dst)[i] = static_cast<uint32_t>(i);
+				}
+			}
+		}
+	}
+
+	// Mesh optimization, meshlets and levels of detail, such primitives are never split so the whole primitive has been converted at this point
+	if ((decode.optimize || decode.buildMeshlets || decode.generateLods) && (decode.target->indexCount > 0)) {
+		unsigned char* vertices = &loadState->vertexBuffer[decode.vertexOffset * vertexLayout.stride];
+		unsigned char* primitiveIndices = &loadState->indexBuffer[decode.indexOffset * indices.stride()];
+		const uint32_t indexCount = decode.target->indexCount;
+		const uint32_t vertexCount = decode.target->vertexCount;
+		// The passes work on 32 bit indices, 16 bit ones are widened to a copy and narrowed back afterwards
+		const bool narrow = (indices.type == VK_INDEX_TYPE_UINT16);
+		std::vector<uint32_t> widened;
+		if (narrow) {
+			const uint16_t* src = reinterpret_cast<const uint16_t*>(primitiveIndices);
+			widened.assign(src, src + indexCount);
+		}
+		uint32_t* work = narrow ? widened.data() : reinterpret_cast<uint32_t*>(primitiveIndices);
+		const unsigned char* positions = vertices + vertexLayout.offsets[static_cast<uint32_t>(VertexComponent::Position)];
+		// Files with indices past the primitive's vertices are drawn as they are
+		if (*std::max_element(work, work + indexCount) < vertexCount) {
+			if (decode.optimize) {
+				decode.statsBefore = optimize::analyzeVertexCache(work, indexCount, vertexCount);
+				optimize::optimizeVertexCache(work, indexCount, vertexCount);
+				// Reordering the clusters of blended primitives would change their blending order
+				if (decode.target->material.alphaMode == Material::ALPHAMODE_OPAQUE) {
+					optimize::optimizeOverdraw(work, indexCount, positions, vertexLayout.stride, vertexCount);
+				}
+				optimize::optimizeVertexFetch(work, indexCount, vertices, vertexLayout.stride, vertexCount);
+				decode.statsAfter = optimize::analyzeVertexCache(work, indexCount, vertexCount);
+			}
+			if (decode.buildMeshlets) {
+				optimize::buildMeshlets(work, indexCount, positions, vertexLayout.stride, vertexCount, decode.meshlets);
+				// Flipping Y mirrors the positions, which turns the face normals built from them inwards
+				if (loadState->fileLoadingFlags & FileLoadingFlags::FlipY) {
+					for (optimize::Meshlet& meshlet : decode.meshlets) {
+						meshlet.coneAxis = -meshlet.coneAxis;
+					}
+				}
+			}
+			if (narrow && decode.optimize) {
+				convertIndices(TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT, reinterpret_cast<const unsigned char*>(work), 0, indexCount, reinterpret_cast<uint16_t*>(primitiveIndices));
+			}
+			if (decode.generateLods) {
+				// Each level is simplified from the one before, aiming for half its triangles, and collected in decode.lodIndices
+				// A level that keeps more than three quarters of the indices before it ends the chain, usually because only locked border and seam vertices are left
+				std::vector<Primitive::Lod>& lods = decode.target->lods;
+				lods.push_back({ decode.target->firstIndex, indexCount, 0.0f });
+				std::vector<uint32_t> lodIndices(work, work + indexCount);
+				float error = 0.0f;
+				while (lods.size() < optimize::maxLodCount) {
+					float lodError = 0.0f;
+					std::vector<uint32_t> simplified = optimize::simplify(lodIndices.data(), lodIndices.size(), positions, vertexLayout.stride, vertexCount, lodIndices.size() / 2, lodError);
+					if (simplified.empty() || (simplified.size() > lodIndices.size() * 3 / 4)) {
+						break;
+					}
+					if (decode.optimize) {
+						optimize::optimizeVertexCache(simplified.data(), simplified.size(), vertexCount);
+					}
+					// Errors add up, as every level only knows how far it moved from the one before
+					error += lodError;
+					// First index relative to decode.lodIndices until finishDecode() has placed them
+					lods.push_back({ static_cast<uint32_t>(decode.lodIndices.size()), static_cast<uint32_t>(simplified.size()), error });
+					decode.lodIndices.insert(decode.lodIndices.end(), simplified.begin(), simplified.end());
+					lodIndices = std::move(simplified);
+				}
+			}
+		}
+	}
+}
+
 void vkglTF::Model::loadSkins(tinygltf::Model& gltfModel)
 {
 	for (tinygltf::Skin& source : gltfModel.skins) {
 		Skin* newSkin = new Skin{};
 		newSkin->name = source.name;
+		newSkin->computeSkinning = (loadState->fileLoadingFlags & FileLoadingFlags::ComputeSkinning) != 0;
 
 		// Find skeleton root node
 		if (source.skeleton > -1) {
@@ -972,17 +1618,6 @@ void vkglTF::Model::loadSkins(tinygltf::Model& gltfModel)
 	}
 }
 
-void vkglTF::Model::loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue)
-{
-	for (tinygltf::Image& image : gltfModel.images) {
-		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
-		textures.push_back(texture);
-	}
-	// Create an empty texture to be used for empty material images
-	createEmptyTexture(transferQueue);
-}
-
 void vkglTF::Model::loadMaterials(tinygltf::Model& gltfModel)
 {
 	for (tinygltf::Material& mat : gltfModel.materials) {
@@ -1027,6 +1662,7 @@ void vkglTF::Model::loadMaterials(tinygltf::Model& gltfModel)
 		if (mat.additionalValues.find("alphaCutoff") != mat.additionalValues.end()) {
 			material.alphaCutoff = static_cast<float>(mat.additionalValues["alphaCutoff"].Factor());
 		}
+		material.doubleSided = mat.doubleSided;
 
 		materials.push_back(material);
 	}
@@ -1146,9 +1782,50 @@ void vkglTF::Model::loadAnimations(tinygltf::Model& gltfModel)
 	}
 }
 
-void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+/*
+	Loads, decodes and uploads a model in one go
+	Returns false with the reason in error (if given) if the file could not be loaded, leaving it to the caller how to handle that
+*/
+bool vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale, const VertexLayout& vertexLayout, std::string* error)
+{
+	std::string parseError;
+	if (!parseFile(filename, device, fileLoadingFlags, scale, vertexLayout, &parseError)) {
+		if (error) {
+			*error = "Could not load glTF file \"" + filename + "\": " + parseError;
+		}
+		return false;
+	}
+	// Images and geometry batches are decoded in parallel on a pool of its own, the scene structure is built first as the batches depend on it
+	vks::ThreadPool pool;
+	pool.prepare();
+	for (uint32_t i = 0; i < static_cast<uint32_t>(textures.size()); i++) {
+		pool.push([this, i] { decodeImage(i); });
+	}
+	decodeScene();
+	for (uint32_t i = 0; i < getGeometryBatchCount(); i++) {
+		pool.push([this, i] { decodeGeometry(i); });
+	}
+	pool.wait();
+	pool.destroy();
+	finishDecode();
+	upload(transferQueue);
+	return true;
+}
+
+/*
+	First phase of loading a model: parses the glTF file without decoding any images
+	The phases up to upload() only work on CPU memory (and create host visible uniform buffers through the thread safe allocator),
+	so they can run on worker threads, with decodeImage() for different images running in parallel
+*/
+bool vkglTF::Model::parseFile(std::string filename, vks::VulkanDevice* device, uint32_t fileLoadingFlags, float scale, const VertexLayout& vertexLayout, std::string* error)
 {
-	tinygltf::Model gltfModel;
+	assert(vertexLayout.has(VertexComponent::Position));
+	this->vertexLayout = vertexLayout;
+	loadState = std::make_unique<LoadState>();
+	loadState->fileLoadingFlags = fileLoadingFlags;
+	loadState->scale = scale;
+	loadState->filename = filename;
+
 	tinygltf::TinyGLTF gltfContext;
 	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
 		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
@@ -1160,78 +1837,124 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice* device
 	size_t pos = filename.find_last_of('/');
 	path = filename.substr(0, pos);
 
-	std::string error, warning;
+	std::string warning;
 
 	this->device = device;
 
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
-
-	std::vector<uint32_t> indexBuffer;
-	std::vector<Vertex> vertexBuffer;
-
-	if (fileLoaded) {
-		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-			loadImages(gltfModel, device, transferQueue);
-		}
-		loadMaterials(gltfModel);
-		const tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
-		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
-		}
-		if (gltfModel.animations.size() > 0) {
-			loadAnimations(gltfModel);
+	// A fresh baked cache replaces parsing the file and all of the decoding
+	if (!(fileLoadingFlags & FileLoadingFlags::DontUseCache)) {
+		if (cache::fileStamp(filename, loadState->sourceSize, loadState->sourceWriteTime) && readCache(filename)) {
+			return true;
 		}
-		loadSkins(gltfModel);
+	}
 
-		for (auto node : linearNodes) {
-			// Assign skins
-			if (node->skinIndex > -1) {
-				node->skin = skins[node->skinIndex];
-			}
-			// Initial pose
-			if (node->mesh) {
-				node->update();
+	// Binary files keep the buffers in the file's binary chunk, without base64 or side-car files to resolve
+	// They are told apart by their magic rather than their extension, which may be in any case (or missing)
+	char magic[4] = {};
+	std::ifstream file(filename, std::ios::binary);
+	const bool binary = file.read(magic, sizeof(magic)) && (memcmp(magic, "glTF", sizeof(magic)) == 0);
+	file.close();
+	const bool fileLoaded = binary ?
+		gltfContext.LoadBinaryFromFile(&loadState->gltfModel, error, &warning, filename) :
+		gltfContext.LoadASCIIFromFile(&loadState->gltfModel, error, &warning, filename);
+	if (!fileLoaded) {
+		loadState.reset();
+		return false;
+	}
+
+	// Joint indices index into their skin's joints and are stored as uint8 by skin quantization
+	if (vertexLayout.quantization & QuantizeSkin) {
+		for (const tinygltf::Skin& skin : loadState->gltfModel.skins) {
+			if (skin.joints.size() > 255) {
+				if (error) {
+					*error = "Skin \"" + skin.name + "\" has " + std::to_string(skin.joints.size()) + " joints, more than vertex layouts with QuantizeSkin can index";
+				}
+				loadState.reset();
+				return false;
 			}
 		}
 	}
-	else {
-		// TODO: throw
-		vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
+
+	// Sized up front as materials keep pointers to the textures
+	if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		textures.resize(loadState->gltfModel.images.size());
+	}
+	return true;
+}
+
+/*
+	Decodes a single image of the parsed file, calls for different images may run in parallel
+*/
+void vkglTF::Model::decodeImage(uint32_t index)
+{
+	assert(loadState && index < textures.size());
+	if (loadState->fromCache) {
 		return;
 	}
+	textures[index].decode(loadState->gltfModel.images[index], path);
+}
 
-	// Pre-Calculations for requested features
-	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
-		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
-		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
-		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
-		for (Node* node : linearNodes) {
-			if (node->mesh) {
-				const glm::mat4 localMatrix = node->getMatrix();
-				for (Primitive* primitive : node->mesh->primitives) {
-					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
-						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
-						// Pre-transform vertex positions by node-hierarchy
-						if (preTransform) {
-							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
-							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
-						}
-						// Flip Y-Axis of vertex positions
-						if (flipY) {
-							vertex.pos.y *= -1.0f;
-							vertex.normal.y *= -1.0f;
-						}
-						// Pre-Multiply vertex colors with material base color
-						if (preMultiplyColor) {
-							vertex.color = primitive->material.baseColorFactor * vertex.color;
-						}
-					}
-				}
+/*
+	Converts the node hierarchy, meshes, materials, animations and skins of the parsed file
+	Only reserves the places of the vertices and indices that need converting, these are filled by decodeGeometry()
+*/
+void vkglTF::Model::decodeScene()
+{
+	assert(loadState);
+	if (loadState->fromCache) {
+		return;
+	}
+	tinygltf::Model& gltfModel = loadState->gltfModel;
+
+	// Indices are relative to their primitive's first vertex, so 16 bit indices do if no primitive has more vertices than they can address
+	indices.type = VK_INDEX_TYPE_UINT16;
+	for (const tinygltf::Mesh& mesh : gltfModel.meshes) {
+		for (const tinygltf::Primitive& primitive : mesh.primitives) {
+			auto position = primitive.attributes.find("POSITION");
+			if ((position != primitive.attributes.end()) && (gltfModel.accessors[position->second].count > 65536)) {
+				indices.type = VK_INDEX_TYPE_UINT32;
 			}
 		}
 	}
 
+	loadMaterials(gltfModel);
+	const tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		const tinygltf::Node& node = gltfModel.nodes[scene.nodes[i]];
+		loadNode(nullptr, node, scene.nodes[i], gltfModel, loadState->scale);
+	}
+
+	// Every converted element gets written exactly once, so the CPU buffers are sized once and never grow while the batches run
+	loadState->vertexBuffer.resize(loadState->convertedVertexCount * vertexLayout.stride);
+	loadState->indexBuffer.resize(loadState->convertedIndexCount * indices.stride());
+
+	// Group the slices into batches of similar conversion work, so small primitives don't end up as jobs of their own
+	uint32_t batchWork = 0;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(loadState->primitiveDecodes.size()); i++) {
+		if ((i == 0) || (batchWork >= LoadState::geometryBatchSize)) {
+			loadState->geometryBatches.push_back(i);
+			batchWork = 0;
+		}
+		batchWork += loadState->primitiveDecodes[i].end - loadState->primitiveDecodes[i].begin;
+	}
+
+	if (gltfModel.animations.size() > 0) {
+		loadAnimations(gltfModel);
+	}
+	loadSkins(gltfModel);
+	createNodeTransforms();
+
+	for (auto node : linearNodes) {
+		// Assign skins
+		if (node->skinIndex > -1) {
+			node->skin = skins[node->skinIndex];
+		}
+		// Initial pose
+		if (node->mesh) {
+			node->update();
+		}
+	}
+
 	for (auto extension : gltfModel.extensionsUsed) {
 		if (extension == "KHR_materials_pbrSpecularGlossiness") {
 			std::cout << "Required extension: " << extension;
@@ -1239,71 +1962,173 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice* device
 		}
 	}
 
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-	indices.count = static_cast<uint32_t>(indexBuffer.size());
-	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+	getSceneDimensions();
+}
 
-	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+/*
+	Returns the number of batches decodeGeometry() has to be called for, valid once decodeScene() has run
+*/
+uint32_t vkglTF::Model::getGeometryBatchCount() const
+{
+	assert(loadState);
+	return static_cast<uint32_t>(loadState->geometryBatches.size());
+}
 
-	struct StagingBuffer {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertexStaging, indexStaging;
+/*
+	Converts the vertices and indices of one batch of primitive slices, calls for different batches may run in parallel
+	with each other and with decodeImage(), as every primitive writes to its own reserved part of the CPU buffers
+*/
+void vkglTF::Model::decodeGeometry(uint32_t batch)
+{
+	assert(loadState && batch < loadState->geometryBatches.size());
+	const uint32_t first = loadState->geometryBatches[batch];
+	const uint32_t last = (batch + 1 < loadState->geometryBatches.size()) ? loadState->geometryBatches[batch + 1] : static_cast<uint32_t>(loadState->primitiveDecodes.size());
+	for (uint32_t i = first; i < last; i++) {
+		decodePrimitive(loadState->primitiveDecodes[i]);
+	}
+}
 
-	// Create staging buffers
-	// Vertex data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
-	// Index data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize,
-		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
+/*
+	Called once all images, the scene and all geometry batches have been decoded, gathers the meshlets and levels of detail of all primitives,
+	bakes the result into the cache for the next load and prints the vertex cache statistics of optimized meshes
+*/
+void vkglTF::Model::finishDecode()
+{
+	assert(loadState);
+	if ((loadState->fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) && !loadState->fromCache) {
+		optimize::CacheStats before, after;
+		for (const LoadState::PrimitiveDecode& decode : loadState->primitiveDecodes) {
+			before += decode.statsBefore;
+			after += decode.statsAfter;
+		}
+		std::cout << "Optimized meshes of " << loadState->filename << " (" << after.triangleCount << " triangles): ACMR " << before.acmr() << " -> " << after.acmr() << ", ATVR " << before.atvr() << " -> " << after.atvr() << std::endl;
+	}
+	// Meshlets are gathered in the order of the primitives, a primitive's meshlets all come from its single slice
+	for (LoadState::PrimitiveDecode& decode : loadState->primitiveDecodes) {
+		if (!decode.meshlets.empty()) {
+			decode.target->firstMeshlet = static_cast<uint32_t>(meshlets.size());
+			decode.target->meshletCount = static_cast<uint32_t>(decode.meshlets.size());
+			meshlets.insert(meshlets.end(), decode.meshlets.begin(), decode.meshlets.end());
+		}
+	}
+	// Levels of detail go behind the indices of all primitives, so the index buffer holds exactly the levels that have been generated
+	for (LoadState::PrimitiveDecode& decode : loadState->primitiveDecodes) {
+		if (decode.lodIndices.empty()) {
+			continue;
+		}
+		const uint32_t lodIndexCount = static_cast<uint32_t>(decode.lodIndices.size());
+		const size_t srcOffset = loadState->convertedIndexCount * indices.stride();
+		loadState->indexBuffer.resize(srcOffset + lodIndexCount * indices.stride());
+		unsigned char* dst = &loadState->indexBuffer[srcOffset];
+		if (indices.type == VK_INDEX_TYPE_UINT16) {
+			convertIndices(TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT, reinterpret_cast<const unsigned char*>(decode.lodIndices.data()), 0, lodIndexCount, reinterpret_cast<uint16_t*>(dst));
+		}
+		else {
+			memcpy(dst, decode.lodIndices.data(), lodIndexCount * sizeof(uint32_t));
+		}
+		loadState->indexRanges.push_back({ nullptr, srcOffset, lodIndexCount * indices.stride() });
+		for (size_t i = 1; i < decode.target->lods.size(); i++) {
+			decode.target->lods[i].firstIndex += loadState->indexCount;
+		}
+		loadState->indexCount += lodIndexCount;
+		loadState->convertedIndexCount += lodIndexCount;
+		decode.lodIndices.clear();
+		decode.lodIndices.shrink_to_fit();
+	}
+	if (!loadState->fromCache && !(loadState->fileLoadingFlags & FileLoadingFlags::DontUseCache)) {
+		writeCache(loadState->filename);
+	}
+}
+
+/*
+	Last phase of loading a model: creates the device resources and records their uploads
+	Has to run on the thread that owns the device's staging ring and transfer contexts
+*/
+void vkglTF::Model::upload(VkQueue transferQueue)
+{
+	assert(loadState);
+	const std::vector<unsigned char>& indexBuffer = loadState->indexBuffer;
+	const std::vector<unsigned char>& vertexBuffer = loadState->vertexBuffer;
+
+	// Initial pose of the nodes
+	flushNodeTransforms();
+
+	if (!(loadState->fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		for (vkglTF::Texture& texture : textures) {
+			texture.upload(device, transferQueue);
+		}
+		// Create an empty texture to be used for empty material images
+		createEmptyTexture(transferQueue);
+	}
+
+	size_t vertexBufferSize = loadState->vertexCount * vertexLayout.stride;
+	size_t indexBufferSize = loadState->indexCount * indices.stride();
+	indices.count = static_cast<uint32_t>(loadState->indexCount);
+	vertices.count = static_cast<uint32_t>(loadState->vertexCount);
+
+	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
 
 	// Create device local buffers
-	// Vertex buffer
+	// Vertex buffer, compute skinning reads it as a storage buffer and copies it into its skinned vertex buffer
+	const VkBufferUsageFlags skinningUsage = (loadState->fileLoadingFlags & FileLoadingFlags::ComputeSkinning) ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT : 0;
 	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | skinningUsage | memoryPropertyFlags,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		vertexBufferSize,
 		&vertices.buffer,
-		&vertices.memory));
+		&vertices.allocation));
 	// Index buffer
 	VK_CHECK_RESULT(device->createBuffer(
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		indexBufferSize,
 		&indices.buffer,
-		&indices.memory));
-
-	// Copy from staging buffers
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		&indices.allocation));
 
+	// Copy through the device's staging ring, batched with the texture uploads of this model
+	// Each copy is recorded right after its staging region has been acquired, as acquiring may submit the open batch
+	// Ranges stored in the GPU layout are copied from the file data, all others from the CPU buffers
 	VkBufferCopy copyRegion = {};
-
+	vks::StagingRing::Region vertexStaging = device->stagingRing.allocate(transferQueue, vertexBufferSize);
+	LoadState::gatherRanges(loadState->vertexRanges, vertexBuffer.data(), vertexStaging.data);
+	copyRegion.srcOffset = vertexStaging.offset;
 	copyRegion.size = vertexBufferSize;
-	vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+	vkCmdCopyBuffer(device->getTransferContext(transferQueue).getCommandBuffer(transferQueue), vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
 
+	vks::StagingRing::Region indexStaging = device->stagingRing.allocate(transferQueue, indexBufferSize);
+	LoadState::gatherRanges(loadState->indexRanges, indexBuffer.data(), indexStaging.data);
+	copyRegion.srcOffset = indexStaging.offset;
 	copyRegion.size = indexBufferSize;
-	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
+	vkCmdCopyBuffer(device->getTransferContext(transferQueue).getCommandBuffer(transferQueue), indexStaging.buffer, indices.buffer, 1, &copyRegion);
 
-	device->flushCommandBuffer(copyCmd, transferQueue, true);
+	// Make the copies visible to vertex input of later submissions on the graphics queue
+	device->finishBufferUpload(transferQueue, vertices.buffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	device->finishBufferUpload(transferQueue, indices.buffer, VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
-	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+	if (loadState->fileLoadingFlags & FileLoadingFlags::IndirectDraw) {
+		prepareIndirect(transferQueue);
+	}
 
-	getSceneDimensions();
+	if (loadState->fileLoadingFlags & FileLoadingFlags::BindlessMaterials) {
+		if (!supportsBindlessMaterials(device)) {
+			std::cout << "Descriptor indexing not enabled, " << loadState->filename << " uses per material descriptor sets" << std::endl;
+		} else if (textures.size() > getMaxBindlessTextures(device)) {
+			std::cout << loadState->filename << " has more textures than the bindless texture array holds, it uses per material descriptor sets" << std::endl;
+		} else {
+			const std::vector<IndirectMaterial> materialTable = getMaterialTable();
+			if (!materialTable.empty()) {
+				uploadBuffer(transferQueue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, materialTable.data(), materialTable.size() * sizeof(IndirectMaterial), bindless.materials, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+				bindless.prepared = true;
+			}
+		}
+	}
+
+	// All copies of this model go to the queue in one batch, callers only block on the ticket when they need the data
+	// On the dedicated transfer queue the ticket is the one of the graphics batch that acquires the resources
+	uploadTicket = device->getTransferContext(transferQueue).submit();
+	if (device->getOwnerQueue(transferQueue) != transferQueue) {
+		uploadTicket = device->transfer.currentTicket(device->graphicsQueue);
+	}
 
 	// Setup descriptors
 	uint32_t uboCount{ 0 };
@@ -1318,9 +2143,23 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice* device
 			imageCount++;
 		}
 	}
+	// All mesh nodes share a single dynamic uniform buffer descriptor
+	const uint32_t uboSetCount = (uboCount > 0) ? 1 : 0;
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, std::max(uboSetCount, 1u) },
 	};
+	const uint32_t indirectSetCount = indirect.prepared ? 1 : 0;
+	if (indirect.prepared) {
+		poolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 });
+		poolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 });
+	}
+	// The texture array of the bindless set holds all textures of the model, and a pool size can't be zero
+	const uint32_t bindlessSetCount = bindless.prepared ? 1 : 0;
+	const uint32_t bindlessTextureCount = static_cast<uint32_t>(textures.size());
+	if (bindless.prepared) {
+		poolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 });
+		poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, std::max(bindlessTextureCount, 1u) });
+	}
 	if (imageCount > 0) {
 		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
 			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
@@ -1333,7 +2172,7 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice* device
 	descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	descriptorPoolCI.pPoolSizes = poolSizes.data();
-	descriptorPoolCI.maxSets = uboCount + imageCount;
+	descriptorPoolCI.maxSets = uboSetCount + imageCount + indirectSetCount + bindlessSetCount;
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
 
 	// Descriptors for per-node uniform buffers
@@ -1341,7 +2180,7 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice* device
 		// Layout is global, so only create if it hasn't already been created before
 		if (descriptorSetLayoutUbo == VK_NULL_HANDLE) {
 			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0),
 			};
 			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
 			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1377,19 +2216,125 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice* device
 			}
 		}
 	}
+
+	// Descriptors for the storage buffers of indirect drawing
+	if (indirect.prepared) {
+		// Layout is global, so only create if it hasn't already been created before
+		if (descriptorSetLayoutIndirect == VK_NULL_HANDLE) {
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 1),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+			descriptorLayoutCI.pBindings = setLayoutBindings.data();
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutIndirect));
+		}
+		VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayoutIndirect, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &indirect.descriptorSet));
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &indirect.drawData.descriptor),
+			vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, &indirect.transforms.descriptor),
+			vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &indirect.materials.descriptor),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	// Descriptors for bindless materials, a single set with the material table and all textures
+	if (bindless.prepared) {
+		// Layout is global, so only create if it hasn't already been created before
+		if (descriptorSetLayoutBindless == VK_NULL_HANDLE) {
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, getMaxBindlessTextures(device)),
+			};
+			// The texture array is sized per set on allocation, and only the textures a draw actually samples have to be valid
+			std::vector<VkDescriptorBindingFlagsEXT> bindingFlags = {
+				0,
+				VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT,
+			};
+			VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCI{};
+			bindingFlagsCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+			bindingFlagsCI.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+			bindingFlagsCI.pBindingFlags = bindingFlags.data();
+			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			descriptorLayoutCI.pNext = &bindingFlagsCI;
+			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+			descriptorLayoutCI.pBindings = setLayoutBindings.data();
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutBindless));
+		}
+		VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountAllocInfo{};
+		variableCountAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+		variableCountAllocInfo.descriptorSetCount = 1;
+		variableCountAllocInfo.pDescriptorCounts = &bindlessTextureCount;
+		VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayoutBindless, 1);
+		descriptorSetAllocInfo.pNext = &variableCountAllocInfo;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &bindless.descriptorSet));
+		std::vector<VkDescriptorImageInfo> imageDescriptors(textures.size());
+		for (size_t i = 0; i < textures.size(); i++) {
+			imageDescriptors[i] = textures[i].descriptor;
+		}
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(bindless.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bindless.materials.descriptor),
+		};
+		if (!imageDescriptors.empty()) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(bindless.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, imageDescriptors.data(), bindlessTextureCount));
+		}
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	// The CPU side copies of the file and the geometry aren't needed anymore
+	loadState.reset();
+}
+
+/*
+	Copies a buffer's ranges to their consecutive places in the staging memory
+*/
+void vkglTF::Model::LoadState::gatherRanges(const std::vector<CopyRange>& ranges, const void* converted, void* dst)
+{
+	unsigned char* dstBytes = static_cast<unsigned char*>(dst);
+	for (const CopyRange& range : ranges) {
+		const unsigned char* src = range.fileData ? range.fileData : static_cast<const unsigned char*>(converted) + range.srcOffset;
+		memcpy(dstBytes, src, range.size);
+		dstBytes += range.size;
+	}
+}
+
+/*
+	Returns the number of bytes upload() will copy through the staging ring
+*/
+VkDeviceSize vkglTF::Model::getPendingUploadSize() const
+{
+	if (!loadState) {
+		return 0;
+	}
+	VkDeviceSize size = loadState->vertexCount * vertexLayout.stride + loadState->indexCount * indices.stride();
+	for (const vkglTF::Texture& texture : textures) {
+		if (texture.source) {
+			size += texture.source->ktx ? ktxTexture_GetSize(texture.source->ktx) : texture.source->pixels.size() + texture.source->mipChainSize;
+		}
+	}
+	return size;
 }
 
 void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 {
 	const VkDeviceSize offsets[1] = { 0 };
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
 	buffersBound = true;
 }
 
-void vkglTF::Model::drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+void vkglTF::Model::drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t bindNodeSet)
 {
 	if (node->mesh) {
+		// All meshes share one dynamic uniform buffer set, the offset selects the node's slot in the current frame's copy
+		if ((renderFlags & RenderFlags::BindNodeTransforms) && (node->mesh->uniformBuffer.descriptorSet != VK_NULL_HANDLE)) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindNodeSet, 1, &node->mesh->uniformBuffer.descriptorSet, 1, &node->mesh->uniformBuffer.dynamicOffset);
+		}
 		for (Primitive* primitive : node->mesh->primitives) {
 			bool skip = false;
 			const vkglTF::Material& material = primitive->material;
@@ -1403,27 +2348,307 @@ void vkglTF::Model::drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t
 				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
 			}
 			if (!skip) {
-				if (renderFlags & RenderFlags::BindImages) {
+				if ((renderFlags & RenderFlags::BindImages) && bindless.prepared) {
+					// draw() has bound the bindless set, only the index into its material table changes
+					const uint32_t materialIndex = static_cast<uint32_t>(&material - materials.data());
+					vkCmdPushConstants(commandBuffer, pipelineLayout, bindlessPushConstantStages, bindlessPushConstantOffset, sizeof(uint32_t), &materialIndex);
+				} else if (renderFlags & RenderFlags::BindImages) {
 					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
 				}
-				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+				uint32_t firstIndex = primitive->firstIndex;
+				uint32_t indexCount = primitive->indexCount;
+				if (lodView.enabled && (primitive->lods.size() > 1)) {
+					const Primitive::Lod& lod = primitive->lods[primitive->selectLod(node->mesh->uniformBlock.matrix, lodView.cameraPosition, lodView.projectionScale, lodView.threshold)];
+					firstIndex = lod.firstIndex;
+					indexCount = lod.indexCount;
+				}
+				vkCmdDrawIndexed(commandBuffer, indexCount, 1, firstIndex, static_cast<int32_t>(primitive->firstVertex), 0);
 			}
 		}
 	}
 	for (auto& child : node->children) {
-		drawNode(child, commandBuffer, renderFlags);
+		drawNode(child, commandBuffer, renderFlags, pipelineLayout, bindImageSet, bindNodeSet);
 	}
 }
 
-void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t bindNodeSet)
 {
 	if (!buffersBound) {
 		const VkDeviceSize offsets[1] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
+	}
+	if ((renderFlags & RenderFlags::BindImages) && bindless.prepared) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &bindless.descriptorSet, 0, nullptr);
 	}
 	for (auto& node : nodes) {
-		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet, bindNodeSet);
+	}
+}
+
+/*
+	Uploads data into a new device local buffer through the device's staging ring
+*/
+void vkglTF::Model::uploadBuffer(VkQueue transferQueue, VkBufferUsageFlags usageFlags, const void* data, VkDeviceSize size, vks::Buffer& buffer, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask)
+{
+	VK_CHECK_RESULT(device->createBuffer(usageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, size));
+	vks::StagingRing::Region staging = device->stagingRing.allocate(transferQueue, size);
+	memcpy(staging.data, data, size);
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = staging.offset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(device->getTransferContext(transferQueue).getCommandBuffer(transferQueue), staging.buffer, buffer.buffer, 1, &copyRegion);
+	device->finishBufferUpload(transferQueue, buffer.buffer, dstAccessMask, dstStageMask);
+}
+
+/*
+	Flattens all primitives of the model into draw commands and creates the buffers drawIndirect() reads from
+	Primitives with meshlets get a draw command per meshlet, so the culling pass can cull parts of large meshes
+	Levels of detail of the other primitives go to the lods buffer, the culling pass picks one of them per draw
+	Commands are sorted by alpha mode, so each group is a contiguous range of the command buffer
+*/
+void vkglTF::Model::prepareIndirect(VkQueue transferQueue)
+{
+	// Every draw's firstInstance is its own index, indirect draws with a non-zero firstInstance need drawIndirectFirstInstance
+	if (!device->enabledFeatures.drawIndirectFirstInstance) {
+		std::cout << "drawIndirectFirstInstance not enabled, " << loadState->filename << " can't be drawn indirectly" << std::endl;
+		return;
+	}
+	std::vector<VkDrawIndexedIndirectCommand> groupCommands[Indirect::GroupCount];
+	std::vector<IndirectDrawData> groupDrawData[Indirect::GroupCount];
+	std::vector<IndirectBounds> groupBounds[Indirect::GroupCount];
+	std::vector<IndirectLod> lods;
+	indirect.transformNodes.clear();
+	for (Node* node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		const uint32_t transformIndex = static_cast<uint32_t>(indirect.transformNodes.size());
+		indirect.transformNodes.push_back(node);
+		for (Primitive* primitive : node->mesh->primitives) {
+			if (primitive->indexCount == 0) {
+				continue;
+			}
+			const Material& material = primitive->material;
+			const uint32_t group = (material.alphaMode == Material::ALPHAMODE_MASK) ? Indirect::Mask : (material.alphaMode == Material::ALPHAMODE_BLEND) ? Indirect::Blend : Indirect::Opaque;
+			VkDrawIndexedIndirectCommand command{};
+			command.instanceCount = 1;
+			command.vertexOffset = static_cast<int32_t>(primitive->firstVertex);
+			IndirectDrawData drawData{};
+			drawData.transformIndex = transformIndex;
+			drawData.materialIndex = static_cast<uint32_t>(&material - materials.data());
+			IndirectBounds bounds{};
+			bounds.transformIndex = transformIndex;
+			bounds.group = group;
+			bounds.coneCutoff = 1.0f;
+			if (primitive->meshletCount == 0) {
+				command.indexCount = primitive->indexCount;
+				command.firstIndex = primitive->firstIndex;
+				bounds.center = primitive->dimensions.center;
+				bounds.extents = primitive->dimensions.size * 0.5f;
+				bounds.radius = primitive->dimensions.radius;
+				if (primitive->lods.size() > 1) {
+					bounds.firstLod = static_cast<uint32_t>(lods.size());
+					bounds.lodCount = static_cast<uint32_t>(primitive->lods.size());
+					for (const Primitive::Lod& lod : primitive->lods) {
+						lods.push_back({ lod.firstIndex, lod.indexCount, lod.error, 0 });
+					}
+				}
+				groupCommands[group].push_back(command);
+				groupDrawData[group].push_back(drawData);
+				groupBounds[group].push_back(bounds);
+				continue;
+			}
+			for (uint32_t i = 0; i < primitive->meshletCount; i++) {
+				const optimize::Meshlet& meshlet = meshlets[primitive->firstMeshlet + i];
+				command.indexCount = meshlet.indexCount;
+				command.firstIndex = primitive->firstIndex + meshlet.firstIndex;
+				bounds.center = meshlet.center;
+				bounds.extents = glm::vec3(meshlet.radius);
+				bounds.coneAxis = meshlet.coneAxis;
+				bounds.coneCutoff = material.doubleSided ? 1.0f : meshlet.coneCutoff;
+				groupCommands[group].push_back(command);
+				groupDrawData[group].push_back(drawData);
+				groupBounds[group].push_back(bounds);
+			}
+		}
+	}
+
+	std::vector<VkDrawIndexedIndirectCommand> commands;
+	std::vector<IndirectDrawData> drawData;
+	std::vector<IndirectBounds> bounds;
+	uint32_t counts[Indirect::GroupCount];
+	for (uint32_t group = 0; group < Indirect::GroupCount; group++) {
+		indirect.firstDraw[group] = static_cast<uint32_t>(commands.size());
+		indirect.drawCount[group] = static_cast<uint32_t>(groupCommands[group].size());
+		counts[group] = indirect.drawCount[group];
+		commands.insert(commands.end(), groupCommands[group].begin(), groupCommands[group].end());
+		drawData.insert(drawData.end(), groupDrawData[group].begin(), groupDrawData[group].end());
+		bounds.insert(bounds.end(), groupBounds[group].begin(), groupBounds[group].end());
+	}
+	if (commands.empty()) {
+		return;
+	}
+	// The instance index of a draw is its index in the command buffer, so shaders find their draw data through gl_InstanceIndex
+	for (uint32_t i = 0; i < commands.size(); i++) {
+		commands[i].firstInstance = i;
+	}
+
+	const std::vector<IndirectMaterial> indirectMaterials = getMaterialTable();
+
+	uploadBuffer(transferQueue, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand), indirect.commands, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+	uploadBuffer(transferQueue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand), indirect.sourceCommands, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	uploadBuffer(transferQueue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, bounds.data(), bounds.size() * sizeof(IndirectBounds), indirect.bounds, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	// Bound by the culling pass whether there are levels of detail or not, and empty buffers can't be created
+	if (lods.empty()) {
+		lods.push_back({});
+	}
+	uploadBuffer(transferQueue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, lods.data(), lods.size() * sizeof(IndirectLod), indirect.lods, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	uploadBuffer(transferQueue, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, counts, sizeof(counts), indirect.counts, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+	uploadBuffer(transferQueue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, drawData.data(), drawData.size() * sizeof(IndirectDrawData), indirect.drawData, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	uploadBuffer(transferQueue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, indirectMaterials.data(), indirectMaterials.size() * sizeof(IndirectMaterial), indirect.materials, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	// Node matrices change with animations, so they stay host visible and are written in place, into one copy per frame in flight
+	const VkDeviceSize alignment = device->properties.limits.minStorageBufferOffsetAlignment;
+	indirect.transformsFrameSize = (indirect.transformNodes.size() * sizeof(glm::mat4) + alignment - 1) & ~(alignment - 1);
+	indirect.dynamicOffset = static_cast<uint32_t>(frameIndex * indirect.transformsFrameSize);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &indirect.transforms, frameCount * indirect.transformsFrameSize));
+	VK_CHECK_RESULT(indirect.transforms.map());
+	indirect.transforms.setupDescriptor(indirect.transformsFrameSize);
+	for (uint32_t frame = 0; frame < frameCount; frame++) {
+		indirect.dynamicOffset = static_cast<uint32_t>(frame * indirect.transformsFrameSize);
+		updateIndirectTransforms();
+	}
+	indirect.dynamicOffset = static_cast<uint32_t>(frameIndex * indirect.transformsFrameSize);
+
+	// The count variant is core in Vulkan 1.2, but only usable with its feature enabled, before that it needs the extension
+	if (device->extensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+		indirect.vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+	} else if (device->enabledDrawIndirectCount) {
+		indirect.vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCount"));
+	}
+	indirect.prepared = true;
+}
+
+/*
+	Material parameters of all materials for the materials storage buffers of indirect drawing and bindless materials
+*/
+std::vector<vkglTF::IndirectMaterial> vkglTF::Model::getMaterialTable() const
+{
+	// Materials may also point at emptyTexture, which isn't part of the texture array, so pointers are only subtracted once they are known to be in it
+	auto textureIndex = [&](const vkglTF::Texture* texture) -> int32_t {
+		const std::less<const vkglTF::Texture*> less;
+		if (!texture || less(texture, textures.data()) || !less(texture, textures.data() + textures.size())) {
+			return -1;
+		}
+		return static_cast<int32_t>(texture - textures.data());
+	};
+	std::vector<IndirectMaterial> table(materials.size());
+	for (size_t i = 0; i < materials.size(); i++) {
+		const Material& material = materials[i];
+		table[i].baseColorFactor = material.baseColorFactor;
+		table[i].metallicFactor = material.metallicFactor;
+		table[i].roughnessFactor = material.roughnessFactor;
+		table[i].alphaCutoff = material.alphaCutoff;
+		table[i].baseColorTexture = textureIndex(material.baseColorTexture);
+		table[i].normalTexture = textureIndex(material.normalTexture);
+	}
+	return table;
+}
+
+/*
+	Copies the current node matrices into the current frame's copy of the transforms buffer of indirect drawing
+	Call after updating animations, before submitting work that draws the model
+*/
+void vkglTF::Model::updateIndirectTransforms()
+{
+	if (!indirect.transforms.mapped) {
+		return;
+	}
+	glm::mat4* transforms = reinterpret_cast<glm::mat4*>(static_cast<unsigned char*>(indirect.transforms.mapped) + indirect.dynamicOffset);
+	for (size_t i = 0; i < indirect.transformNodes.size(); i++) {
+		transforms[i] = indirect.transformNodes[i]->mesh->uniformBlock.matrix;
+	}
+}
+
+/*
+	Enables level of detail selection in drawNode() and draw() for the given camera
+	threshold is the largest error in pixels a coarser level may show on a viewport of viewportHeight pixels
+*/
+void vkglTF::Model::setLodView(const glm::mat4& view, const glm::mat4& projection, float viewportHeight, float threshold)
+{
+	lodView.enabled = true;
+	lodView.cameraPosition = glm::vec3(glm::inverse(view)[3]);
+	lodView.projectionScale = std::abs(projection[1][1]) * viewportHeight * 0.5f;
+	lodView.threshold = threshold;
+}
+
+/*
+	Draws the whole model with at most one draw call per alpha mode, see Model::Indirect
+	The draw data, transforms and materials are bound at bindSet if a pipeline layout is passed, the transforms of the current frame (see setFrameIndex())
+	With RenderFlags::BindImages the bindless set is bound at bindSet + 1, without bindless materials the flag is ignored
+	as per material images can't change within a single draw call
+*/
+void vkglTF::Model::drawIndirect(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindSet)
+{
+	if (!indirect.prepared) {
+		return;
+	}
+	if (!buffersBound) {
+		const VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
+	}
+	if (pipelineLayout != VK_NULL_HANDLE) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindSet, 1, &indirect.descriptorSet, 1, &indirect.dynamicOffset);
+		if ((renderFlags & RenderFlags::BindImages) && bindless.prepared) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindSet + 1, 1, &bindless.descriptorSet, 0, nullptr);
+		}
+	}
+
+	bool drawGroup[Indirect::GroupCount] = {
+		(renderFlags & RenderFlags::RenderOpaqueNodes) != 0,
+		(renderFlags & RenderFlags::RenderAlphaMaskedNodes) != 0,
+		(renderFlags & RenderFlags::RenderAlphaBlendedNodes) != 0,
+	};
+	if (!drawGroup[Indirect::Opaque] && !drawGroup[Indirect::Mask] && !drawGroup[Indirect::Blend]) {
+		drawGroup[Indirect::Opaque] = drawGroup[Indirect::Mask] = drawGroup[Indirect::Blend] = true;
+	}
+
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	if (indirect.vkCmdDrawIndexedIndirectCountKHR) {
+		// The GPU reads the number of draws, so later passes (e.g. culling) can shrink a group without re-recording
+		for (uint32_t group = 0; group < Indirect::GroupCount; group++) {
+			if (drawGroup[group] && (indirect.drawCount[group] > 0)) {
+				indirect.vkCmdDrawIndexedIndirectCountKHR(commandBuffer, indirect.commands.buffer, indirect.firstDraw[group] * stride, indirect.counts.buffer, group * sizeof(uint32_t), indirect.drawCount[group], stride);
+			}
+		}
+		return;
+	}
+
+	// Without the count variant adjacent selected groups are merged into one range of commands
+	uint32_t group = 0;
+	while (group < Indirect::GroupCount) {
+		if (!drawGroup[group]) {
+			group++;
+			continue;
+		}
+		const uint32_t firstDraw = indirect.firstDraw[group];
+		uint32_t drawCount = 0;
+		while ((group < Indirect::GroupCount) && drawGroup[group]) {
+			drawCount += indirect.drawCount[group];
+			group++;
+		}
+		if (drawCount == 0) {
+			continue;
+		}
+		if (device->enabledFeatures.multiDrawIndirect) {
+			vkCmdDrawIndexedIndirect(commandBuffer, indirect.commands.buffer, firstDraw * stride, drawCount, stride);
+		} else {
+			for (uint32_t i = 0; i < drawCount; i++) {
+				vkCmdDrawIndexedIndirect(commandBuffer, indirect.commands.buffer, (firstDraw + i) * stride, 1, stride);
+			}
+		}
 	}
 }
 
@@ -1458,6 +2683,10 @@ void vkglTF::Model::getSceneDimensions()
 	dimensions.radius = glm::distance(dimensions.min, dimensions.max) / 2.0f;
 }
 
+/*
+	Applies an animation at the given time, times outside its keys hold the first or last value
+	Each sampler remembers the interval it found last, so steady playback finds its keys in constant time
+*/
 void vkglTF::Model::updateAnimation(uint32_t index, float time)
 {
 	if (index > static_cast<uint32_t>(animations.size()) - 1) {
@@ -1469,49 +2698,33 @@ void vkglTF::Model::updateAnimation(uint32_t index, float time)
 	bool updated = false;
 	for (auto& channel : animation.channels) {
 		vkglTF::AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+		if (!sampler.valid()) {
 			continue;
 		}
-
-		for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					switch (channel.path) {
-					case vkglTF::AnimationChannel::PathType::TRANSLATION: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->translation = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::SCALE: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->scale = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::ROTATION: {
-						glm::quat q1;
-						q1.x = sampler.outputsVec4[i].x;
-						q1.y = sampler.outputsVec4[i].y;
-						q1.z = sampler.outputsVec4[i].z;
-						q1.w = sampler.outputsVec4[i].w;
-						glm::quat q2;
-						q2.x = sampler.outputsVec4[i + 1].x;
-						q2.y = sampler.outputsVec4[i + 1].y;
-						q2.z = sampler.outputsVec4[i + 1].z;
-						q2.w = sampler.outputsVec4[i + 1].w;
-						channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-						break;
-					}
-					}
-					updated = true;
-				}
-			}
+		const glm::vec4 value = sampler.sample(time, channel.path == vkglTF::AnimationChannel::PathType::ROTATION);
+		switch (channel.path) {
+		case vkglTF::AnimationChannel::PathType::TRANSLATION:
+			channel.node->translation = glm::vec3(value);
+			break;
+		case vkglTF::AnimationChannel::PathType::SCALE:
+			channel.node->scale = glm::vec3(value);
+			break;
+		case vkglTF::AnimationChannel::PathType::ROTATION:
+			channel.node->rotation = glm::quat(value.w, value.x, value.y, value.z);
+			break;
 		}
+		channel.node->dirty = true;
+		updated = true;
 	}
+	// Only subtrees below animated nodes are recomputed, and only meshes that moved are written
 	if (updated) {
-		for (auto& node : nodes) {
-			node->update();
+		for (Node* node : nodes) {
+			node->updateMatrices(false);
 		}
+		for (Node* node : linearNodes) {
+			node->uploadMatrices();
+		}
+		flushNodeTransforms();
 	}
 }
 
@@ -1543,26 +2756,169 @@ vkglTF::Node* vkglTF::Model::nodeFromIndex(uint32_t index) {
 	return nodeFound;
 }
 
+/*
+	Points the node's mesh and those of its children at the model's single node transform set, which is allocated on first use
+*/
 void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout) {
 	if (node->mesh) {
-		VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-		descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		descriptorSetAllocInfo.descriptorPool = descriptorPool;
-		descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-		descriptorSetAllocInfo.descriptorSetCount = 1;
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
-
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = node->mesh->uniformBuffer.descriptorSet;
-		writeDescriptorSet.dstBinding = 0;
-		writeDescriptorSet.pBufferInfo = &node->mesh->uniformBuffer.descriptor;
-
-		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		if (nodeTransforms.descriptorSet == VK_NULL_HANDLE) {
+			VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+			descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			descriptorSetAllocInfo.descriptorPool = descriptorPool;
+			descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
+			descriptorSetAllocInfo.descriptorSetCount = 1;
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &nodeTransforms.descriptorSet));
+
+			// The range covers one slot, the dynamic offset selects the node
+			VkWriteDescriptorSet writeDescriptorSet{};
+			writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			writeDescriptorSet.descriptorCount = 1;
+			writeDescriptorSet.dstSet = nodeTransforms.descriptorSet;
+			writeDescriptorSet.dstBinding = 0;
+			writeDescriptorSet.pBufferInfo = &node->mesh->uniformBuffer.descriptor;
+
+			vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		}
+		node->mesh->uniformBuffer.descriptorSet = nodeTransforms.descriptorSet;
 	}
 	for (auto& child : node->children) {
 		prepareNodeDescriptor(child, descriptorSetLayout);
 	}
 }
+
+/*
+	Creates the node transform buffer with a copy of all slots per frame in flight and gives every mesh its slot, before the initial pose is written
+*/
+void vkglTF::Model::createNodeTransforms()
+{
+	frameCount = std::max(framesInFlight, 1u);
+	frameIndex = 0;
+	const VkDeviceSize alignment = std::max(device->properties.limits.minUniformBufferOffsetAlignment, device->properties.limits.nonCoherentAtomSize);
+	nodeTransforms.slotSize = (sizeof(Mesh::UniformBlock) + alignment - 1) & ~(alignment - 1);
+	uint32_t slotCount = 0;
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			slotCount++;
+		}
+	}
+	if (slotCount == 0) {
+		return;
+	}
+	nodeTransforms.frameSize = slotCount * nodeTransforms.slotSize;
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		frameCount * nodeTransforms.frameSize,
+		&nodeTransforms.buffer,
+		&nodeTransforms.allocation));
+	nodeTransforms.coherent = (device->memoryProperties.memoryTypes[nodeTransforms.allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+	unsigned char* mapped = static_cast<unsigned char*>(nodeTransforms.allocation.mapped);
+	uint32_t slot = 0;
+	for (Node* node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		Mesh::UniformBuffer& uniformBuffer = node->mesh->uniformBuffer;
+		uniformBuffer.slotOffset = static_cast<uint32_t>(slot * nodeTransforms.slotSize);
+		uniformBuffer.dynamicOffset = uniformBuffer.slotOffset;
+		uniformBuffer.descriptor = { nodeTransforms.buffer, 0, sizeof(Mesh::UniformBlock) };
+		uniformBuffer.mapped = mapped + uniformBuffer.dynamicOffset;
+		// Every frame's copy starts out complete, later frames only rewrite what can change
+		for (uint32_t frame = 0; frame < frameCount; frame++) {
+			memcpy(mapped + frame * nodeTransforms.frameSize + uniformBuffer.slotOffset, &node->mesh->uniformBlock, sizeof(Mesh::UniformBlock));
+		}
+		uniformBuffer.dirty = true;
+		slot++;
+	}
+	// flushNodeTransforms() only covers the current frame's copy
+	if (!nodeTransforms.coherent) {
+		const VkDeviceSize atomSize = device->properties.limits.nonCoherentAtomSize;
+		VkMappedMemoryRange mappedRange{};
+		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		mappedRange.memory = nodeTransforms.allocation.memory;
+		mappedRange.offset = nodeTransforms.allocation.offset & ~(atomSize - 1);
+		mappedRange.size = ((nodeTransforms.allocation.offset + frameCount * nodeTransforms.frameSize + atomSize - 1) & ~(atomSize - 1)) - mappedRange.offset;
+		VK_CHECK_RESULT(vkFlushMappedMemoryRanges(device->logicalDevice, 1, &mappedRange));
+	}
+}
+
+/*
+	Makes the node transforms written since the last call visible to the device, with a single flush of the range of
+	slots that changed, call after updating nodes and before submitting work that reads them
+	Host coherent memory needs no flush, so this only clears the dirty flags then
+*/
+void vkglTF::Model::flushNodeTransforms()
+{
+	VkDeviceSize begin = VK_WHOLE_SIZE;
+	VkDeviceSize end = 0;
+	for (Node* node : linearNodes) {
+		if (node->mesh && node->mesh->uniformBuffer.dirty) {
+			const VkDeviceSize offset = node->mesh->uniformBuffer.dynamicOffset;
+			begin = std::min(begin, offset);
+			end = std::max(end, offset + nodeTransforms.slotSize);
+			node->mesh->uniformBuffer.dirty = false;
+		}
+	}
+	if (nodeTransforms.coherent || (begin >= end)) {
+		return;
+	}
+	// Slots are multiples of the atom size, the allocation's own offset may not be
+	const VkDeviceSize atomSize = device->properties.limits.nonCoherentAtomSize;
+	const VkDeviceSize rangeBegin = (nodeTransforms.allocation.offset + begin) & ~(atomSize - 1);
+	const VkDeviceSize rangeEnd = (nodeTransforms.allocation.offset + end + atomSize - 1) & ~(atomSize - 1);
+	VkMappedMemoryRange mappedRange{};
+	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	mappedRange.memory = nodeTransforms.allocation.memory;
+	mappedRange.offset = rangeBegin;
+	mappedRange.size = rangeEnd - rangeBegin;
+	VK_CHECK_RESULT(vkFlushMappedMemoryRanges(device->logicalDevice, 1, &mappedRange));
+}
+
+/*
+	Selects the copy of the per frame buffers (node transforms, indirect transforms and compute skinning joints) that host writes go to
+	and draws read from, call with the application's frame in flight index before updating the model for that frame
+	The copy was last written frameCount frames ago, so the current uniform blocks are written into it
+*/
+void vkglTF::Model::setFrameIndex(uint32_t frameIndex)
+{
+	this->frameIndex = frameIndex % frameCount;
+	unsigned char* mapped = static_cast<unsigned char*>(nodeTransforms.allocation.mapped);
+	const VkDeviceSize frameOffset = this->frameIndex * nodeTransforms.frameSize;
+	for (Node* node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		Mesh::UniformBuffer& uniformBuffer = node->mesh->uniformBuffer;
+		uniformBuffer.dynamicOffset = static_cast<uint32_t>(frameOffset + uniformBuffer.slotOffset);
+		uniformBuffer.mapped = mapped + uniformBuffer.dynamicOffset;
+		// Only the joint matrices of vertex shader skinning change besides the node matrix
+		if (node->skin && !node->skin->computeSkinning) {
+			memcpy(uniformBuffer.mapped, &node->mesh->uniformBlock, sizeof(Mesh::UniformBlock));
+		}
+		else {
+			memcpy(uniformBuffer.mapped, &node->mesh->uniformBlock.matrix, sizeof(glm::mat4));
+		}
+		uniformBuffer.dirty = true;
+	}
+	indirect.dynamicOffset = static_cast<uint32_t>(this->frameIndex * indirect.transformsFrameSize);
+	updateIndirectTransforms();
+}
+
+/*
+	Bindless materials need the descriptor indexing features to have been enabled at device creation, see Model::Bindless
+*/
+bool vkglTF::Model::supportsBindlessMaterials(const vks::VulkanDevice* device)
+{
+	const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& features = device->enabledDescriptorIndexingFeatures;
+	return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound && features.descriptorBindingVariableDescriptorCount && features.shaderSampledImageArrayNonUniformIndexing;
+}
+
+/*
+	Size of the texture array of descriptorSetLayoutBindless, the set layout has to fit the per stage and per set limits
+*/
+uint32_t vkglTF::Model::getMaxBindlessTextures(const vks::VulkanDevice* device)
+{
+	const VkPhysicalDeviceLimits& limits = device->properties.limits;
+	return std::min({ maxBindlessTextures, limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+}
@@ -17,10 +17,12 @@
 #include <stdlib.h>
 #include <string>
 #include <fstream>
+#include <memory>
 #include <vector>
 
 #include "vulkan/vulkan.h"
 #include "vkdevice.h"
+#include "vkgltfoptimize.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -45,8 +47,17 @@ namespace vkglTF
 
 	extern VkDescriptorSetLayout descriptorSetLayoutImage;
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
+	extern VkDescriptorSetLayout descriptorSetLayoutIndirect;
+	extern VkDescriptorSetLayout descriptorSetLayoutBindless;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
+	/** @brief Push constant range the material index of bindless draws is written to, must be part of the pipeline layout passed to draw() */
+	extern uint32_t bindlessPushConstantOffset;
+	extern VkShaderStageFlags bindlessPushConstantStages;
+	/** @brief Copies of the buffers the host writes every frame that models are created with, set to the application's frames in flight before loading */
+	extern uint32_t framesInFlight;
+	/** @brief Upper bound of the texture array of descriptorSetLayoutBindless, further limited by the device */
+	const uint32_t maxBindlessTextures = 4096;
 
 	struct Node;
 
@@ -57,15 +68,31 @@ namespace vkglTF
 		vks::VulkanDevice* device = nullptr;
 		VkImage image;
 		VkImageLayout imageLayout;
-		VkDeviceMemory deviceMemory;
+		vks::Allocation allocation;
 		VkImageView view;
 		uint32_t width, height;
 		uint32_t mipLevels;
 		uint32_t layerCount;
 		VkDescriptorImageInfo descriptor;
 		VkSampler sampler;
+		/** @brief Image data decoded on the CPU, kept from decode() until upload() */
+		struct Source {
+			std::vector<unsigned char> pixels;
+			ktxTexture* ktx = nullptr;
+			/** @brief Complete chain of tightly packed RGBA levels, points into a mapped model cache */
+			const unsigned char* mipChain = nullptr;
+			size_t mipChainSize = 0;
+			~Source() {
+				if (ktx) {
+					ktxTexture_Destroy(ktx);
+				}
+			}
+		};
+		std::shared_ptr<Source> source;
 		void updateDescriptor();
 		void destroy();
+		void decode(tinygltf::Image& gltfimage, std::string path);
+		void upload(vks::VulkanDevice* device, VkQueue copyQueue);
 		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
 	};
 
@@ -77,6 +104,8 @@ namespace vkglTF
 		enum AlphaMode { ALPHAMODE_OPAQUE, ALPHAMODE_MASK, ALPHAMODE_BLEND };
 		AlphaMode alphaMode = ALPHAMODE_OPAQUE;
 		float alphaCutoff = 1.0f;
+		/** @brief Back faces are visible, so culling by normal cones doesn't apply */
+		bool doubleSided = false;
 		float metallicFactor = 1.0f;
 		float roughnessFactor = 1.0f;
 		glm::vec4 baseColorFactor = glm::vec4(1.0f);
@@ -103,8 +132,21 @@ namespace vkglTF
 		uint32_t indexCount;
 		uint32_t firstVertex;
 		uint32_t vertexCount;
+		/** @brief Range of the primitive's meshlets in Model::meshlets, only built with FileLoadingFlags::BuildMeshlets */
+		uint32_t firstMeshlet = 0;
+		uint32_t meshletCount = 0;
 		Material& material;
 
+		/** @brief Index range of a level of detail, all levels share the primitive's vertices */
+		struct Lod {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			/** @brief Largest distance the simplification moved the surface by, in the primitive's local units */
+			float error;
+		};
+		/** @brief Full resolution first, then coarser levels, only built with FileLoadingFlags::GenerateLods */
+		std::vector<Lod> lods;
+
 		struct Dimensions {
 			glm::vec3 min = glm::vec3(FLT_MAX);
 			glm::vec3 max = glm::vec3(-FLT_MAX);
@@ -114,6 +156,7 @@ namespace vkglTF
 		} dimensions;
 
 		void setDimensions(glm::vec3 min, glm::vec3 max);
+		uint32_t selectLod(const glm::mat4& matrix, const glm::vec3& cameraPosition, float projectionScale, float threshold) const;
 		Primitive(uint32_t firstIndex, uint32_t indexCount, Material& material) : firstIndex(firstIndex), indexCount(indexCount), material(material) {};
 	};
 
@@ -126,12 +169,18 @@ namespace vkglTF
 		std::vector<Primitive*> primitives;
 		std::string name;
 
+		/** @brief The mesh's slot in Model::nodeTransforms */
 		struct UniformBuffer {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-			VkDescriptorBufferInfo descriptor;
+			/** @brief Byte offset of the slot in the current frame's copy, the dynamic offset to bind descriptorSet with */
+			uint32_t dynamicOffset = 0;
+			/** @brief Byte offset of the slot within a frame's copy */
+			uint32_t slotOffset = 0;
+			VkDescriptorBufferInfo descriptor{};
+			/** @brief The model's single node transform set, shared by all meshes */
 			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-			void* mapped;
+			void* mapped = nullptr;
+			/** @brief Written since the last Model::flushNodeTransforms() */
+			bool dirty = false;
 		} uniformBuffer;
 
 		struct UniformBlock {
@@ -141,7 +190,6 @@ namespace vkglTF
 		} uniformBlock;
 
 		Mesh(vks::VulkanDevice* device, glm::mat4 matrix);
-		~Mesh();
 	};
 
 	/*
@@ -152,6 +200,8 @@ namespace vkglTF
 		Node* skeletonRoot = nullptr;
 		std::vector<glm::mat4> inverseBindMatrices;
 		std::vector<Node*> joints;
+		/** @brief Skinned by a SkinningPass (see vkgltfskinning.h), mesh uniform blocks then carry no joint matrices */
+		bool computeSkinning = false;
 	};
 
 	/*
@@ -169,9 +219,17 @@ namespace vkglTF
 		glm::vec3 translation{};
 		glm::vec3 scale{ 1.0f };
 		glm::quat rotation{};
+		/** @brief World matrix as of the last update() or updateMatrices() */
+		glm::mat4 worldMatrix{ 1.0f };
+		/** @brief Set when translation, rotation or scale change, so updateMatrices() recomputes the node and its subtree */
+		bool dirty = true;
+		/** @brief Whether the last updateMatrices() changed worldMatrix */
+		bool matrixChanged = false;
 		glm::mat4 localMatrix();
 		glm::mat4 getMatrix();
 		void update();
+		void updateMatrices(bool parentChanged);
+		void uploadMatrices();
 		~Node();
 	};
 
@@ -192,7 +250,15 @@ namespace vkglTF
 		enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
 		InterpolationType interpolation;
 		std::vector<float> inputs;
+		/** @brief One value per key, cubic spline samplers store in-tangent, value and out-tangent of each key */
 		std::vector<glm::vec4> outputsVec4;
+		/** @brief Key interval of the last lookup, playback usually stays in it or moves on to the next one */
+		size_t cursor = 0;
+		bool valid() const;
+		size_t findKey(float time, size_t& cursor) const;
+		/** @brief Value at time, clamped to the first and last key, rotations are interpolated as normalized quaternions */
+		glm::vec4 sample(float time, bool rotation, size_t& cursor) const;
+		glm::vec4 sample(float time, bool rotation);
 	};
 
 	/*
@@ -229,19 +295,141 @@ namespace vkglTF
 		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
 	};
 
+	enum VertexQuantizationFlags {
+		/** @brief Normals and tangents as snorm16 */
+		QuantizeNormals = 0x00000001,
+		/** @brief Texture coordinates as half floats */
+		QuantizeUVs = 0x00000002,
+		/** @brief Colors as unorm8 */
+		QuantizeColors = 0x00000004,
+		/** @brief Joint indices as uint8 and weights as unorm8, the shader has to declare the joint input as uvec4. Models with skins of more than 255 joints fail to load with it */
+		QuantizeSkin = 0x00000008
+	};
+
+	/*
+		Vertex layout a model's vertex buffer is stored in
+		Only the listed components are stored, in the order of the list, optionally quantized to the formats
+		selected by VertexQuantizationFlags. The default layout is the one of vkglTF::Vertex.
+	*/
+	struct VertexLayout {
+		std::vector<VertexComponent> components;
+		uint32_t quantization = 0;
+		uint32_t stride = 0;
+		/** @brief Byte offset of each component in a vertex, indexed by VertexComponent */
+		uint32_t offsets[7] = {};
+
+		VertexLayout();
+		VertexLayout(const std::vector<VertexComponent> components, uint32_t quantization = 0);
+		bool has(VertexComponent component) const;
+		/** @brief True if the layout matches vkglTF::Vertex */
+		bool isDefault() const;
+		/** @brief Key identifying the component list, used to match baked caches to the layout they have been written for */
+		uint32_t componentKey() const;
+		VkFormat format(VertexComponent component) const;
+		void pack(const Vertex& vertex, unsigned char* dst) const;
+		VkVertexInputBindingDescription inputBindingDescription(uint32_t binding) const;
+		VkVertexInputAttributeDescription inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component) const;
+		/** @brief Attribute descriptions for all components of the layout, at consecutive locations in the layout's order */
+		std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding) const;
+		/** @brief Attribute descriptions for a subset of the layout's components, at consecutive locations in the requested order */
+		std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components) const;
+		/** @brief Returns the pipeline vertex input state create info structure for the layout, valid as long as the layout isn't changed */
+		VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState();
+		VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
+	private:
+		VkVertexInputBindingDescription vertexInputBindingDescription{};
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions;
+		VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo{};
+	};
+
 	enum FileLoadingFlags {
 		None = 0x00000000,
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		/** @brief Neither load from nor write a baked cache file (see vkgltfcache.h) */
+		DontUseCache = 0x00000010,
+		/** @brief Reorder triangles and vertices of triangle lists for the vertex cache, overdraw and vertex fetch (see vkgltfoptimize.h), and print the cache statistics */
+		OptimizeMeshes = 0x00000020,
+		/** @brief Create the draw command and draw data buffers for Model::drawIndirect, if the device has drawIndirectFirstInstance enabled */
+		IndirectDraw = 0x00000040,
+		/** @brief Split triangle lists into meshlets (see vkgltfoptimize.h), indirect drawing then draws and culls each meshlet on its own */
+		BuildMeshlets = 0x00000080,
+		/** @brief Build simplified index ranges of triangle lists (see vkgltfoptimize.h), selected by Model::setLodView() and the culling pass */
+		GenerateLods = 0x00000100,
+		/** @brief Skin in a compute pass instead of the vertex shader (see vkgltfskinning.h), the vertex buffer can then be read by shaders and copied */
+		ComputeSkinning = 0x00000200,
+		/** @brief Put all materials and textures into one descriptor set (see Model::Bindless), if the device has descriptor indexing enabled */
+		BindlessMaterials = 0x00000400
 	};
 
 	enum RenderFlags {
 		BindImages = 0x00000001,
 		RenderOpaqueNodes = 0x00000002,
 		RenderAlphaMaskedNodes = 0x00000004,
-		RenderAlphaBlendedNodes = 0x00000008
+		RenderAlphaBlendedNodes = 0x00000008,
+		/** @brief Bind the node transform set of each mesh node at its dynamic offset (see Model::nodeTransforms) */
+		BindNodeTransforms = 0x00000010
+	};
+
+	/*
+		Per draw data of indirect drawing
+		Shaders read it from the draw data storage buffer at gl_InstanceIndex, as every draw command's firstInstance is its own index
+	*/
+	struct IndirectDrawData {
+		/** @brief Index into the transforms storage buffer */
+		uint32_t transformIndex;
+		/** @brief Index into the materials storage buffer and into Model::materials */
+		uint32_t materialIndex;
+		uint32_t padding[2];
+	};
+
+	/*
+		Material parameters of indirect drawing (std430 layout)
+	*/
+	struct IndirectMaterial {
+		glm::vec4 baseColorFactor;
+		float metallicFactor;
+		float roughnessFactor;
+		float alphaCutoff;
+		/** @brief Index into Model::textures, -1 if the material has no base color texture (or only the empty texture) */
+		int32_t baseColorTexture;
+		/** @brief Index into Model::textures, -1 if the material has no normal map (or only the empty texture) */
+		int32_t normalTexture;
+		uint32_t padding[3];
+	};
+
+	/*
+		Bounding box of an indirect draw in the space of its node (std430 layout), read by the culling pass
+	*/
+	struct IndirectBounds {
+		glm::vec3 center;
+		/** @brief Index into the transforms storage buffer */
+		uint32_t transformIndex;
+		glm::vec3 extents;
+		/** @brief Model::Indirect::Group of the draw */
+		uint32_t group;
+		/** @brief Normal cone of meshlets (see optimize::Meshlet), draws the cone never culls have a cutoff of 1 */
+		glm::vec3 coneAxis;
+		float coneCutoff;
+		/** @brief Range of the draw's levels of detail in the lods buffer, a count of 0 or 1 always draws the command as it is */
+		uint32_t firstLod;
+		uint32_t lodCount;
+		/** @brief Bounding sphere radius the errors of the levels of detail are relative to */
+		float radius;
+		uint32_t padding;
+	};
+
+	/*
+		Level of detail of an indirect draw (std430 layout), the culling pass writes the range it selects into the draw command
+	*/
+	struct IndirectLod {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		/** @brief See Primitive::Lod::error */
+		float error;
+		uint32_t padding;
 	};
 
 	/*
@@ -252,19 +440,100 @@ namespace vkglTF
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		/** @brief Parsed file and converted geometry, kept from parseFile() until upload() */
+		struct LoadState {
+			/** @brief Part of the vertex or index buffer, either stored in the GPU layout in the file data or converted to the CPU buffer */
+			struct CopyRange {
+				/** @brief Source in the parsed file data, nullptr if the range has been converted */
+				const unsigned char* fileData;
+				/** @brief Byte offset into the CPU buffer of converted ranges */
+				size_t srcOffset;
+				size_t size;
+			};
+			tinygltf::Model gltfModel;
+			/** @brief Converted indices in the model's index type, only holds the ranges that couldn't be copied from the file as stored */
+			std::vector<unsigned char> indexBuffer;
+			/** @brief Converted vertices packed in the model's vertex layout, likewise only the ranges that couldn't be copied as stored */
+			std::vector<unsigned char> vertexBuffer;
+			/** @brief Ranges in the order they are laid out in the index and vertex buffers */
+			std::vector<CopyRange> indexRanges;
+			std::vector<CopyRange> vertexRanges;
+			uint32_t indexCount = 0;
+			uint32_t vertexCount = 0;
+			/** @brief Number of elements reserved in the CPU buffers for converted ranges */
+			uint32_t convertedIndexCount = 0;
+			uint32_t convertedVertexCount = 0;
+			/** @brief Slice of a primitive whose vertices or indices have to be converted, along with the places reserved for them */
+			struct PrimitiveDecode {
+				const tinygltf::Primitive* primitive;
+				Node* node;
+				Primitive* target;
+				/** @brief First vertex and index of the primitive in the CPU buffers, notConverted if the data is copied from the file as stored */
+				size_t vertexOffset;
+				size_t indexOffset;
+				/** @brief Range of the primitive's vertices and indices converted by this slice */
+				uint32_t begin;
+				uint32_t end;
+				/** @brief Run the mesh optimization, such primitives are converted as a single slice */
+				bool optimize;
+				optimize::CacheStats statsBefore;
+				optimize::CacheStats statsAfter;
+				/** @brief Split the primitive into meshlets, such primitives are converted as a single slice as well */
+				bool buildMeshlets;
+				std::vector<optimize::Meshlet> meshlets;
+				/** @brief Simplify the primitive into levels of detail, such primitives are converted as a single slice as well */
+				bool generateLods;
+				/** @brief Indices of all coarser levels, appended to the index buffer by finishDecode() */
+				std::vector<uint32_t> lodIndices;
+			};
+			static const size_t notConverted = SIZE_MAX;
+			/** @brief Number of vertices or indices a primitive slice and (roughly) a batch converts */
+			static const uint32_t geometryBatchSize = 64 * 1024;
+			std::vector<PrimitiveDecode> primitiveDecodes;
+			/** @brief First slice of each batch converted by decodeGeometry() */
+			std::vector<uint32_t> geometryBatches;
+			uint32_t fileLoadingFlags = FileLoadingFlags::None;
+			float scale = 1.0f;
+			std::string filename;
+			/** @brief Size and modification time of the source file, a cache with the same stamp is used without hashing the file */
+			uint64_t sourceSize = 0;
+			int64_t sourceWriteTime = 0;
+			/** @brief Hash of the source file's content, keys the baked cache, only computed once the stamps differ or a cache is written */
+			uint64_t sourceHash = 0;
+			bool sourceHashed = false;
+			/** @brief Mapped cache file the model is loaded from, file data of the copy ranges points into it */
+			vks::tools::MappedFile cache;
+			bool fromCache = false;
+			static void gatherRanges(const std::vector<CopyRange>& ranges, const void* converted, void* dst);
+		};
+		std::unique_ptr<LoadState> loadState;
+		void decodePrimitive(LoadState::PrimitiveDecode& decode);
+		void prepareIndirect(VkQueue transferQueue);
+		std::vector<IndirectMaterial> getMaterialTable() const;
+		void createNodeTransforms();
+		void uploadBuffer(VkQueue transferQueue, VkBufferUsageFlags usageFlags, const void* data, VkDeviceSize size, vks::Buffer& buffer, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
+		bool readCache(const std::string& sourceFilename);
+		void writeCache(const std::string& sourceFilename);
 	public:
-		vks::VulkanDevice* device;
-		VkDescriptorPool descriptorPool;
+		vks::VulkanDevice* device = nullptr;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		/** @brief Layout of the vertex buffer, pipelines drawing the model take their vertex input state from it */
+		VertexLayout vertexLayout;
 
 		struct Vertices {
 			int count;
-			VkBuffer buffer;
-			VkDeviceMemory memory;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			vks::Allocation allocation;
 		} vertices;
 		struct Indices {
 			int count;
-			VkBuffer buffer;
-			VkDeviceMemory memory;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			vks::Allocation allocation;
+			/** @brief 16 bit if every primitive addresses at most 65536 vertices, indices are relative to the primitive's first vertex either way */
+			VkIndexType type = VK_INDEX_TYPE_UINT32;
+			uint32_t stride() const {
+				return type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+			}
 		} indices;
 
 		std::vector<Node*> nodes;
@@ -275,6 +544,8 @@ namespace vkglTF
 		std::vector<Texture> textures;
 		std::vector<Material> materials;
 		std::vector<Animation> animations;
+		/** @brief Meshlets of all primitives, see Primitive::firstMeshlet */
+		std::vector<optimize::Meshlet> meshlets;
 
 		struct Dimensions {
 			glm::vec3 min = glm::vec3(FLT_MAX);
@@ -284,26 +555,131 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		/*
+			Uniform blocks of all mesh nodes in one persistently mapped buffer, instead of a buffer and a descriptor set per mesh
+			Each mesh node has a Mesh::UniformBlock sized slot at Mesh::uniformBuffer.dynamicOffset. descriptorSetLayoutUbo holds a
+			dynamic uniform buffer, so the single descriptor set serves every node when bound with the node's offset, which draw() does with RenderFlags::BindNodeTransforms.
+			The buffer holds a copy of all slots per frame in flight, setFrameIndex() moves the offsets to the current frame's copy.
+		*/
+		struct NodeTransforms {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			vks::Allocation allocation;
+			/** @brief Size of a slot, rounded up to the device's uniform buffer offset alignment */
+			VkDeviceSize slotSize = 0;
+			/** @brief Size of a frame's copy of all slots */
+			VkDeviceSize frameSize = 0;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			/** @brief Host writes to non-coherent memory have to be flushed by flushNodeTransforms() */
+			bool coherent = true;
+		} nodeTransforms;
+
+		/** @brief Ticket of the transfer batch that uploads the model's buffers and textures, wait on it before reading them on another queue or on the host */
+		vks::TransferTicket uploadTicket;
+
+		/*
+			Indirect drawing, only prepared for models loaded with FileLoadingFlags::IndirectDraw
+			All primitives are flattened into one draw command each, grouped by alpha mode, so drawIndirect() records
+			at most one draw call per alpha mode no matter how many nodes and primitives the model has
+			Set layout of descriptorSetLayoutIndirect: binding 0 draw data, binding 1 transforms (dynamic, bound at dynamicOffset), binding 2 materials
+			(all storage buffers)
+		*/
+		struct Indirect {
+			enum Group { Opaque, Mask, Blend, GroupCount };
+			/** @brief VkDrawIndexedIndirectCommand per primitive */
+			vks::Buffer commands;
+			/** @brief Unculled copy of the draw commands, the culling pass rewrites commands and counts from it */
+			vks::Buffer sourceCommands;
+			/** @brief IndirectBounds per primitive */
+			vks::Buffer bounds;
+			/** @brief IndirectLod per level of detail of all draws, see IndirectBounds::firstLod */
+			vks::Buffer lods;
+			/** @brief Number of draw commands of each group, read by the count variant of the draw calls */
+			vks::Buffer counts;
+			/** @brief IndirectDrawData per primitive */
+			vks::Buffer drawData;
+			/** @brief Node matrix per mesh node for each frame in flight, host visible and updated by updateIndirectTransforms() */
+			vks::Buffer transforms;
+			/** @brief Size of a frame's matrices, rounded up to the device's storage buffer offset alignment */
+			VkDeviceSize transformsFrameSize = 0;
+			/** @brief Byte offset of the current frame's matrices, the dynamic offset to bind descriptorSet with */
+			uint32_t dynamicOffset = 0;
+			/** @brief IndirectMaterial per material */
+			vks::Buffer materials;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			uint32_t firstDraw[GroupCount] = {};
+			uint32_t drawCount[GroupCount] = {};
+			/** @brief Mesh nodes in the order of the transforms buffer */
+			std::vector<Node*> transformNodes;
+			/** @brief Only set if the device has VK_KHR_draw_indirect_count or the Vulkan 1.2 drawIndirectCount feature enabled */
+			PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
+			bool prepared = false;
+		} indirect;
+
+		/*
+			Bindless materials, only prepared for models loaded with FileLoadingFlags::BindlessMaterials on devices that have enabled
+			runtimeDescriptorArray, descriptorBindingPartiallyBound, descriptorBindingVariableDescriptorCount and
+			shaderSampledImageArrayNonUniformIndexing, otherwise the model falls back to the per material descriptor sets
+			Set layout of descriptorSetLayoutBindless: binding 0 materials (storage buffer), binding 1 all textures of the model
+			(variable count combined image sampler array), shaders index the array with nonuniformEXT
+			With RenderFlags::BindImages, draw() binds the set once and drawNode() pushes the material index of each primitive
+			to bindlessPushConstantOffset instead of binding per material sets, so draws can be reordered freely
+			drawIndirect() binds the set after the indirect one, draws find their material through IndirectDrawData::materialIndex
+		*/
+		struct Bindless {
+			/** @brief IndirectMaterial per material, with indices into the texture array */
+			vks::Buffer materials;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			bool prepared = false;
+		} bindless;
+
+		/** @brief Camera drawNode() and draw() select levels of detail for, disabled until setLodView() is called */
+		struct LodView {
+			bool enabled = false;
+			glm::vec3 cameraPosition;
+			/** @brief Pixels per unit at a distance of one unit from the camera */
+			float projectionScale;
+			/** @brief Largest projected error in pixels a coarser level may have */
+			float threshold = 1.0f;
+		} lodView;
+
 		bool metallicRoughnessWorkflow = true;
 		bool buffersBound = false;
+		/** @brief Copies of the per frame buffers, vkglTF::framesInFlight at the time the model has been loaded */
+		uint32_t frameCount = 1;
+		/** @brief Copy the host writes to and draws read from, see setFrameIndex() */
+		uint32_t frameIndex = 0;
 		std::string path;
 
 		Model() {};
 		~Model();
-		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
+		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, float globalscale);
 		void loadSkins(tinygltf::Model& gltfModel);
-		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
-		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
+		bool loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f, const VertexLayout& vertexLayout = VertexLayout(), std::string* error = nullptr);
+		bool parseFile(std::string filename, vks::VulkanDevice* device, uint32_t fileLoadingFlags, float scale, const VertexLayout& vertexLayout, std::string* error);
+		void decodeImage(uint32_t index);
+		void decodeScene();
+		uint32_t getGeometryBatchCount() const;
+		void decodeGeometry(uint32_t batch);
+		void finishDecode();
+		void upload(VkQueue transferQueue);
+		VkDeviceSize getPendingUploadSize() const;
 		void bindBuffers(VkCommandBuffer commandBuffer);
-		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
-		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t bindNodeSet = 2);
+		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t bindNodeSet = 2);
+		void drawIndirect(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindSet = 0);
+		void updateIndirectTransforms();
+		void flushNodeTransforms();
+		void setFrameIndex(uint32_t frameIndex);
+		void setLodView(const glm::mat4& view, const glm::mat4& projection, float viewportHeight, float threshold = 1.0f);
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
 		void prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout);
+		static bool supportsBindlessMaterials(const vks::VulkanDevice* device);
+		static uint32_t getMaxBindlessTextures(const vks::VulkanDevice* device);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,203 @@
+/*
+* Vulkan glTF instance animation
+*
+* Evaluates the node hierarchy of many independently animated instances of one glTF model
+*
+* Copyright (C)
+*
+*/
+
+#include "vkgltfanimation.h"
+
+#include <algorithm>
+#include <cassert>
+
+/*
+	Flattens the model's hierarchy into slots and sets up instanceCount instances in the rest pose
+	The model must not gain or lose nodes or animations while the animator is in use
+*/
+void vkglTF::InstanceAnimator::prepare(Model* model, uint32_t instanceCount)
+{
+	this->model = model;
+
+	// Breadth first from the roots, so every parent's slot comes before the slots of its children
+	slotNodes.assign(model->nodes.begin(), model->nodes.end());
+	for (size_t i = 0; i < slotNodes.size(); i++) {
+		slotNodes.insert(slotNodes.end(), slotNodes[i]->children.begin(), slotNodes[i]->children.end());
+	}
+	slotCount = static_cast<uint32_t>(slotNodes.size());
+	slots.clear();
+	for (uint32_t slot = 0; slot < slotCount; slot++) {
+		slots[slotNodes[slot]] = slot;
+	}
+
+	parents.resize(slotCount);
+	restPose.resize(slotCount * PoseComponentCount);
+	matrixSlots.clear();
+	for (uint32_t slot = 0; slot < slotCount; slot++) {
+		const Node* node = slotNodes[slot];
+		parents[slot] = node->parent ? static_cast<int32_t>(slots[node->parent]) : -1;
+		const float values[PoseComponentCount] = {
+			node->translation.x, node->translation.y, node->translation.z,
+			node->rotation.x, node->rotation.y, node->rotation.z, node->rotation.w,
+			node->scale.x, node->scale.y, node->scale.z
+		};
+		for (uint32_t component = 0; component < PoseComponentCount; component++) {
+			restPose[component * slotCount + slot] = values[component];
+		}
+		if (node->matrix != glm::mat4(1.0f)) {
+			matrixSlots.push_back(slot);
+		}
+	}
+
+	channels.clear();
+	cursorOffsets.clear();
+	cursorsPerInstance = 0;
+	for (const Animation& animation : model->animations) {
+		std::vector<Channel> animationChannels;
+		for (const AnimationChannel& channel : animation.channels) {
+			if (animation.samplers[channel.samplerIndex].valid()) {
+				animationChannels.push_back({ slots[channel.node], channel.samplerIndex, channel.path });
+			}
+		}
+		channels.push_back(std::move(animationChannels));
+		cursorOffsets.push_back(cursorsPerInstance);
+		cursorsPerInstance += animation.samplers.size();
+	}
+
+	instances.assign(instanceCount, Instance());
+	poses.resize(static_cast<size_t>(instanceCount) * slotCount * PoseComponentCount);
+	cursors.assign(static_cast<size_t>(instanceCount) * cursorsPerInstance, 0);
+	matrices.resize(static_cast<size_t>(instanceCount) * slotCount);
+}
+
+void vkglTF::InstanceAnimator::setAnimation(uint32_t instance, int32_t animation, float time)
+{
+	assert(instance < instances.size());
+	assert(animation < static_cast<int32_t>(channels.size()));
+	instances[instance].animation = animation;
+	instances[instance].time = time;
+}
+
+void vkglTF::InstanceAnimator::update(vks::ThreadPool* pool)
+{
+	const uint32_t instanceCount = getInstanceCount();
+	if (!pool || (instanceCount <= instancesPerJob)) {
+		for (uint32_t instance = 0; instance < instanceCount; instance++) {
+			updateInstance(instance);
+		}
+		return;
+	}
+	// The pool may be shared, so only the jobs of this update are waited for
+	vks::JobGroup group;
+	for (uint32_t first = 0; first < instanceCount; first += instancesPerJob) {
+		const uint32_t last = std::min(first + instancesPerJob, instanceCount);
+		pool->push([this, first, last]() {
+			for (uint32_t instance = first; instance < last; instance++) {
+				updateInstance(instance);
+			}
+		}, group);
+	}
+	group.wait();
+}
+
+void vkglTF::InstanceAnimator::updateInstance(uint32_t instance)
+{
+	float* pose = &poses[static_cast<size_t>(instance) * slotCount * PoseComponentCount];
+	glm::mat4* world = &matrices[static_cast<size_t>(instance) * slotCount];
+
+	// Sample the animation on top of the rest pose
+	std::copy(restPose.begin(), restPose.end(), pose);
+	const Instance& state = instances[instance];
+	if (state.animation >= 0) {
+		const Animation& animation = model->animations[state.animation];
+		size_t* instanceCursors = &cursors[instance * cursorsPerInstance + cursorOffsets[state.animation]];
+		for (const Channel& channel : channels[state.animation]) {
+			const bool rotation = (channel.path == AnimationChannel::PathType::ROTATION);
+			const glm::vec4 value = animation.samplers[channel.sampler].sample(state.time, rotation, instanceCursors[channel.sampler]);
+			const uint32_t first = rotation ? RotationX : (channel.path == AnimationChannel::PathType::SCALE) ? ScaleX : TranslationX;
+			const uint32_t count = rotation ? 4 : 3;
+			for (uint32_t component = 0; component < count; component++) {
+				pose[(first + component) * slotCount + channel.slot] = value[component];
+			}
+		}
+	}
+
+	// Local matrices, translation * rotation * scale like Node::localMatrix()
+	const float* tx = pose + TranslationX * slotCount;
+	const float* ty = pose + TranslationY * slotCount;
+	const float* tz = pose + TranslationZ * slotCount;
+	const float* qx = pose + RotationX * slotCount;
+	const float* qy = pose + RotationY * slotCount;
+	const float* qz = pose + RotationZ * slotCount;
+	const float* qw = pose + RotationW * slotCount;
+	const float* sx = pose + ScaleX * slotCount;
+	const float* sy = pose + ScaleY * slotCount;
+	const float* sz = pose + ScaleZ * slotCount;
+	float* local = &world[0][0][0];
+	for (uint32_t slot = 0; slot < slotCount; slot++) {
+		const float xx = qx[slot] * qx[slot], yy = qy[slot] * qy[slot], zz = qz[slot] * qz[slot];
+		const float xy = qx[slot] * qy[slot], xz = qx[slot] * qz[slot], yz = qy[slot] * qz[slot];
+		const float wx = qw[slot] * qx[slot], wy = qw[slot] * qy[slot], wz = qw[slot] * qz[slot];
+		float* m = local + slot * 16;
+		m[0] = (1.0f - 2.0f * (yy + zz)) * sx[slot];
+		m[1] = 2.0f * (xy + wz) * sx[slot];
+		m[2] = 2.0f * (xz - wy) * sx[slot];
+		m[3] = 0.0f;
+		m[4] = 2.0f * (xy - wz) * sy[slot];
+		m[5] = (1.0f - 2.0f * (xx + zz)) * sy[slot];
+		m[6] = 2.0f * (yz + wx) * sy[slot];
+		m[7] = 0.0f;
+		m[8] = 2.0f * (xz + wy) * sz[slot];
+		m[9] = 2.0f * (yz - wx) * sz[slot];
+		m[10] = (1.0f - 2.0f * (xx + yy)) * sz[slot];
+		m[11] = 0.0f;
+		m[12] = tx[slot];
+		m[13] = ty[slot];
+		m[14] = tz[slot];
+		m[15] = 1.0f;
+	}
+	for (uint32_t slot : matrixSlots) {
+		world[slot] = world[slot] * slotNodes[slot]->matrix;
+	}
+
+	// World matrices, parents have been transformed already
+	for (uint32_t slot = 0; slot < slotCount; slot++) {
+		if (parents[slot] >= 0) {
+			world[slot] = world[parents[slot]] * world[slot];
+		}
+	}
+}
+
+uint32_t vkglTF::InstanceAnimator::getInstanceCount() const
+{
+	return static_cast<uint32_t>(instances.size());
+}
+
+uint32_t vkglTF::InstanceAnimator::getSlotCount() const
+{
+	return slotCount;
+}
+
+uint32_t vkglTF::InstanceAnimator::getSlot(const Node* node) const
+{
+	auto it = slots.find(node);
+	assert(it != slots.end());
+	return it->second;
+}
+
+const glm::mat4* vkglTF::InstanceAnimator::worldMatrices(uint32_t instance) const
+{
+	return &matrices[static_cast<size_t>(instance) * slotCount];
+}
+
+void vkglTF::InstanceAnimator::getJointMatrices(uint32_t instance, const Node* meshNode, glm::mat4* jointMatrices) const
+{
+	assert(meshNode->skin);
+	const glm::mat4* world = worldMatrices(instance);
+	const Skin* skin = meshNode->skin;
+	const glm::mat4 inverseTransform = glm::inverse(world[getSlot(meshNode)]);
+	for (size_t i = 0; i < skin->joints.size(); i++) {
+		jointMatrices[i] = inverseTransform * world[getSlot(skin->joints[i])] * skin->inverseBindMatrices[i];
+	}
+}
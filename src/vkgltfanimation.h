@@ -0,0 +1,89 @@
+/*
+* Vulkan glTF instance animation
+*
+* Evaluates the node hierarchy of many independently animated instances of one glTF model
+*
+* Copyright (C)
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vkgltf.h"
+#include "vkthreadpool.h"
+
+namespace vkglTF
+{
+	/*
+		Batched animation of model instances
+
+		The model's nodes are flattened into slots ordered parents first. Every instance keeps the translation, rotation and
+		scale of all slots in structure of arrays layout, along with its own sampler cursors, so update() evaluates an instance
+		in three linear passes without following a single node pointer:
+			Sample the channels of the instance's animation into its pose
+			Build all local matrices from the pose arrays in one branch free loop the compiler can vectorize
+			Multiply each local matrix by the world matrix of its parent, which the parents first order has already computed
+		The model's nodes and uniform buffers are not touched, the results are read with worldMatrices() and getJointMatrices().
+	*/
+	class InstanceAnimator {
+	public:
+		void prepare(Model* model, uint32_t instanceCount);
+		/** @brief Animation -1 keeps the instance in the model's rest pose */
+		void setAnimation(uint32_t instance, int32_t animation, float time);
+		/** @brief Evaluates all instances, spread over the pool's workers if one is passed */
+		void update(vks::ThreadPool* pool = nullptr);
+
+		uint32_t getInstanceCount() const;
+		uint32_t getSlotCount() const;
+		/** @brief Slot of a node of the model in the arrays worldMatrices() returns */
+		uint32_t getSlot(const Node* node) const;
+		/** @brief World matrix of every slot of an instance, as of the last update() */
+		const glm::mat4* worldMatrices(uint32_t instance) const;
+		/** @brief Skinning matrices of a skinned mesh node, relative to the mesh node like Mesh::UniformBlock::jointMatrix */
+		void getJointMatrices(uint32_t instance, const Node* meshNode, glm::mat4* jointMatrices) const;
+
+	private:
+		/** @brief Arrays of the pose, each one holds a value per slot */
+		enum PoseComponent { TranslationX, TranslationY, TranslationZ, RotationX, RotationY, RotationZ, RotationW, ScaleX, ScaleY, ScaleZ, PoseComponentCount };
+		struct Channel {
+			uint32_t slot;
+			uint32_t sampler;
+			AnimationChannel::PathType path;
+		};
+		struct Instance {
+			int32_t animation = -1;
+			float time = 0.0f;
+		};
+		/** @brief Instances evaluated by one job of the thread pool */
+		static const uint32_t instancesPerJob = 16;
+
+		Model* model = nullptr;
+		uint32_t slotCount = 0;
+		std::vector<Instance> instances;
+		std::vector<Node*> slotNodes;
+		std::unordered_map<const Node*, uint32_t> slots;
+		/** @brief Slot of each slot's parent, -1 for roots, always lower than the slot itself */
+		std::vector<int32_t> parents;
+		/** @brief Pose every instance starts from before its channels are applied */
+		std::vector<float> restPose;
+		/** @brief Slots whose node has a matrix besides its translation, rotation and scale */
+		std::vector<uint32_t> matrixSlots;
+		/** @brief Channels of every animation, with slots instead of nodes */
+		std::vector<std::vector<Channel>> channels;
+		/** @brief First cursor of each animation within an instance's cursors */
+		std::vector<size_t> cursorOffsets;
+		size_t cursorsPerInstance = 0;
+		/** @brief Per instance arrays, one block of slotCount (times the component count) entries after the other */
+		std::vector<float> poses;
+		std::vector<size_t> cursors;
+		std::vector<glm::mat4> matrices;
+
+		void updateInstance(uint32_t instance);
+	};
+}
@@ -0,0 +1,569 @@
+/*
+* Vulkan glTF model cache
+*
+* Binary file format for models that have already been converted to their final GPU layout
+*
+* Copyright (C)
+*
+*/
+
+#include "vkgltfcache.h"
+
+#include <atomic>
+#include <filesystem>
+#include <random>
+#include <unordered_map>
+
+#include "vkgltf.h"
+
+/*
+	Cache file helpers
+*/
+
+std::string vkglTF::cache::filename(const std::string& sourceFilename)
+{
+	return sourceFilename + ".vkcache";
+}
+
+/*
+	64 bit FNV-1a over whole words, with the tail folded in byte by byte
+*/
+uint64_t vkglTF::cache::hash(const unsigned char* data, size_t size)
+{
+	const uint64_t prime = 0x100000001b3ull;
+	uint64_t value = 0xcbf29ce484222325ull;
+	size_t pos = 0;
+	for (; pos + sizeof(uint64_t) <= size; pos += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data + pos, sizeof(word));
+		value = (value ^ word) * prime;
+	}
+	for (; pos < size; pos++) {
+		value = (value ^ data[pos]) * prime;
+	}
+	return value;
+}
+
+/*
+	Hashes a whole file through a mapping, false if it can't be opened
+*/
+bool vkglTF::cache::hashFile(const std::string& filename, uint64_t& value)
+{
+	vks::tools::MappedFile file;
+	if (!file.open(filename)) {
+		return false;
+	}
+	value = hash(file.data(), file.size());
+	return true;
+}
+
+/*
+	Size and modification time of a file the source model references, false if it doesn't exist
+*/
+bool vkglTF::cache::fileStamp(const std::string& filename, uint64_t& size, int64_t& writeTime)
+{
+	std::error_code error;
+	size = static_cast<uint64_t>(std::filesystem::file_size(filename, error));
+	if (error) {
+		return false;
+	}
+	writeTime = static_cast<int64_t>(std::filesystem::last_write_time(filename, error).time_since_epoch().count());
+	return !error;
+}
+
+/*
+	Updates the source modification time stored in a cache file whose source has been touched without changing its content,
+	so later loads don't have to hash the source again. Failing to do so only costs that hash
+*/
+void vkglTF::cache::restamp(const std::string& cacheFilename, int64_t sourceWriteTime)
+{
+	std::fstream file(cacheFilename, std::ios::binary | std::ios::in | std::ios::out);
+	if (!file.is_open()) {
+		return;
+	}
+	file.seekp(offsetof(Header, sourceWriteTime));
+	file.write(reinterpret_cast<const char*>(&sourceWriteTime), sizeof(sourceWriteTime));
+}
+
+/*
+	Loading flags that change the baked data, flags that only create GPU side resources from it don't key the cache
+*/
+uint32_t vkglTF::cache::keyFlags(uint32_t fileLoadingFlags)
+{
+	const uint32_t ignored = FileLoadingFlags::DontUseCache | FileLoadingFlags::IndirectDraw | FileLoadingFlags::ComputeSkinning | FileLoadingFlags::BindlessMaterials;
+	return fileLoadingFlags & ~ignored;
+}
+
+/*
+	Bytes taken by a chain of tightly packed RGBA8 levels
+*/
+size_t vkglTF::cache::mipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	size_t size = 0;
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		size += static_cast<size_t>(std::max(1u, width >> i)) * std::max(1u, height >> i) * 4;
+	}
+	return size;
+}
+
+/*
+	Builds the mip chain of an RGBA8 image on the CPU with a box filter, replacing the blits done on the GPU at load time
+*/
+void vkglTF::cache::generateMipChain(const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t mipLevels, std::vector<unsigned char>& chain)
+{
+	chain.resize(mipChainSize(width, height, mipLevels));
+	memcpy(chain.data(), pixels, static_cast<size_t>(width) * height * 4);
+	size_t srcOffset = 0;
+	size_t dstOffset = static_cast<size_t>(width) * height * 4;
+	uint32_t srcWidth = width;
+	uint32_t srcHeight = height;
+	for (uint32_t level = 1; level < mipLevels; level++) {
+		const uint32_t dstWidth = std::max(1u, srcWidth >> 1);
+		const uint32_t dstHeight = std::max(1u, srcHeight >> 1);
+		const unsigned char* src = chain.data() + srcOffset;
+		unsigned char* dst = chain.data() + dstOffset;
+		for (uint32_t y = 0; y < dstHeight; y++) {
+			const uint32_t y0 = std::min(y * 2, srcHeight - 1);
+			const uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				const uint32_t x0 = std::min(x * 2, srcWidth - 1);
+				const uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+				for (uint32_t c = 0; c < 4; c++) {
+					const uint32_t sum = src[(y0 * srcWidth + x0) * 4 + c] + src[(y0 * srcWidth + x1) * 4 + c] + src[(y1 * srcWidth + x0) * 4 + c] + src[(y1 * srcWidth + x1) * 4 + c];
+					dst[(y * dstWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+		srcOffset = dstOffset;
+		dstOffset += static_cast<size_t>(dstWidth) * dstHeight * 4;
+		srcWidth = dstWidth;
+		srcHeight = dstHeight;
+	}
+}
+
+/*
+	Builds the model from a fresh cache file, the vertex, index and texture data stay in the mapping until upload()
+	Returns false without touching the model if there is no cache or it doesn't match the source
+*/
+bool vkglTF::Model::readCache(const std::string& sourceFilename)
+{
+	LoadState& state = *loadState;
+	if (!state.cache.open(cache::filename(sourceFilename))) {
+		return false;
+	}
+	const unsigned char* base = state.cache.data();
+	const size_t fileSize = state.cache.size();
+
+	cache::Header header{};
+	bool valid = fileSize >= sizeof(header);
+	if (valid) {
+		memcpy(&header, base, sizeof(header));
+		const VkIndexType indexType = static_cast<VkIndexType>(header.indexType);
+		const uint64_t indexStride = (indexType == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+		// Written so that neither the sums nor the products can wrap around for a damaged header
+		auto inFile = [fileSize](uint64_t offset, uint64_t count, uint64_t elementSize) {
+			return (offset <= fileSize) && (count <= (fileSize - offset) / elementSize);
+		};
+		valid = (memcmp(header.magic, cache::magic, sizeof(cache::magic)) == 0) &&
+			(header.version == cache::version) &&
+			(header.vertexStride == vertexLayout.stride) &&
+			(header.vertexComponents == vertexLayout.componentKey()) &&
+			(header.vertexQuantization == vertexLayout.quantization) &&
+			(header.fileLoadingFlags == cache::keyFlags(state.fileLoadingFlags)) &&
+			(header.scale == state.scale) &&
+			(header.sourceSize == state.sourceSize) &&
+			inFile(header.sceneOffset, header.sceneSize, 1) &&
+			inFile(header.vertexOffset, header.vertexCount, vertexLayout.stride) &&
+			((indexType == VK_INDEX_TYPE_UINT16) || (indexType == VK_INDEX_TYPE_UINT32)) &&
+			inFile(header.indexOffset, header.indexCount, indexStride) &&
+			inFile(header.textureOffset, header.textureSize, 1);
+	}
+	// A file that has been touched without changing its size is compared by content
+	const bool touched = valid && (header.sourceWriteTime != state.sourceWriteTime);
+	if (touched) {
+		if (!state.sourceHashed) {
+			state.sourceHashed = cache::hashFile(sourceFilename, state.sourceHash);
+		}
+		valid = state.sourceHashed && (header.sourceHash == state.sourceHash);
+	}
+
+	cache::Reader reader(base + header.sceneOffset, valid ? static_cast<size_t>(header.sceneSize) : 0);
+
+	// External buffers and images of the source file
+	const uint32_t dependencyCount = reader.get<uint32_t>();
+	for (uint32_t i = 0; (i < dependencyCount) && valid && reader.ok; i++) {
+		const std::string uri = reader.getString();
+		const uint64_t size = reader.get<uint64_t>();
+		const int64_t writeTime = reader.get<int64_t>();
+		uint64_t currentSize;
+		int64_t currentWriteTime;
+		valid = cache::fileStamp(path + "/" + uri, currentSize, currentWriteTime) && (currentSize == size) && (currentWriteTime == writeTime);
+	}
+	if (!valid || !reader.ok) {
+		state.cache.close();
+		return false;
+	}
+
+	bool workflow = reader.get<uint32_t>() != 0;
+
+	// Textures, with their mip chains left in the mapping
+	const uint32_t textureCount = reader.get<uint32_t>();
+	if (!reader.ok || (textureCount > header.sceneSize / (3 * sizeof(uint32_t) + 2 * sizeof(uint64_t)))) {
+		state.cache.close();
+		return false;
+	}
+	std::vector<Texture> cachedTextures(textureCount);
+	for (Texture& texture : cachedTextures) {
+		texture.width = reader.get<uint32_t>();
+		texture.height = reader.get<uint32_t>();
+		texture.mipLevels = reader.get<uint32_t>();
+		const uint64_t offset = reader.get<uint64_t>();
+		const uint64_t size = reader.get<uint64_t>();
+		valid = valid && (offset <= header.textureSize) && (size <= header.textureSize - offset) && (size == cache::mipChainSize(texture.width, texture.height, texture.mipLevels));
+		texture.source = std::make_shared<Texture::Source>();
+		texture.source->mipChain = base + header.textureOffset + offset;
+		texture.source->mipChainSize = static_cast<size_t>(size);
+	}
+	if (!valid || !reader.ok) {
+		state.cache.close();
+		return false;
+	}
+	// Materials point at the textures, so they have to be in place first
+	textures = std::move(cachedTextures);
+
+	// Materials
+	auto resolveTexture = [&](int32_t ref) -> vkglTF::Texture* {
+		if (ref == cache::EmptyTexture) {
+			return &emptyTexture;
+		}
+		if ((ref >= 0) && (ref < static_cast<int32_t>(textures.size()))) {
+			return &textures[ref];
+		}
+		valid = valid && (ref == cache::NoTexture);
+		return nullptr;
+	};
+	const uint32_t materialCount = reader.get<uint32_t>();
+	for (uint32_t i = 0; (i < materialCount) && reader.ok; i++) {
+		Material material(device);
+		material.alphaMode = static_cast<Material::AlphaMode>(reader.get<uint32_t>());
+		material.alphaCutoff = reader.get<float>();
+		material.doubleSided = reader.get<uint32_t>() != 0;
+		material.metallicFactor = reader.get<float>();
+		material.roughnessFactor = reader.get<float>();
+		material.baseColorFactor = reader.get<glm::vec4>();
+		material.baseColorTexture = resolveTexture(reader.get<int32_t>());
+		material.metallicRoughnessTexture = resolveTexture(reader.get<int32_t>());
+		material.normalTexture = resolveTexture(reader.get<int32_t>());
+		material.occlusionTexture = resolveTexture(reader.get<int32_t>());
+		material.emissiveTexture = resolveTexture(reader.get<int32_t>());
+		materials.push_back(material);
+	}
+	valid = valid && reader.ok && !materials.empty();
+
+	// Nodes in the order of linearNodes, which lists children before their parents
+	const uint32_t nodeCount = valid ? reader.get<uint32_t>() : 0;
+	std::vector<int32_t> parents;
+	for (uint32_t i = 0; (i < nodeCount) && valid && reader.ok; i++) {
+		Node* node = new Node{};
+		linearNodes.push_back(node);
+		node->index = reader.get<uint32_t>();
+		parents.push_back(reader.get<int32_t>());
+		node->name = reader.getString();
+		node->skinIndex = reader.get<int32_t>();
+		node->translation = reader.get<glm::vec3>();
+		node->scale = reader.get<glm::vec3>();
+		node->rotation = reader.get<glm::quat>();
+		node->matrix = reader.get<glm::mat4>();
+		if (reader.get<uint32_t>() != 0) {
+			node->mesh = new Mesh(device, node->matrix);
+			node->mesh->name = reader.getString();
+			const uint32_t primitiveCount = reader.get<uint32_t>();
+			for (uint32_t j = 0; (j < primitiveCount) && reader.ok; j++) {
+				const uint32_t firstIndex = reader.get<uint32_t>();
+				const uint32_t indexCount = reader.get<uint32_t>();
+				const uint32_t firstVertex = reader.get<uint32_t>();
+				const uint32_t vertexCount = reader.get<uint32_t>();
+				const int32_t materialIndex = reader.get<int32_t>();
+				const glm::vec3 min = reader.get<glm::vec3>();
+				const glm::vec3 max = reader.get<glm::vec3>();
+				const uint32_t meshletCount = reader.get<uint32_t>();
+				const uint32_t lodCount = reader.get<uint32_t>();
+				valid = valid && (lodCount <= optimize::maxLodCount) && (materialIndex >= 0) && (materialIndex < static_cast<int32_t>(materials.size())) &&
+					(static_cast<uint64_t>(firstIndex) + indexCount <= header.indexCount) && (static_cast<uint64_t>(firstVertex) + vertexCount <= header.vertexCount) &&
+					(meshletCount <= indexCount / 3);
+				if (!valid) {
+					break;
+				}
+				Primitive* primitive = new Primitive(firstIndex, indexCount, materials[materialIndex]);
+				primitive->firstVertex = firstVertex;
+				primitive->vertexCount = vertexCount;
+				primitive->setDimensions(min, max);
+				primitive->firstMeshlet = static_cast<uint32_t>(meshlets.size());
+				primitive->meshletCount = meshletCount;
+				node->mesh->primitives.push_back(primitive);
+				for (uint32_t k = 0; (k < meshletCount) && reader.ok; k++) {
+					const optimize::Meshlet meshlet = reader.get<optimize::Meshlet>();
+					valid = valid && (static_cast<uint64_t>(meshlet.firstIndex) + meshlet.indexCount <= indexCount);
+					meshlets.push_back(meshlet);
+				}
+				primitive->lods.resize(lodCount);
+				for (Primitive::Lod& lod : primitive->lods) {
+					lod = reader.get<Primitive::Lod>();
+					valid = valid && (static_cast<uint64_t>(lod.firstIndex) + lod.indexCount <= header.indexCount);
+				}
+			}
+		}
+		// Parents come after their children
+		valid = valid && (parents.back() == -1 || ((parents.back() > static_cast<int32_t>(i)) && (parents.back() < static_cast<int32_t>(nodeCount))));
+	}
+	valid = valid && reader.ok;
+
+	if (!valid) {
+		// Nothing has been linked yet, so every node only owns its mesh
+		for (Node* node : linearNodes) {
+			delete node;
+		}
+		linearNodes.clear();
+		materials.clear();
+		meshlets.clear();
+		textures.clear();
+		state.cache.close();
+		return false;
+	}
+
+	for (size_t i = 0; i < linearNodes.size(); i++) {
+		Node* node = linearNodes[i];
+		if (parents[i] == -1) {
+			nodes.push_back(node);
+		}
+		else {
+			node->parent = linearNodes[parents[i]];
+			node->parent->children.push_back(node);
+		}
+	}
+	metallicRoughnessWorkflow = workflow;
+
+	// Vertex and index data are copied from the mapping into the staging ring by upload()
+	state.vertexRanges.push_back({ base + header.vertexOffset, 0, static_cast<size_t>(header.vertexCount * vertexLayout.stride) });
+	indices.type = static_cast<VkIndexType>(header.indexType);
+	state.indexRanges.push_back({ base + header.indexOffset, 0, static_cast<size_t>(header.indexCount * indices.stride()) });
+	state.vertexCount = static_cast<uint32_t>(header.vertexCount);
+	state.indexCount = static_cast<uint32_t>(header.indexCount);
+	state.fromCache = true;
+
+	// Initial pose
+	createNodeTransforms();
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			node->update();
+		}
+	}
+	getSceneDimensions();
+
+	// The content matched, so the stamp is refreshed for the next load
+	if (touched) {
+		cache::restamp(cache::filename(sourceFilename), state.sourceWriteTime);
+	}
+	return true;
+}
+
+/*
+	Bakes the decoded model into a cache file next to the source file
+	Models with animations, skins or ktx textures are not cached, failing to write the file only costs the next load the full decode
+*/
+void vkglTF::Model::writeCache(const std::string& sourceFilename)
+{
+	LoadState& state = *loadState;
+	const tinygltf::Model& gltfModel = state.gltfModel;
+
+	// Animations and skins reference nodes by pointer and aren't part of the format
+	if (!animations.empty() || !skins.empty()) {
+		return;
+	}
+	for (const Texture& texture : textures) {
+		if (!texture.source || texture.source->ktx || texture.source->pixels.empty()) {
+			return;
+		}
+	}
+
+	// The source file is only hashed on load if the stamp of an existing cache doesn't match
+	if (!state.sourceHashed) {
+		state.sourceHashed = cache::hashFile(sourceFilename, state.sourceHash);
+		if (!state.sourceHashed) {
+			return;
+		}
+	}
+
+	cache::Writer scene;
+
+	// External buffers and images, a cache is stale once any of them changes
+	std::vector<std::string> dependencies;
+	for (const tinygltf::Buffer& buffer : gltfModel.buffers) {
+		if (!buffer.uri.empty() && !tinygltf::IsDataURI(buffer.uri)) {
+			dependencies.push_back(buffer.uri);
+		}
+	}
+	for (const tinygltf::Image& image : gltfModel.images) {
+		if (!image.uri.empty() && !tinygltf::IsDataURI(image.uri)) {
+			dependencies.push_back(image.uri);
+		}
+	}
+	scene.put(static_cast<uint32_t>(dependencies.size()));
+	for (const std::string& uri : dependencies) {
+		uint64_t size;
+		int64_t writeTime;
+		if (!cache::fileStamp(path + "/" + uri, size, writeTime)) {
+			return;
+		}
+		scene.putString(uri);
+		scene.put(size);
+		scene.put(writeTime);
+	}
+
+	scene.put<uint32_t>(metallicRoughnessWorkflow ? 1 : 0);
+
+	// Textures, their mip chains are placed one after another behind the index data
+	uint64_t textureDataSize = 0;
+	scene.put(static_cast<uint32_t>(textures.size()));
+	for (const Texture& texture : textures) {
+		const uint64_t size = cache::mipChainSize(texture.width, texture.height, texture.mipLevels);
+		scene.put(texture.width);
+		scene.put(texture.height);
+		scene.put(texture.mipLevels);
+		scene.put(textureDataSize);
+		scene.put(size);
+		textureDataSize = (textureDataSize + size + cache::blobAlignment - 1) & ~(uint64_t)(cache::blobAlignment - 1);
+	}
+
+	// Materials
+	auto textureRef = [&](const vkglTF::Texture* texture) -> int32_t {
+		if (!texture) {
+			return cache::NoTexture;
+		}
+		if (texture == &emptyTexture) {
+			return cache::EmptyTexture;
+		}
+		return static_cast<int32_t>(texture - textures.data());
+	};
+	scene.put(static_cast<uint32_t>(materials.size()));
+	for (const Material& material : materials) {
+		scene.put(static_cast<uint32_t>(material.alphaMode));
+		scene.put(material.alphaCutoff);
+		scene.put<uint32_t>(material.doubleSided ? 1 : 0);
+		scene.put(material.metallicFactor);
+		scene.put(material.roughnessFactor);
+		scene.put(material.baseColorFactor);
+		scene.put(textureRef(material.baseColorTexture));
+		scene.put(textureRef(material.metallicRoughnessTexture));
+		scene.put(textureRef(material.normalTexture));
+		scene.put(textureRef(material.occlusionTexture));
+		scene.put(textureRef(material.emissiveTexture));
+	}
+
+	// Nodes
+	std::unordered_map<const Node*, int32_t> nodeIndices;
+	for (size_t i = 0; i < linearNodes.size(); i++) {
+		nodeIndices[linearNodes[i]] = static_cast<int32_t>(i);
+	}
+	scene.put(static_cast<uint32_t>(linearNodes.size()));
+	for (const Node* node : linearNodes) {
+		scene.put(node->index);
+		scene.put(node->parent ? nodeIndices[node->parent] : -1);
+		scene.putString(node->name);
+		scene.put(node->skinIndex);
+		scene.put(node->translation);
+		scene.put(node->scale);
+		scene.put(node->rotation);
+		scene.put(node->matrix);
+		scene.put<uint32_t>(node->mesh ? 1 : 0);
+		if (node->mesh) {
+			scene.putString(node->mesh->name);
+			scene.put(static_cast<uint32_t>(node->mesh->primitives.size()));
+			for (const Primitive* primitive : node->mesh->primitives) {
+				scene.put(primitive->firstIndex);
+				scene.put(primitive->indexCount);
+				scene.put(primitive->firstVertex);
+				scene.put(primitive->vertexCount);
+				scene.put(static_cast<int32_t>(&primitive->material - materials.data()));
+				scene.put(primitive->dimensions.min);
+				scene.put(primitive->dimensions.max);
+				scene.put(primitive->meshletCount);
+				for (uint32_t k = 0; k < primitive->meshletCount; k++) {
+					scene.put(meshlets[primitive->firstMeshlet + k]);
+				}
+				scene.put(static_cast<uint32_t>(primitive->lods.size()));
+				for (const Primitive::Lod& lod : primitive->lods) {
+					scene.put(lod);
+				}
+			}
+		}
+	}
+
+	auto align = [](uint64_t offset) {
+		return (offset + cache::blobAlignment - 1) & ~(uint64_t)(cache::blobAlignment - 1);
+	};
+	cache::Header header{};
+	memcpy(header.magic, cache::magic, sizeof(cache::magic));
+	header.version = cache::version;
+	header.vertexStride = vertexLayout.stride;
+	header.vertexComponents = vertexLayout.componentKey();
+	header.vertexQuantization = vertexLayout.quantization;
+	header.fileLoadingFlags = cache::keyFlags(state.fileLoadingFlags);
+	header.scale = state.scale;
+	header.sourceSize = state.sourceSize;
+	header.sourceWriteTime = state.sourceWriteTime;
+	header.sourceHash = state.sourceHash;
+	header.sceneOffset = sizeof(header);
+	header.sceneSize = scene.data.size();
+	header.vertexOffset = align(header.sceneOffset + header.sceneSize);
+	header.vertexCount = state.vertexCount;
+	header.indexOffset = align(header.vertexOffset + header.vertexCount * vertexLayout.stride);
+	header.indexCount = state.indexCount;
+	header.indexType = static_cast<uint32_t>(indices.type);
+	header.textureOffset = align(header.indexOffset + header.indexCount * indices.stride());
+	header.textureSize = textureDataSize;
+
+	// Written to a temporary file first, so a load never maps a partially written cache
+	const std::string cacheFilename = cache::filename(sourceFilename);
+	// The name is unique to the writer, loads of the same model in other threads or processes may write a cache at the same time
+	static std::atomic<uint32_t> tempCounter{ 0 };
+	const std::string tempFilename = cacheFilename + "." + std::to_string(std::random_device{}()) + "." + std::to_string(tempCounter++) + ".tmp";
+	std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		return;
+	}
+	const char zeros[cache::blobAlignment] = {};
+	auto pad = [&](uint64_t offset) {
+		file.write(zeros, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+	};
+	auto writeRanges = [&](const std::vector<LoadState::CopyRange>& ranges, const void* converted) {
+		for (const LoadState::CopyRange& range : ranges) {
+			const unsigned char* src = range.fileData ? range.fileData : static_cast<const unsigned char*>(converted) + range.srcOffset;
+			file.write(reinterpret_cast<const char*>(src), static_cast<std::streamsize>(range.size));
+		}
+	};
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(scene.data.data()), static_cast<std::streamsize>(scene.data.size()));
+	pad(header.vertexOffset);
+	writeRanges(state.vertexRanges, state.vertexBuffer.data());
+	pad(header.indexOffset);
+	writeRanges(state.indexRanges, state.indexBuffer.data());
+	std::vector<unsigned char> chain;
+	for (const Texture& texture : textures) {
+		pad(align(static_cast<uint64_t>(file.tellp())));
+		cache::generateMipChain(texture.source->pixels.data(), texture.width, texture.height, texture.mipLevels, chain);
+		file.write(reinterpret_cast<const char*>(chain.data()), static_cast<std::streamsize>(chain.size()));
+	}
+	file.close();
+
+	std::error_code error;
+	if (file.fail()) {
+		std::filesystem::remove(tempFilename, error);
+		return;
+	}
+	std::filesystem::rename(tempFilename, cacheFilename, error);
+	if (error) {
+		std::filesystem::remove(tempFilename, error);
+	}
+}
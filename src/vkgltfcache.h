@@ -0,0 +1,129 @@
+/*
+* Vulkan glTF model cache
+*
+* Binary file format for models that have already been converted to their final GPU layout
+*
+* Copyright (C)
+*
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace vkglTF
+{
+	/*
+		Baked model cache
+
+		A cache file is written next to a glTF file the first time it is loaded and holds everything vkglTF::Model
+		builds from it: the final vertex and index buffers, the node hierarchy with its meshes, primitives with their meshlets and levels of detail, the
+		materials and the textures with their complete mip chains. Later loads map the cache file and copy the blobs
+		straight from the mapping into the staging ring, so neither the glTF file nor any image has to be parsed.
+
+		Layout (all blobs 16 byte aligned):
+			Header | scene description | vertex data | index data | texture levels
+
+		A cache is only used if it has been written for the same source file content, the same loading flags that change
+		the baked data (see keyFlags) and scale, and the same vertex layout and quantization. The source file is only hashed
+		if its size matches but its modification time doesn't, and the stored time is refreshed if the content still matches. External buffers and images the source file references are
+		checked by size and modification time.
+	*/
+	namespace cache
+	{
+		/** @brief Bump whenever the file layout, vkglTF::Vertex or the way models are built changes */
+		const uint32_t version = 5;
+		const char magic[8] = { 'V', 'K', 'G', 'L', 'T', 'F', 'C', '\0' };
+		const size_t blobAlignment = 16;
+
+		struct Header {
+			char magic[8];
+			uint32_t version;
+			uint32_t vertexStride;
+			/** @brief vkglTF::VertexLayout the vertex data has been packed in */
+			uint32_t vertexComponents;
+			uint32_t vertexQuantization;
+			/** @brief Loading flags masked by keyFlags() */
+			uint32_t fileLoadingFlags;
+			float scale;
+			uint64_t sourceSize;
+			int64_t sourceWriteTime;
+			uint64_t sourceHash;
+			uint64_t sceneOffset;
+			uint64_t sceneSize;
+			uint64_t vertexOffset;
+			uint64_t vertexCount;
+			uint64_t indexOffset;
+			uint64_t indexCount;
+			/** @brief VkIndexType of the index data */
+			uint32_t indexType;
+			/** @brief Start of the texture levels, texture entries in the scene description are relative to this */
+			uint64_t textureOffset;
+			uint64_t textureSize;
+		};
+
+		/** @brief Texture reference of a material that isn't one of the model's textures */
+		enum TextureRef : int32_t {
+			NoTexture = -1,
+			EmptyTexture = -2
+		};
+
+		/** @brief Appends plain values to the scene description */
+		struct Writer {
+			std::vector<unsigned char> data;
+			template <typename T> void put(const T& value)
+			{
+				const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+				data.insert(data.end(), bytes, bytes + sizeof(T));
+			}
+			void putString(const std::string& value)
+			{
+				put(static_cast<uint32_t>(value.size()));
+				data.insert(data.end(), value.begin(), value.end());
+			}
+		};
+
+		/** @brief Reads plain values from a mapped scene description, fails instead of reading past its end */
+		struct Reader {
+			const unsigned char* data;
+			size_t size;
+			size_t pos = 0;
+			bool ok = true;
+			Reader(const unsigned char* data, size_t size) : data(data), size(size) {};
+			template <typename T> T get()
+			{
+				T value{};
+				if (!ok || (size - pos < sizeof(T))) {
+					ok = false;
+					return value;
+				}
+				memcpy(&value, data + pos, sizeof(T));
+				pos += sizeof(T);
+				return value;
+			}
+			std::string getString()
+			{
+				const uint32_t length = get<uint32_t>();
+				if (!ok || (size - pos < length)) {
+					ok = false;
+					return std::string();
+				}
+				std::string value(reinterpret_cast<const char*>(data + pos), length);
+				pos += length;
+				return value;
+			}
+		};
+
+		std::string filename(const std::string& sourceFilename);
+		uint64_t hash(const unsigned char* data, size_t size);
+		bool hashFile(const std::string& filename, uint64_t& value);
+		bool fileStamp(const std::string& filename, uint64_t& size, int64_t& writeTime);
+		void restamp(const std::string& cacheFilename, int64_t sourceWriteTime);
+		uint32_t keyFlags(uint32_t fileLoadingFlags);
+		size_t mipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels);
+		void generateMipChain(const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t mipLevels, std::vector<unsigned char>& chain);
+	}
+}
@@ -0,0 +1,333 @@
+/*
+* Vulkan glTF GPU culling
+*
+* Frustum and occlusion culling of the indirect draws of glTF models in a compute pass
+*
+* Copyright (C)
+*
+*/
+
+#include "vkgltfculling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	VkPipeline createComputePipeline(VkDevice device, VkPipelineLayout layout, const std::string& fileName)
+	{
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
+		shaderStage.pName = "main";
+		assert(shaderStage.module != VK_NULL_HANDLE);
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(layout);
+		pipelineCI.stage = shaderStage;
+		VkPipeline pipeline;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+		vkDestroyShaderModule(device, shaderStage.module, nullptr);
+		return pipeline;
+	}
+
+	/*
+		The transforms are written by the host every frame and have a copy per frame in flight, selected by the dynamic offset
+	*/
+	VkDescriptorType modelSetType(uint32_t binding)
+	{
+		return (binding == 2) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	}
+}
+
+/*
+	Creates the pipelines of both passes, and a 1x1 depth pyramid that doesn't occlude anything until a depth source is set
+*/
+void vkglTF::CullingPass::prepare(vks::VulkanDevice* device, const std::string& shadersPath, uint32_t maxModels)
+{
+	this->device = device;
+	this->maxModels = maxModels;
+
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxModels * 5),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, maxModels),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + maxPyramidLevels),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxPyramidLevels),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxModels + 1 + maxPyramidLevels);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+	// Culling: source commands, bounds, transforms (of the model's current frame), output commands, counts, levels of detail
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings;
+	for (uint32_t binding = 0; binding < 6; binding++) {
+		setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(modelSetType(binding), VK_SHADER_STAGE_COMPUTE_BIT, binding));
+	}
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &modelSetLayout));
+	setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+	};
+	descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &pyramidSetLayout));
+	const VkDescriptorSetLayout cullSetLayouts[2] = { modelSetLayout, pyramidSetLayout };
+	VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(cullSetLayouts, 2);
+	pipelineLayoutCI.pushConstantRangeCount = 1;
+	pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &cullPipelineLayout));
+	cullPipeline = createComputePipeline(device->logicalDevice, cullPipelineLayout, shadersPath + "culling/cull.comp.spv");
+
+	// Depth reduction: level below (or the depth buffer), level to write
+	setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+	};
+	descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &reduceSetLayout));
+	pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&reduceSetLayout, 1);
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &reducePipelineLayout));
+	reducePipeline = createComputePipeline(device->logicalDevice, reducePipelineLayout, shadersPath + "culling/depthreduce.comp.spv");
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &pyramidSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &pyramidSet));
+	std::vector<VkDescriptorSetLayout> reduceSetLayouts(maxPyramidLevels, reduceSetLayout);
+	reduceSets.resize(maxPyramidLevels);
+	descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, reduceSetLayouts.data(), maxPyramidLevels);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, reduceSets.data()));
+
+	createDepthPyramid(2, 2);
+}
+
+void vkglTF::CullingPass::destroy()
+{
+	if (!device) {
+		return;
+	}
+	destroyDepthPyramid();
+	vkDestroyPipeline(device->logicalDevice, cullPipeline, nullptr);
+	vkDestroyPipeline(device->logicalDevice, reducePipeline, nullptr);
+	vkDestroyPipelineLayout(device->logicalDevice, cullPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device->logicalDevice, reducePipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device->logicalDevice, modelSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device->logicalDevice, pyramidSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device->logicalDevice, reduceSetLayout, nullptr);
+	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+	modelSets.clear();
+	reduceSets.clear();
+	device = nullptr;
+}
+
+/*
+	Sets the depth buffer the pyramid is built from, has to be called again if the depth buffer is recreated (e.g. on resize)
+	The view has to be a depth only view of an image created with VK_IMAGE_USAGE_SAMPLED_BIT, in depthLayout when buildDepthPyramid() is recorded
+	@note Rewrites descriptor sets, so the GPU must not be using the pass (i.e. call it after waiting for the device to be idle)
+*/
+void vkglTF::CullingPass::setDepthSource(VkImageView depthView, VkImageLayout depthLayout, uint32_t width, uint32_t height)
+{
+	this->depthView = depthView;
+	this->depthLayout = depthLayout;
+	depthWidth = width;
+	depthHeight = height;
+	createDepthPyramid(width, height);
+}
+
+void vkglTF::CullingPass::createDepthPyramid(uint32_t width, uint32_t height)
+{
+	destroyDepthPyramid();
+
+	// Each level covers 2x2 texels of the level below, odd sizes round up so no texel of the depth buffer is left out
+	depthPyramid.width = std::max((width + 1) / 2, 1u);
+	depthPyramid.height = std::max((height + 1) / 2, 1u);
+	uint32_t levelCount = 1;
+	for (uint32_t size = std::max(depthPyramid.width, depthPyramid.height); size > 1; size = (size + 1) / 2) {
+		levelCount++;
+	}
+	assert(levelCount <= maxPyramidLevels);
+
+	VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+	imageCI.imageType = VK_IMAGE_TYPE_2D;
+	imageCI.format = VK_FORMAT_R32_SFLOAT;
+	imageCI.extent = { depthPyramid.width, depthPyramid.height, 1 };
+	imageCI.mipLevels = levelCount;
+	imageCI.arrayLayers = 1;
+	imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &depthPyramid.image));
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(device->logicalDevice, depthPyramid.image, &memReqs);
+	VK_CHECK_RESULT(device->allocateMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vks::AllocationType::Optimal, &depthPyramid.allocation));
+	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, depthPyramid.image, depthPyramid.allocation.memory, depthPyramid.allocation.offset));
+
+	VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+	viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCI.format = VK_FORMAT_R32_SFLOAT;
+	viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+	viewCI.image = depthPyramid.image;
+	VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &depthPyramid.view));
+	depthPyramid.levelViews.resize(levelCount);
+	for (uint32_t level = 0; level < levelCount; level++) {
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &depthPyramid.levelViews[level]));
+	}
+
+	// Texels are only ever fetched, filtering and addressing don't matter
+	VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+	samplerCI.magFilter = VK_FILTER_NEAREST;
+	samplerCI.minFilter = VK_FILTER_NEAREST;
+	samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.maxLod = static_cast<float>(levelCount);
+	VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &depthPyramid.sampler));
+
+	// The pyramid stays in the general layout, starting out at the far plane so nothing is occluded before the first build
+	VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+	VkCommandBuffer copyCmd = device->transfer.getCommandBuffer(device->graphicsQueue);
+	vks::tools::setImageLayout(copyCmd, depthPyramid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+	VkClearColorValue farPlane = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+	vkCmdClearColorImage(copyCmd, depthPyramid.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &farPlane, 1, &subresourceRange);
+	device->finishImageUpload(device->graphicsQueue, depthPyramid.image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	VkDescriptorImageInfo pyramidDescriptor = vks::initializers::descriptorImageInfo(depthPyramid.sampler, depthPyramid.view, VK_IMAGE_LAYOUT_GENERAL);
+	VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(pyramidSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &pyramidDescriptor);
+	vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+
+	if (depthView == VK_NULL_HANDLE) {
+		return;
+	}
+	for (uint32_t level = 0; level < levelCount; level++) {
+		VkDescriptorImageInfo srcDescriptor = (level == 0) ? vks::initializers::descriptorImageInfo(depthPyramid.sampler, depthView, depthLayout) : vks::initializers::descriptorImageInfo(depthPyramid.sampler, depthPyramid.levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+		VkDescriptorImageInfo dstDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, depthPyramid.levelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(reduceSets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &srcDescriptor),
+			vks::initializers::writeDescriptorSet(reduceSets[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &dstDescriptor),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+}
+
+void vkglTF::CullingPass::destroyDepthPyramid()
+{
+	for (VkImageView view : depthPyramid.levelViews) {
+		vkDestroyImageView(device->logicalDevice, view, nullptr);
+	}
+	depthPyramid.levelViews.clear();
+	if (depthPyramid.view != VK_NULL_HANDLE) {
+		vkDestroyImageView(device->logicalDevice, depthPyramid.view, nullptr);
+		vkDestroySampler(device->logicalDevice, depthPyramid.sampler, nullptr);
+		vkDestroyImage(device->logicalDevice, depthPyramid.image, nullptr);
+		depthPyramid.allocation.free();
+	}
+	depthPyramid.view = VK_NULL_HANDLE;
+	depthPyramid.sampler = VK_NULL_HANDLE;
+	depthPyramid.image = VK_NULL_HANDLE;
+}
+
+/*
+	Reduces the depth buffer into the pyramid, record after the pass that writes the depth and before the next frame's cull()
+	The next frame tests against this depth, so objects that were hidden in this frame stay culled for one frame after they appear
+*/
+void vkglTF::CullingPass::buildDepthPyramid(VkCommandBuffer commandBuffer)
+{
+	if (depthView == VK_NULL_HANDLE) {
+		return;
+	}
+	// Depth writes of the frame and reads of the pyramid by earlier culling have to be done before the reduction
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipeline);
+	uint32_t width = depthPyramid.width;
+	uint32_t height = depthPyramid.height;
+	for (uint32_t level = 0; level < depthPyramid.levelViews.size(); level++) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipelineLayout, 0, 1, &reduceSets[level], 0, nullptr);
+		vkCmdDispatch(commandBuffer, (width + 7) / 8, (height + 7) / 8, 1);
+		// Each level is read by the next step, the last one by the culling shader
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		width = std::max((width + 1) / 2, 1u);
+		height = std::max((height + 1) / 2, 1u);
+	}
+}
+
+VkDescriptorSet vkglTF::CullingPass::getModelSet(const Model& model)
+{
+	auto it = modelSets.find(&model);
+	if (it != modelSets.end()) {
+		return it->second;
+	}
+	assert(modelSets.size() < maxModels);
+	VkDescriptorSet descriptorSet;
+	VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &modelSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
+	VkDescriptorBufferInfo bufferDescriptors[6] = {
+		model.indirect.sourceCommands.descriptor,
+		model.indirect.bounds.descriptor,
+		model.indirect.transforms.descriptor,
+		model.indirect.commands.descriptor,
+		model.indirect.counts.descriptor,
+		model.indirect.lods.descriptor,
+	};
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+	for (uint32_t binding = 0; binding < 6; binding++) {
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSet, modelSetType(binding), binding, &bufferDescriptors[binding]));
+	}
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	modelSets[&model] = descriptorSet;
+	return descriptorSet;
+}
+
+/*
+	Culls the draws of a model against the given camera, record before the render pass that calls Model::drawIndirect()
+	view and projection are usually camera.matrices.view and camera.matrices.perspective
+	Levels of detail are selected for a viewport of viewportHeight pixels, 0 always draws the full resolution
+*/
+void vkglTF::CullingPass::cull(VkCommandBuffer commandBuffer, const Model& model, const glm::mat4& view, const glm::mat4& projection, float viewportHeight)
+{
+	if (!model.indirect.prepared) {
+		return;
+	}
+	const bool compact = model.indirect.vkCmdDrawIndexedIndirectCountKHR != nullptr;
+
+	// Draws of earlier frames have to be done reading the commands before they are rewritten
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = 0;
+	memoryBarrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	if (compact) {
+		// Blended draws are culled in place, their count keeps the number of draws of the group
+		vkCmdFillBuffer(commandBuffer, model.indirect.counts.buffer, 0, Model::Indirect::Blend * sizeof(uint32_t), 0);
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	PushConstants pushConstants{};
+	pushConstants.viewProjection = projection * view;
+	pushConstants.cameraPosition = glm::vec4(glm::vec3(glm::inverse(view)[3]), std::abs(projection[1][1]) * viewportHeight * 0.5f);
+	pushConstants.lodThreshold = lodThreshold;
+	uint32_t drawCount = 0;
+	for (uint32_t group = 0; group < Model::Indirect::GroupCount; group++) {
+		pushConstants.firstDraw[group] = model.indirect.firstDraw[group];
+		drawCount += model.indirect.drawCount[group];
+	}
+	pushConstants.drawCount = drawCount;
+	pushConstants.depthSize = glm::vec2(static_cast<float>(depthWidth), static_cast<float>(depthHeight));
+	pushConstants.flags = (compact ? CompactDraws : 0) | (frustumCulling ? FrustumTest : 0) | ((occlusionCulling && (depthView != VK_NULL_HANDLE)) ? OcclusionTest : 0) | (backfaceCulling ? ConeTest : 0) | ((viewportHeight > 0.0f) ? SelectLod : 0);
+
+	const VkDescriptorSet descriptorSets[2] = { getModelSet(model), pyramidSet };
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 2, descriptorSets, 1, &model.indirect.dynamicOffset);
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+	vkCmdDispatch(commandBuffer, (drawCount + 63) / 64, 1, 1);
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
@@ -0,0 +1,113 @@
+/*
+* Vulkan glTF GPU culling
+*
+* Frustum and occlusion culling of the indirect draws of glTF models in a compute pass
+*
+* Copyright (C)
+*
+*/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "vkdevice.h"
+#include "vkgltf.h"
+
+namespace vkglTF
+{
+	/*
+		GPU culling of models loaded with FileLoadingFlags::IndirectDraw
+
+		cull() tests the bounding box of every draw against the camera frustum and, if enabled, against a hierarchical depth buffer
+		built from the previous frame's depth by buildDepthPyramid(). Draws of meshlets (FileLoadingFlags::BuildMeshlets) are also
+		culled if their normal cone faces away from the camera. Draws with levels of detail (FileLoadingFlags::GenerateLods) get
+		the coarsest level whose error stays below lodThreshold pixels. The draws that survive are written to the model's
+		command buffer, so Model::drawIndirect() only draws those without any traversal on the CPU:
+			With VK_KHR_draw_indirect_count the survivors of the opaque and masked groups are compacted and their number is written to the counts buffer
+			Without it, and always for the blended group whose draw order has to stay stable, the command buffer keeps all draws and the culled ones get an instance count of 0
+
+		Both passes have to be recorded outside of a render pass, on the queue the model is drawn on.
+		They only use core Vulkan 1.0 compute shaders, an R32_SFLOAT storage image for the pyramid (reduced in the shader, not with
+		min/max samplers) and the regular vertex pipeline for the draws, no mesh shaders. Draw count compaction is optional.
+		Shaders: culling/cull.comp and culling/depthreduce.comp
+	*/
+	class CullingPass {
+	public:
+		/** @brief Max. depth of each 2x2 block of the level below, level 0 is half the size of the depth buffer it's built from */
+		struct DepthPyramid {
+			VkImage image = VK_NULL_HANDLE;
+			vks::Allocation allocation;
+			/** @brief View of all levels, sampled by the culling shader */
+			VkImageView view = VK_NULL_HANDLE;
+			/** @brief Single level views, written and read by the reduction shader */
+			std::vector<VkImageView> levelViews;
+			VkSampler sampler = VK_NULL_HANDLE;
+			uint32_t width = 0;
+			uint32_t height = 0;
+		} depthPyramid;
+
+		bool frustumCulling = true;
+		/** @brief Cull meshlets whose triangles all face away from the camera, only correct for pipelines that cull back faces */
+		bool backfaceCulling = true;
+		/** @brief Only takes effect once a depth buffer has been passed to setDepthSource() */
+		bool occlusionCulling = true;
+		/** @brief Largest projected error in pixels of the levels of detail cull() selects, see Primitive::selectLod() */
+		float lodThreshold = 1.0f;
+
+		void prepare(vks::VulkanDevice* device, const std::string& shadersPath, uint32_t maxModels = 16);
+		void destroy();
+		void setDepthSource(VkImageView depthView, VkImageLayout depthLayout, uint32_t width, uint32_t height);
+		void buildDepthPyramid(VkCommandBuffer commandBuffer);
+		void cull(VkCommandBuffer commandBuffer, const Model& model, const glm::mat4& view, const glm::mat4& projection, float viewportHeight = 0.0f);
+
+	private:
+		struct PushConstants {
+			glm::mat4 viewProjection;
+			uint32_t firstDraw[Model::Indirect::GroupCount];
+			uint32_t drawCount;
+			glm::vec2 depthSize;
+			uint32_t flags;
+			float lodThreshold;
+			/** @brief World space camera position in xyz, pixels per unit at a distance of one unit in w */
+			glm::vec4 cameraPosition;
+		};
+		enum CullFlags {
+			CompactDraws = 0x00000001,
+			FrustumTest = 0x00000002,
+			OcclusionTest = 0x00000004,
+			ConeTest = 0x00000008,
+			SelectLod = 0x00000010
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		/** @brief Set 0: per model buffers, set 1: depth pyramid */
+		VkDescriptorSetLayout modelSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout pyramidSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout reduceSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+		VkPipelineLayout reducePipelineLayout = VK_NULL_HANDLE;
+		VkPipeline cullPipeline = VK_NULL_HANDLE;
+		VkPipeline reducePipeline = VK_NULL_HANDLE;
+		VkDescriptorSet pyramidSet = VK_NULL_HANDLE;
+		/** @brief One set per reduction step, the first one reads the depth buffer */
+		std::vector<VkDescriptorSet> reduceSets;
+		/** @brief Sets are allocated the first time a model is culled, so models have to outlive the pass */
+		std::unordered_map<const Model*, VkDescriptorSet> modelSets;
+		uint32_t maxModels = 0;
+		VkImageView depthView = VK_NULL_HANDLE;
+		VkImageLayout depthLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		uint32_t depthWidth = 0;
+		uint32_t depthHeight = 0;
+		/** @brief Enough levels for depth buffers of up to 65536 texels in each dimension */
+		static const uint32_t maxPyramidLevels = 16;
+
+		void createDepthPyramid(uint32_t width, uint32_t height);
+		void destroyDepthPyramid();
+		VkDescriptorSet getModelSet(const Model& model);
+	};
+}
@@ -0,0 +1,642 @@
+/*
+* Vulkan glTF mesh optimization
+*
+* Reorders the triangles and vertices of indexed triangle lists for the post-transform vertex cache, overdraw and vertex fetch
+*
+* Copyright (C)
+*
+*/
+
+#include "vkgltfoptimize.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/*
+	Cache statistics
+*/
+
+float vkglTF::optimize::CacheStats::acmr() const
+{
+	return triangleCount > 0 ? static_cast<float>(cacheMisses) / static_cast<float>(triangleCount) : 0.0f;
+}
+
+float vkglTF::optimize::CacheStats::atvr() const
+{
+	return vertexCount > 0 ? static_cast<float>(cacheMisses) / static_cast<float>(vertexCount) : 0.0f;
+}
+
+vkglTF::optimize::CacheStats& vkglTF::optimize::CacheStats::operator+=(const CacheStats& other)
+{
+	triangleCount += other.triangleCount;
+	vertexCount += other.vertexCount;
+	cacheMisses += other.cacheMisses;
+	return *this;
+}
+
+/*
+	Simulates a FIFO post-transform cache, which is close enough to what current GPUs do to compare index orders
+*/
+vkglTF::optimize::CacheStats vkglTF::optimize::analyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount)
+{
+	CacheStats stats;
+	stats.triangleCount = indexCount / 3;
+	stats.vertexCount = vertexCount;
+	// Each vertex remembers the miss that put it into the cache, it is still cached while fewer than statsCacheSize misses followed
+	std::vector<uint64_t> insertedAt(vertexCount, 0);
+	for (size_t i = 0; i < stats.triangleCount * 3; i++) {
+		const uint32_t vertex = indices[i];
+		if ((insertedAt[vertex] == 0) || (stats.cacheMisses + 1 - insertedAt[vertex] > statsCacheSize)) {
+			stats.cacheMisses++;
+			insertedAt[vertex] = stats.cacheMisses;
+		}
+	}
+	return stats;
+}
+
+/*
+	Linear-speed vertex cache optimization (Tom Forsyth)
+	Greedily emits the triangle with the highest score, where vertices score higher the more recently they have been used
+	and the fewer triangles are left that use them, so vertices are finished off while they are still cached
+*/
+namespace
+{
+	const uint32_t forsythCacheSize = 32;
+
+	float forsythScore(int32_t cachePosition, uint32_t liveTriangles)
+	{
+		if (liveTriangles == 0) {
+			// No triangle left to emit
+			return -1.0f;
+		}
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			// The vertices of the last triangle get a fixed score, so the next triangle doesn't just pick the most recent edge
+			if (cachePosition < 3) {
+				score = 0.75f;
+			}
+			else {
+				score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / static_cast<float>(forsythCacheSize - 3), 1.5f);
+			}
+		}
+		// Boost vertices with few triangles left, so lone triangles don't stay behind
+		return score + 2.0f / std::sqrt(static_cast<float>(liveTriangles));
+	}
+}
+
+void vkglTF::optimize::optimizeVertexCache(uint32_t* indices, size_t indexCount, uint32_t vertexCount)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Triangles using each vertex, the triangles that have not been emitted yet are kept at the front of a vertex's list
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		liveTriangles[indices[i]]++;
+	}
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<int32_t> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		vertexScore[v] = forsythScore(-1, liveTriangles[v]);
+	}
+	std::vector<float> triangleScore(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	// Three extra entries hold the vertices pushed out by the triangle just emitted
+	uint32_t cache[forsythCacheSize + 3];
+	uint32_t cacheCount = 0;
+	int64_t best = -1;
+	size_t scanCursor = 0;
+
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+		if (best < 0) {
+			// No cached vertex has triangles left, continue with the next triangle in input order
+			while (emitted[scanCursor]) {
+				scanCursor++;
+			}
+			best = static_cast<int64_t>(scanCursor);
+		}
+		const uint32_t triangle = static_cast<uint32_t>(best);
+		const uint32_t* vertices = &indices[triangle * 3];
+		output.insert(output.end(), vertices, vertices + 3);
+		emitted[triangle] = true;
+
+		// Move the triangle behind the live part of its vertices' lists
+		for (uint32_t k = 0; k < 3; k++) {
+			const uint32_t v = vertices[k];
+			uint32_t* list = &adjacency[adjacencyOffsets[v]];
+			const uint32_t live = liveTriangles[v];
+			for (uint32_t i = 0; i < live; i++) {
+				if (list[i] == triangle) {
+					std::swap(list[i], list[live - 1]);
+					break;
+				}
+			}
+			liveTriangles[v]--;
+		}
+
+		// The triangle's vertices move to the front of the cache, followed by the previous entries
+		uint32_t newCache[forsythCacheSize + 3];
+		uint32_t newCount = 0;
+		for (uint32_t k = 0; k < 3; k++) {
+			newCache[newCount++] = vertices[k];
+		}
+		for (uint32_t i = 0; i < cacheCount; i++) {
+			const uint32_t v = cache[i];
+			if ((v != vertices[0]) && (v != vertices[1]) && (v != vertices[2])) {
+				newCache[newCount++] = v;
+			}
+		}
+		for (uint32_t i = 0; i < newCount; i++) {
+			cachePosition[newCache[i]] = (i < forsythCacheSize) ? static_cast<int32_t>(i) : -1;
+			vertexScore[newCache[i]] = forsythScore(cachePosition[newCache[i]], liveTriangles[newCache[i]]);
+		}
+		cacheCount = std::min(newCount, forsythCacheSize);
+		memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+
+		// Rescore the remaining triangles of all vertices that changed, the next triangle is the best of these
+		best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t i = 0; i < newCount; i++) {
+			const uint32_t v = newCache[i];
+			const uint32_t* list = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t j = 0; j < liveTriangles[v]; j++) {
+				const uint32_t t = list[j];
+				triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+		}
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+/*
+	Overdraw optimization
+	Splits the cache optimized index order into clusters at triangles that miss the cache with all of their vertices,
+	so reordering the clusters barely changes the cache efficiency. Clusters are then sorted by how far they face out
+	from the center of the mesh, so the outer parts of an opaque mesh are drawn first and occlude the inner ones.
+*/
+void vkglTF::optimize::optimizeOverdraw(uint32_t* indices, size_t indexCount, const unsigned char* positions, size_t stride, uint32_t vertexCount)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2) {
+		return;
+	}
+	auto position = [&](uint32_t vertex) {
+		glm::vec3 result;
+		memcpy(&result, positions + vertex * stride, sizeof(result));
+		return result;
+	};
+
+	// Cluster boundaries
+	std::vector<uint32_t> clusterStarts;
+	std::vector<uint64_t> insertedAt(vertexCount, 0);
+	uint64_t misses = 0;
+	for (size_t t = 0; t < triangleCount; t++) {
+		uint32_t triangleMisses = 0;
+		for (uint32_t k = 0; k < 3; k++) {
+			const uint32_t vertex = indices[t * 3 + k];
+			if ((insertedAt[vertex] == 0) || (misses + 1 - insertedAt[vertex] > statsCacheSize)) {
+				misses++;
+				insertedAt[vertex] = misses;
+				triangleMisses++;
+			}
+		}
+		if ((t == 0) || (triangleMisses == 3)) {
+			clusterStarts.push_back(static_cast<uint32_t>(t));
+		}
+	}
+	if (clusterStarts.size() < 2) {
+		return;
+	}
+
+	// Area weighted centroid and normal of the mesh and of each cluster
+	struct Cluster {
+		uint32_t firstTriangle;
+		uint32_t triangleCount;
+		float sortKey;
+	};
+	std::vector<Cluster> clusters(clusterStarts.size());
+	std::vector<glm::vec3> clusterCentroids(clusters.size());
+	std::vector<glm::vec3> clusterNormals(clusters.size());
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusters.size(); c++) {
+		const uint32_t first = clusterStarts[c];
+		const uint32_t last = (c + 1 < clusterStarts.size()) ? clusterStarts[c + 1] : static_cast<uint32_t>(triangleCount);
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for (uint32_t t = first; t < last; t++) {
+			const glm::vec3 p0 = position(indices[t * 3]);
+			const glm::vec3 p1 = position(indices[t * 3 + 1]);
+			const glm::vec3 p2 = position(indices[t * 3 + 2]);
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const float triangleArea = glm::length(n);
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += n;
+			area += triangleArea;
+		}
+		clusters[c] = { first, last - first, 0.0f };
+		clusterCentroids[c] = area > 0.0f ? centroid / area : glm::vec3(0.0f);
+		clusterNormals[c] = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+		meshCentroid += centroid;
+		meshArea += area;
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid /= meshArea;
+	}
+	for (size_t c = 0; c < clusters.size(); c++) {
+		clusters[c].sortKey = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+	}
+
+	// Outward facing clusters first, ties keep the cache friendly order
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+		return a.sortKey > b.sortKey;
+	});
+	std::vector<uint32_t> sorted;
+	sorted.reserve(triangleCount * 3);
+	for (const Cluster& cluster : clusters) {
+		sorted.insert(sorted.end(), indices + cluster.firstTriangle * 3, indices + (cluster.firstTriangle + cluster.triangleCount) * 3);
+	}
+	memcpy(indices, sorted.data(), sorted.size() * sizeof(uint32_t));
+}
+
+/*
+	Vertex fetch optimization
+	Stores vertices in the order the indices first reference them, so vertex fetches walk linearly through memory
+	Vertices that no index references are kept behind all others
+*/
+void vkglTF::optimize::optimizeVertexFetch(uint32_t* indices, size_t indexCount, unsigned char* vertices, size_t stride, uint32_t vertexCount)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(vertexCount, unused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		uint32_t& target = remap[indices[i]];
+		if (target == unused) {
+			target = next++;
+		}
+		indices[i] = target;
+	}
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		if (remap[v] == unused) {
+			remap[v] = next++;
+		}
+	}
+
+	std::vector<unsigned char> source(vertices, vertices + vertexCount * stride);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		memcpy(vertices + remap[v] * stride, &source[v * stride], stride);
+	}
+}
+
+/*
+	Meshlet building
+	Scans the triangles in their current order and starts a new meshlet whenever the next triangle would exceed the vertex or triangle limit,
+	so the cache optimized order is kept and each meshlet is a contiguous range of the index buffer
+*/
+void vkglTF::optimize::buildMeshlets(const uint32_t* indices, size_t indexCount, const unsigned char* positions, size_t stride, uint32_t vertexCount, std::vector<Meshlet>& meshlets)
+{
+	auto position = [&](uint32_t vertex) {
+		glm::vec3 result;
+		memcpy(&result, positions + vertex * stride, sizeof(result));
+		return result;
+	};
+
+	// Bounding sphere around the box of the meshlet's vertices, and the cone around its face normals
+	auto addMeshlet = [&](size_t firstTriangle, size_t lastTriangle) {
+		Meshlet meshlet{};
+		meshlet.firstIndex = static_cast<uint32_t>(firstTriangle * 3);
+		meshlet.indexCount = static_cast<uint32_t>((lastTriangle - firstTriangle) * 3);
+		glm::vec3 min(FLT_MAX);
+		glm::vec3 max(-FLT_MAX);
+		for (size_t i = firstTriangle * 3; i < lastTriangle * 3; i++) {
+			min = glm::min(min, position(indices[i]));
+			max = glm::max(max, position(indices[i]));
+		}
+		meshlet.center = (min + max) * 0.5f;
+		for (size_t i = firstTriangle * 3; i < lastTriangle * 3; i++) {
+			meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, position(indices[i])));
+		}
+
+		glm::vec3 normals[maxMeshletTriangles];
+		uint32_t normalCount = 0;
+		glm::vec3 axis(0.0f);
+		for (size_t t = firstTriangle; t < lastTriangle; t++) {
+			const glm::vec3 p0 = position(indices[t * 3]);
+			const glm::vec3 n = glm::cross(position(indices[t * 3 + 1]) - p0, position(indices[t * 3 + 2]) - p0);
+			const float length = glm::length(n);
+			// Degenerate triangles are never rasterized and don't widen the cone
+			if (length > 0.0f) {
+				normals[normalCount++] = n / length;
+				axis += n / length;
+			}
+		}
+		meshlet.coneCutoff = 1.0f;
+		if ((normalCount > 0) && (glm::length(axis) > 0.0f)) {
+			meshlet.coneAxis = glm::normalize(axis);
+			float minDot = 1.0f;
+			for (uint32_t i = 0; i < normalCount; i++) {
+				minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normals[i]));
+			}
+			// Widening the normal cone by 90 degrees gives the directions all triangles are back facing from, cones that wide hardly ever cull
+			if (minDot > 0.1f) {
+				meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+			}
+		}
+		meshlets.push_back(meshlet);
+	};
+
+	// Vertices are marked with the number of the meshlet they were last added to, so nothing has to be cleared between meshlets
+	std::vector<uint32_t> addedTo(vertexCount, ~0u);
+	uint32_t meshlet = 0;
+	uint32_t meshletVertexCount = 0;
+	size_t firstTriangle = 0;
+	const size_t triangleCount = indexCount / 3;
+	auto newVertices = [&](const uint32_t* triangle) {
+		uint32_t count = 0;
+		for (uint32_t k = 0; k < 3; k++) {
+			const bool repeated = ((k > 0) && (triangle[k] == triangle[0])) || ((k > 1) && (triangle[k] == triangle[1]));
+			if ((addedTo[triangle[k]] != meshlet) && !repeated) {
+				count++;
+			}
+		}
+		return count;
+	};
+	for (size_t t = 0; t < triangleCount; t++) {
+		const uint32_t* triangle = &indices[t * 3];
+		uint32_t count = newVertices(triangle);
+		if ((meshletVertexCount + count > maxMeshletVertices) || (t - firstTriangle >= maxMeshletTriangles)) {
+			addMeshlet(firstTriangle, t);
+			firstTriangle = t;
+			meshlet++;
+			meshletVertexCount = 0;
+			count = newVertices(triangle);
+		}
+		for (uint32_t k = 0; k < 3; k++) {
+			addedTo[triangle[k]] = meshlet;
+		}
+		meshletVertexCount += count;
+	}
+	if (firstTriangle < triangleCount) {
+		addMeshlet(firstTriangle, triangleCount);
+	}
+}
+
+/*
+	Simplification
+	Quadric error metric edge collapses (Garland & Heckbert), restricted to collapsing a vertex onto one of its neighbours so the
+	vertex buffer is shared by all levels. Vertices on open borders and on attribute seams (several vertices at one position)
+	never move, which keeps the silhouette of open meshes and the texture and normal seams intact.
+*/
+namespace
+{
+	/** @brief Symmetric 4x4 matrix of the summed squared distances to a set of planes */
+	struct Quadric {
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+		double weight = 0;
+		void addPlane(const glm::dvec3& n, double d, double w)
+		{
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+			a22 += w * n.z * n.z; a23 += w * n.z * d;
+			a33 += w * d * d;
+			weight += w;
+		}
+		Quadric& operator+=(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03; a11 += q.a11; a12 += q.a12; a13 += q.a13; a22 += q.a22; a23 += q.a23; a33 += q.a33;
+			weight += q.weight;
+			return *this;
+		}
+		/** @brief Area weighted mean squared distance of p to the planes */
+		double error(const glm::dvec3& p) const
+		{
+			const double e = a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x
+				+ a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y
+				+ a22 * p.z * p.z + 2 * a23 * p.z
+				+ a33;
+			return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+		}
+	};
+}
+
+std::vector<uint32_t> vkglTF::optimize::simplify(const uint32_t* indices, size_t indexCount, const unsigned char* positions, size_t stride, uint32_t vertexCount, size_t targetIndexCount, float& error)
+{
+	auto position = [&](uint32_t vertex) {
+		glm::vec3 result;
+		memcpy(&result, positions + vertex * stride, sizeof(result));
+		return result;
+	};
+
+	// Vertices sharing a position, the first one found stands in for all of them
+	std::vector<uint32_t> canonical(vertexCount);
+	std::vector<uint32_t> wedgeCount(vertexCount, 0);
+	{
+		std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			const glm::vec3 p = position(v);
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			const uint64_t key = (static_cast<uint64_t>(bits[0]) * 73856093u) ^ (static_cast<uint64_t>(bits[1]) * 19349663u) ^ (static_cast<uint64_t>(bits[2]) * 83492791u);
+			std::vector<uint32_t>& bucket = buckets[key];
+			canonical[v] = v;
+			for (uint32_t other : bucket) {
+				if (position(other) == p) {
+					canonical[v] = other;
+					break;
+				}
+			}
+			if (canonical[v] == v) {
+				bucket.push_back(v);
+			}
+			wedgeCount[canonical[v]]++;
+		}
+	}
+
+	// Edges of the welded mesh used by a single triangle are open borders
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_map<uint64_t, uint32_t> edgeUse;
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+			for (uint32_t k = 0; k < 3; k++) {
+				uint32_t a = canonical[indices[i + k]];
+				uint32_t b = canonical[indices[i + (k + 1) % 3]];
+				if (a > b) {
+					std::swap(a, b);
+				}
+				edgeUse[(static_cast<uint64_t>(a) << 32) | b]++;
+			}
+		}
+		for (const auto& edge : edgeUse) {
+			if (edge.second == 1) {
+				locked[static_cast<uint32_t>(edge.first >> 32)] = true;
+				locked[static_cast<uint32_t>(edge.first & 0xffffffffu)] = true;
+			}
+		}
+	}
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		locked[v] = locked[canonical[v]] || (wedgeCount[canonical[v]] > 1);
+	}
+
+	// Quadrics of the triangle planes around each welded vertex
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		const glm::dvec3 p0 = position(indices[i]);
+		const glm::dvec3 n = glm::cross(glm::dvec3(position(indices[i + 1])) - p0, glm::dvec3(position(indices[i + 2])) - p0);
+		const double area = glm::length(n);
+		if (area <= 0.0) {
+			continue;
+		}
+		const glm::dvec3 normal = n / area;
+		for (uint32_t k = 0; k < 3; k++) {
+			quadrics[canonical[indices[i + k]]].addPlane(normal, -glm::dot(normal, p0), area);
+		}
+	}
+
+	std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+	std::vector<uint32_t> collapse(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<uint32_t> adjacencyStart(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+	std::vector<Collapse> candidates;
+	double maxCost = 0.0;
+
+	while (result.size() > targetIndexCount) {
+		const size_t triangleCount = result.size() / 3;
+
+		// Triangles around each vertex
+		std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+		for (uint32_t vertex : result) {
+			adjacencyStart[vertex + 1]++;
+		}
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			adjacencyStart[v + 1] += adjacencyStart[v];
+		}
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (size_t i = 0; i < result.size(); i++) {
+			adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		candidates.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (uint32_t k = 0; k < 3; k++) {
+				const uint32_t from = result[i + k];
+				const uint32_t to = result[i + (k + 1) % 3];
+				for (uint32_t direction = 0; direction < 2; direction++) {
+					const uint32_t a = direction ? to : from;
+					const uint32_t b = direction ? from : to;
+					if (!locked[a] && (a != b)) {
+						Quadric q = quadrics[canonical[a]];
+						q += quadrics[canonical[b]];
+						candidates.push_back({ a, b, q.error(position(b)) });
+					}
+				}
+			}
+		}
+		if (candidates.empty()) {
+			break;
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) {
+			return x.cost < y.cost;
+		});
+
+		// Cheapest collapses first, each collapse removes about two triangles
+		// Vertices around a collapse stay untouched for the rest of the pass, so the flip checks of later collapses see the current mesh
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			collapse[v] = v;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+		const size_t collapsesNeeded = std::max<size_t>((triangleCount - targetIndexCount / 3) / 2, 1);
+		size_t collapses = 0;
+		for (const Collapse& candidate : candidates) {
+			if (collapses >= collapsesNeeded) {
+				break;
+			}
+			if (touched[candidate.from] || touched[candidate.to]) {
+				continue;
+			}
+			const glm::vec3 target = position(candidate.to);
+			bool flips = false;
+			for (uint32_t a = adjacencyStart[candidate.from]; (a < adjacencyStart[candidate.from + 1]) && !flips; a++) {
+				const uint32_t* triangle = &result[adjacency[a] * 3];
+				if ((triangle[0] == candidate.to) || (triangle[1] == candidate.to) || (triangle[2] == candidate.to)) {
+					continue;
+				}
+				glm::vec3 p[3], q[3];
+				for (uint32_t k = 0; k < 3; k++) {
+					p[k] = position(triangle[k]);
+					q[k] = (triangle[k] == candidate.from) ? target : p[k];
+				}
+				flips = glm::dot(glm::cross(p[1] - p[0], p[2] - p[0]), glm::cross(q[1] - q[0], q[2] - q[0])) <= 0.0f;
+			}
+			if (flips) {
+				continue;
+			}
+			collapse[candidate.from] = candidate.to;
+			touched[candidate.from] = true;
+			touched[candidate.to] = true;
+			for (uint32_t a = adjacencyStart[candidate.from]; a < adjacencyStart[candidate.from + 1]; a++) {
+				const uint32_t* triangle = &result[adjacency[a] * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+			}
+			quadrics[canonical[candidate.to]] += quadrics[canonical[candidate.from]];
+			maxCost = std::max(maxCost, candidate.cost);
+			collapses++;
+		}
+		if (collapses == 0) {
+			break;
+		}
+
+		// Triangles that lost a corner in a collapse are dropped
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			const uint32_t a = collapse[result[i]];
+			const uint32_t b = collapse[result[i + 1]];
+			const uint32_t c = collapse[result[i + 2]];
+			if ((a != b) && (b != c) && (c != a)) {
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+
+	error = static_cast<float>(std::sqrt(maxCost));
+	return result;
+}
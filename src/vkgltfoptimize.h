@@ -0,0 +1,75 @@
+/*
+* Vulkan glTF mesh optimization
+*
+* Reorders the triangles and vertices of indexed triangle lists for the post-transform vertex cache, overdraw and vertex fetch
+*
+* Copyright (C)
+*
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vkglTF
+{
+	/*
+		Mesh optimization
+
+		Works on a single primitive at a time, with indices relative to the primitive's first vertex:
+			optimizeVertexCache  reorders triangles so vertices are reused while they are still in the post-transform cache
+			optimizeOverdraw     reorders clusters of triangles so outward facing parts of the mesh tend to be drawn first
+			optimizeVertexFetch  reorders vertices into the order they are first referenced in and remaps the indices
+			buildMeshlets        splits the triangles into clusters with bounds for culling, without changing their order
+			simplify             builds a coarser index list over the same vertices for levels of detail
+		The passes are meant to run in that order, the overdraw pass keeps the cache friendly order within its clusters.
+	*/
+	namespace optimize
+	{
+		/** @brief Number of entries of the FIFO cache the statistics are simulated with */
+		const uint32_t statsCacheSize = 16;
+
+		/** @brief Post-transform vertex cache efficiency of a set of triangle lists */
+		struct CacheStats {
+			uint64_t triangleCount = 0;
+			uint64_t vertexCount = 0;
+			uint64_t cacheMisses = 0;
+			/** @brief Average cache miss ratio, transformed vertices per triangle (0.5 is ideal for large grids, 3 is the worst) */
+			float acmr() const;
+			/** @brief Average transform to vertex ratio, transformed vertices per vertex (1 is ideal) */
+			float atvr() const;
+			CacheStats& operator+=(const CacheStats& other);
+		};
+
+		/** @brief Levels of detail of a primitive, including the full resolution one */
+		const uint32_t maxLodCount = 5;
+		const uint32_t maxMeshletVertices = 64;
+		const uint32_t maxMeshletTriangles = 124;
+
+		/** @brief Consecutive triangles of a primitive that are culled as a unit */
+		struct Meshlet {
+			/** @brief Range of the meshlet's indices, relative to the primitive's first index */
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			/** @brief Bounding sphere */
+			glm::vec3 center;
+			float radius;
+			/** @brief Normal cone, all triangles face away from viewers with dot(center - viewer, coneAxis) >= coneCutoff * distance + radius */
+			glm::vec3 coneAxis;
+			/** @brief 1 if the triangles' normals spread too far for the cone to ever cull the meshlet */
+			float coneCutoff;
+		};
+
+		CacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount);
+		void optimizeVertexCache(uint32_t* indices, size_t indexCount, uint32_t vertexCount);
+		void optimizeOverdraw(uint32_t* indices, size_t indexCount, const unsigned char* positions, size_t stride, uint32_t vertexCount);
+		void optimizeVertexFetch(uint32_t* indices, size_t indexCount, unsigned char* vertices, size_t stride, uint32_t vertexCount);
+		void buildMeshlets(const uint32_t* indices, size_t indexCount, const unsigned char* positions, size_t stride, uint32_t vertexCount, std::vector<Meshlet>& meshlets);
+		/** @brief error receives the largest distance a collapse moved the surface by, in the units of the positions */
+		std::vector<uint32_t> simplify(const uint32_t* indices, size_t indexCount, const unsigned char* positions, size_t stride, uint32_t vertexCount, size_t targetIndexCount, float& error);
+	}
+}
@@ -0,0 +1,203 @@
+/*
+* Vulkan glTF compute skinning
+*
+* Skins the vertices of glTF models in a compute pass, with the joint matrices of all skinned mesh nodes in a single storage buffer
+*
+* Copyright (C)
+*
+*/
+
+#include "vkgltfskinning.h"
+
+#include <algorithm>
+#include <cstring>
+
+void vkglTF::SkinningPass::prepare(vks::VulkanDevice* device, const std::string& shadersPath, uint32_t maxModels)
+{
+	this->device = device;
+	this->maxModels = maxModels;
+
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxModels * 2),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, maxModels),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxModels);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+	// The joint matrices have a copy per frame in flight of the model, selected by the dynamic offset
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+	VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+	pipelineLayoutCI.pushConstantRangeCount = 1;
+	pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+	VkPipelineShaderStageCreateInfo shaderStage{};
+	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	shaderStage.module = vks::tools::loadShader((shadersPath + "skinning/skin.comp.spv").c_str(), device->logicalDevice);
+	shaderStage.pName = "main";
+	assert(shaderStage.module != VK_NULL_HANDLE);
+	VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout);
+	pipelineCI.stage = shaderStage;
+	VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+	vkDestroyShaderModule(device->logicalDevice, shaderStage.module, nullptr);
+}
+
+void vkglTF::SkinningPass::destroy()
+{
+	if (!device) {
+		return;
+	}
+	for (auto& model : models) {
+		model.second.vertices.destroy();
+		model.second.joints.destroy();
+	}
+	models.clear();
+	vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+	vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+	device = nullptr;
+}
+
+/*
+	Models need storage and transfer access to their vertex buffer, and float vertex components the shader can read as such
+*/
+bool vkglTF::SkinningPass::supports(const Model& model)
+{
+	const VertexLayout& layout = model.vertexLayout;
+	return (model.vertices.buffer != VK_NULL_HANDLE) && layout.has(VertexComponent::Joint0) && layout.has(VertexComponent::Weight0) &&
+		!(layout.quantization & (QuantizeNormals | QuantizeSkin)) && !model.skins.empty() && model.skins.front()->computeSkinning;
+}
+
+/*
+	Lays out the joints of all skinned mesh nodes one after the other and creates the model's buffers and descriptor set
+*/
+vkglTF::SkinningPass::ModelResources& vkglTF::SkinningPass::getModelResources(const Model& model)
+{
+	auto it = models.find(&model);
+	if (it != models.end()) {
+		return it->second;
+	}
+	assert(models.size() < maxModels);
+	assert(supports(model));
+	ModelResources& resources = models[&model];
+
+	uint32_t jointCount = 0;
+	for (const Node* node : model.linearNodes) {
+		if (!node->mesh || !node->skin) {
+			continue;
+		}
+		resources.meshNodes.push_back(node);
+		for (const Primitive* primitive : node->mesh->primitives) {
+			if (primitive->vertexCount > 0) {
+				resources.dispatches.push_back({ primitive->firstVertex, primitive->vertexCount, jointCount });
+			}
+		}
+		jointCount += static_cast<uint32_t>(node->skin->joints.size());
+	}
+
+	const VkDeviceSize vertexBufferSize = static_cast<VkDeviceSize>(model.vertices.count) * model.vertexLayout.stride;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &resources.vertices, vertexBufferSize));
+	// Joint matrices change every frame, so they are written in place like the mesh uniform buffers, into one copy per frame in flight
+	const VkDeviceSize alignment = device->properties.limits.minStorageBufferOffsetAlignment;
+	resources.jointsFrameSize = (std::max(jointCount, 1u) * sizeof(glm::mat4) + alignment - 1) & ~(alignment - 1);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &resources.joints, model.frameCount * resources.jointsFrameSize));
+	VK_CHECK_RESULT(resources.joints.map());
+	resources.joints.setupDescriptor(resources.jointsFrameSize);
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &resources.descriptorSet));
+	VkDescriptorBufferInfo bufferDescriptors[3] = {
+		{ model.vertices.buffer, 0, VK_WHOLE_SIZE },
+		resources.vertices.descriptor,
+		resources.joints.descriptor,
+	};
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+	for (uint32_t binding = 0; binding < 3; binding++) {
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(resources.descriptorSet, (binding == 2) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, binding, &bufferDescriptors[binding]));
+	}
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	return resources;
+}
+
+/*
+	Joint matrices are relative to their mesh node, like the ones Node::update() writes to Mesh::UniformBlock
+	They are written to the copy of the model's current frame, see Model::setFrameIndex()
+*/
+void vkglTF::SkinningPass::update(const Model& model)
+{
+	ModelResources& resources = getModelResources(model);
+	glm::mat4* joints = reinterpret_cast<glm::mat4*>(static_cast<unsigned char*>(resources.joints.mapped) + model.frameIndex * resources.jointsFrameSize);
+	for (const Node* node : resources.meshNodes) {
+		const Skin* skin = node->skin;
+		const glm::mat4 inverseTransform = glm::inverse(node->worldMatrix);
+		for (size_t i = 0; i < skin->joints.size(); i++) {
+			*joints++ = inverseTransform * skin->joints[i]->worldMatrix * skin->inverseBindMatrices[i];
+		}
+	}
+}
+
+void vkglTF::SkinningPass::skin(VkCommandBuffer commandBuffer, const Model& model)
+{
+	ModelResources& resources = getModelResources(model);
+
+	// Draws of earlier frames have to be done reading the skinned vertices before they are rewritten
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = 0;
+	memoryBarrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	if (!resources.initialized) {
+		// Vertices of unskinned meshes and components the shader doesn't write are taken over as they are
+		VkBufferCopy copyRegion{};
+		copyRegion.size = static_cast<VkDeviceSize>(model.vertices.count) * model.vertexLayout.stride;
+		vkCmdCopyBuffer(commandBuffer, model.vertices.buffer, resources.vertices.buffer, 1, &copyRegion);
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		resources.initialized = true;
+	}
+
+	const VertexLayout& layout = model.vertexLayout;
+	auto offset = [&](VertexComponent component) {
+		return layout.has(component) ? static_cast<int32_t>(layout.offsets[static_cast<uint32_t>(component)] / sizeof(float)) : -1;
+	};
+	PushConstants pushConstants{};
+	pushConstants.stride = layout.stride / sizeof(float);
+	pushConstants.position = offset(VertexComponent::Position);
+	pushConstants.normal = offset(VertexComponent::Normal);
+	pushConstants.tangent = offset(VertexComponent::Tangent);
+	pushConstants.joint = offset(VertexComponent::Joint0);
+	pushConstants.weight = offset(VertexComponent::Weight0);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	const uint32_t dynamicOffset = static_cast<uint32_t>(model.frameIndex * resources.jointsFrameSize);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &resources.descriptorSet, 1, &dynamicOffset);
+	for (const Dispatch& dispatch : resources.dispatches) {
+		pushConstants.firstVertex = dispatch.firstVertex;
+		pushConstants.vertexCount = dispatch.vertexCount;
+		pushConstants.firstJoint = dispatch.firstJoint;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (dispatch.vertexCount + 63) / 64, 1, 1);
+	}
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void vkglTF::SkinningPass::bindBuffers(VkCommandBuffer commandBuffer, Model& model)
+{
+	const ModelResources& resources = getModelResources(model);
+	const VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &resources.vertices.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, model.indices.buffer, 0, model.indices.type);
+	model.buffersBound = true;
+}
@@ -0,0 +1,92 @@
+/*
+* Vulkan glTF compute skinning
+*
+* Skins the vertices of glTF models in a compute pass, with the joint matrices of all skins in a single storage buffer
+*
+* Copyright (C)
+*
+*/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "vkdevice.h"
+#include "vkgltf.h"
+
+namespace vkglTF
+{
+	/*
+		Compute skinning of models loaded with FileLoadingFlags::ComputeSkinning
+
+		Each model gets a skinned copy of its vertex buffer. update() writes the joint matrices of all skinned mesh nodes into one
+		host visible storage buffer, and skin() records a dispatch per skinned primitive that writes the skinned positions, normals
+		and tangents into the copy. Draws bind the copy with bindBuffers() and then draw the model as usual, so shadow, depth and
+		color passes all reuse the result of a single skinning pass and skins aren't limited by the size of Mesh::UniformBlock.
+
+		Skinned vertices stay in the space of their mesh node, like the vertex shader skinning they replace, and vertex
+		shaders must not skin them again (the mesh uniform blocks of such skins have a joint count of 0).
+		The vertex layout needs float normals, tangents, joints and weights, i.e. no QuantizeNormals or QuantizeSkin.
+		Shader: skinning/skin.comp
+	*/
+	class SkinningPass {
+	public:
+		void prepare(vks::VulkanDevice* device, const std::string& shadersPath, uint32_t maxModels = 16);
+		void destroy();
+		/** @brief Writes the joint matrices from the nodes' world matrices, call after updating the model's animation and Model::setFrameIndex() */
+		void update(const Model& model);
+		/** @brief Record outside of a render pass, before the passes that draw the model */
+		void skin(VkCommandBuffer commandBuffer, const Model& model);
+		/** @brief Binds the skinned vertex buffer and the model's index buffer, in place of Model::bindBuffers() */
+		void bindBuffers(VkCommandBuffer commandBuffer, Model& model);
+		static bool supports(const Model& model);
+
+	private:
+		struct PushConstants {
+			uint32_t firstVertex;
+			uint32_t vertexCount;
+			uint32_t firstJoint;
+			/** @brief Vertex stride and component offsets in floats, -1 for components the layout doesn't have */
+			uint32_t stride;
+			int32_t position;
+			int32_t normal;
+			int32_t tangent;
+			int32_t joint;
+			int32_t weight;
+		};
+		struct Dispatch {
+			uint32_t firstVertex;
+			uint32_t vertexCount;
+			uint32_t firstJoint;
+		};
+		struct ModelResources {
+			/** @brief Skinned copy of the model's vertex buffer */
+			vks::Buffer vertices;
+			/** @brief Joint matrices of all skinned mesh nodes for each frame in flight of the model, host visible */
+			vks::Buffer joints;
+			/** @brief Size of a frame's joint matrices, rounded up to the device's storage buffer offset alignment */
+			VkDeviceSize jointsFrameSize = 0;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			std::vector<Dispatch> dispatches;
+			/** @brief Skinned mesh nodes in the order of their joints in the joints buffer */
+			std::vector<const Node*> meshNodes;
+			/** @brief Unskinned vertices are copied into the skinned buffer the first time the model is skinned */
+			bool initialized = false;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		/** @brief Source vertices, skinned vertices, joint matrices */
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		/** @brief Resources are created the first time a model is updated, so models have to outlive the pass */
+		std::unordered_map<const Model*, ModelResources> models;
+		uint32_t maxModels = 0;
+
+		ModelResources& getModelResources(const Model& model);
+	};
+}
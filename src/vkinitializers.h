@@ -579,6 +579,19 @@ namespace vks
 			return pushConstantRange;
 		}
 
+		inline VkQueryPoolCreateInfo queryPoolCreateInfo(
+			VkQueryType queryType,
+			uint32_t queryCount,
+			VkQueryPipelineStatisticFlags pipelineStatistics = 0)
+		{
+			VkQueryPoolCreateInfo queryPoolCreateInfo{};
+			queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCreateInfo.queryType = queryType;
+			queryPoolCreateInfo.queryCount = queryCount;
+			queryPoolCreateInfo.pipelineStatistics = pipelineStatistics;
+			return queryPoolCreateInfo;
+		}
+
 		inline VkBindSparseInfo bindSparseInfo()
 		{
 			VkBindSparseInfo bindSparseInfo{};
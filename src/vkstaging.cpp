@@ -0,0 +1,196 @@
+/*
+* Vulkan staging ring buffer
+*
+* Persistently mapped upload buffer shared by all texture and buffer uploads of a device
+*
+* Copyright (C)
+*
+*/
+
+#include <algorithm>
+#include <numeric>
+
+#include "vkstaging.h"
+#include "vkdevice.h"
+
+namespace vks
+{
+	/**
+	* Create and map the ring buffer
+	*
+	* @param device Vulkan device to create the ring on, copies are recorded into its transfer context
+	* @param size (Optional) Size of the ring in bytes (defaults to 64 MB)
+	*/
+	void StagingRing::prepare(vks::VulkanDevice* device, VkDeviceSize size)
+	{
+		this->device = device;
+		this->size = size;
+		createBuffer(size, &buffer);
+	}
+
+	/**
+	* Create a mapped, host visible transfer source buffer
+	*
+	* @note If the device has a dedicated transfer queue the buffer is shared concurrently with the graphics family,
+	* as ranges are rewritten by the host and read by whichever queue the upload goes to without an ownership transfer
+	*/
+	void StagingRing::createBuffer(VkDeviceSize size, vks::Buffer* target)
+	{
+		uint32_t queueFamilies[] = { device->queueFamilyIndices.graphics, device->queueFamilyIndices.transfer };
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size);
+		if (device->hasDedicatedTransferQueue())
+		{
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount = 2;
+			bufferCreateInfo.pQueueFamilyIndices = queueFamilies;
+		}
+		target->device = device->logicalDevice;
+		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &target->buffer));
+
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device->logicalDevice, target->buffer, &memReqs);
+		target->memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VK_CHECK_RESULT(device->allocateMemory(memReqs, target->memoryPropertyFlags, vks::AllocationType::Linear, &target->allocation));
+		target->alignment = memReqs.alignment;
+		target->size = size;
+		target->usageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		VK_CHECK_RESULT(target->bind());
+		VK_CHECK_RESULT(target->map());
+	}
+
+	/**
+	* Wait for all outstanding uploads and release the ring buffer
+	*/
+	void StagingRing::destroy()
+	{
+		if (!device)
+		{
+			return;
+		}
+		// Waiting on the graphics context first submits the transfer batches it depends on
+		device->transfer.waitIdle();
+		device->asyncTransfer.waitIdle();
+		reclaim();
+		assert(spans.empty());
+		buffer.destroy();
+		device = nullptr;
+	}
+
+	/**
+	* Get the span of the transfer batch that is currently recording for the given queue
+	*/
+	StagingRing::Span& StagingRing::currentSpan(VkQueue queue)
+	{
+		vks::TransferTicket ticket = device->getTransferContext(queue).currentTicket(queue);
+		if (spans.empty() || spans.back().ticket.context != ticket.context || spans.back().ticket.value != ticket.value)
+		{
+			spans.emplace_back();
+			spans.back().ticket = ticket;
+		}
+		return spans.back();
+	}
+
+	bool StagingRing::tryAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, VkDeviceSize& consumed)
+	{
+		if (used == 0)
+		{
+			// Nothing in flight, restart at the beginning for the largest contiguous range
+			head = 0;
+		}
+		VkDeviceSize aligned = (head + alignment - 1) / alignment * alignment;
+		consumed = aligned - head + size;
+		if (aligned + size > this->size)
+		{
+			// Skip the remainder at the end of the ring and wrap around
+			aligned = 0;
+			consumed = this->size - head + size;
+		}
+		if (used + consumed > this->size)
+		{
+			return false;
+		}
+		offset = aligned;
+		head = aligned + size;
+		used += consumed;
+		return true;
+	}
+
+	/**
+	* Reserve a range of the ring for the open transfer batch
+	*
+	* @param queue Queue the batch that copies from this region will be submitted to
+	* @param size Size of the region in bytes
+	* @param texelBlockSize (Optional) Texel (or compressed block) size of the image format the region is copied to, see vks::tools::formatTexelBlockSize (defaults to 4, buffer copies have no alignment requirement)
+	*
+	* @note If the ring is full, the call blocks until the oldest uploads have finished, submitting the open batch if it is the oldest.
+	* Uploads larger than the whole ring get a temporary buffer that is released together with the batch.
+	*
+	* @return Region to write the source data to
+	*/
+	StagingRing::Region StagingRing::allocate(VkQueue queue, VkDeviceSize size, VkDeviceSize texelBlockSize)
+	{
+		assert(device);
+		// Buffer to image copies need an offset that is a multiple of both the texel block size and 4, which isn't a power of two for e.g. 12 byte texels
+		const VkDeviceSize alignment = std::lcm(std::lcm(texelBlockSize, VkDeviceSize(4)), std::max(device->properties.limits.optimalBufferCopyOffsetAlignment, VkDeviceSize(1)));
+
+		Region region;
+		region.size = size;
+		if (size > this->size)
+		{
+			vks::Buffer overflow;
+			createBuffer(size, &overflow);
+			region.buffer = overflow.buffer;
+			region.data = overflow.mapped;
+			currentSpan(queue).overflowBuffers.push_back(overflow);
+			return region;
+		}
+
+		reclaim();
+		VkDeviceSize offset, consumed;
+		while (!tryAllocate(size, alignment, offset, consumed))
+		{
+			// Out of space: wait for the oldest uploads to finish and hand back their space
+			spans.front().ticket.wait();
+			reclaim();
+		}
+		// Tag the space after waiting, as waiting may have submitted the batch that was open before
+		currentSpan(queue).ringBytes += consumed;
+		region.buffer = buffer.buffer;
+		region.offset = offset;
+		region.data = static_cast<uint8_t*>(buffer.mapped) + offset;
+		return region;
+	}
+
+	/**
+	* Reserve a range of the ring and copy data into it
+	*
+	* @see allocate
+	*/
+	StagingRing::Region StagingRing::upload(VkQueue queue, const void* data, VkDeviceSize size, VkDeviceSize texelBlockSize)
+	{
+		Region region = allocate(queue, size, texelBlockSize);
+		memcpy(region.data, data, size);
+		return region;
+	}
+
+	/**
+	* Hand back the space of all uploads whose transfer batch has finished, without blocking
+	*/
+	void StagingRing::reclaim()
+	{
+		while (!spans.empty() && spans.front().ticket.finished())
+		{
+			release(spans.front());
+			spans.pop_front();
+		}
+	}
+
+	void StagingRing::release(Span& span)
+	{
+		used -= span.ringBytes;
+		for (auto& overflow : span.overflowBuffers)
+		{
+			overflow.destroy();
+		}
+	}
+}
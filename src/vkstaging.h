@@ -0,0 +1,81 @@
+/*
+* Vulkan staging ring buffer
+*
+* Persistently mapped upload buffer shared by all texture and buffer uploads of a device
+*
+* Copyright (C)
+*
+*/
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "vkbuffer.h"
+#include "vktools.h"
+#include "vktransfer.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* @brief Ring buffer for staging uploads
+	*
+	* Upload paths write their source data into ranges of one persistently mapped, host visible buffer
+	* and record their copy commands into the open batch of the device's transfer context. Ring space
+	* is tagged with the ticket of that batch and handed back once the ticket has finished.
+	*
+	* @note Acquire staging space with allocate()/upload() before fetching the command buffer from the transfer context,
+	* as running out of ring space submits the open batch and starts a new command buffer
+	*/
+	class StagingRing
+	{
+	public:
+		/** @brief Range of the ring buffer to copy from */
+		struct Region
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			/** @brief Host pointer to the start of the region */
+			void* data = nullptr;
+		};
+
+		static constexpr VkDeviceSize defaultSize = 64ull * 1024 * 1024;
+
+		void prepare(vks::VulkanDevice* device, VkDeviceSize size = defaultSize);
+		void destroy();
+
+		Region allocate(VkQueue queue, VkDeviceSize size, VkDeviceSize texelBlockSize = 4);
+		Region upload(VkQueue queue, const void* data, VkDeviceSize size, VkDeviceSize texelBlockSize = 4);
+		void reclaim();
+
+	private:
+		/** @brief Ring space used by the uploads of one transfer batch */
+		struct Span
+		{
+			vks::TransferTicket ticket;
+			/** @brief Ring bytes (including alignment and wrap padding) consumed by the batch */
+			VkDeviceSize ringBytes = 0;
+			/** @brief Temporary staging buffers for uploads that are larger than the whole ring */
+			std::vector<vks::Buffer> overflowBuffers;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		vks::Buffer buffer;
+		VkDeviceSize size = 0;
+		/** @brief Next free byte of the ring */
+		VkDeviceSize head = 0;
+		/** @brief Bytes between the oldest in-flight byte and head */
+		VkDeviceSize used = 0;
+		std::deque<Span> spans;
+
+		void createBuffer(VkDeviceSize size, vks::Buffer* target);
+		Span& currentSpan(VkQueue queue);
+		bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, VkDeviceSize& consumed);
+		void release(Span& span);
+	};
+}
@@ -19,8 +19,6 @@
 /** @brief Creates the platform specific surface abstraction of the native platform window used for presentation */
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 void VulkanSwapChain::initSurface(void* platformHandle, void* platformWindow)
- 
-#endif
 {
 	VkResult err = VK_SUCCESS;
 
@@ -145,6 +143,7 @@ void VulkanSwapChain::initSurface(void* platformHandle, void* platformWindow)
 	}
 
 }
+#endif
 
 /**
 * Set instance, physical and logical device to use for the swapchain and get all required function pointers
@@ -36,7 +36,7 @@ namespace vks
 		vks::VulkanDevice* device;
 		VkImage               image;
 		VkImageLayout         imageLayout;
-		VkDeviceMemory        deviceMemory;
+		vks::Allocation       allocation;
 		VkImageView           view;
 		uint32_t              width, height;
 		uint32_t              mipLevels;
@@ -60,6 +60,14 @@ namespace vks
 			VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 			VkImageLayout      imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			bool               forceLinear = false);
+		void fromKtxTexture(
+			ktxTexture*        ktxTexture,
+			VkFormat           format,
+			vks::VulkanDevice* device,
+			VkQueue            copyQueue,
+			VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+			VkImageLayout      imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			bool               forceLinear = false);
 		void fromBuffer(
 			void* buffer,
 			VkDeviceSize       bufferSize,
@@ -0,0 +1,152 @@
+/*
+* Worker thread pool
+*
+* Fixed set of worker threads that run jobs from a shared queue
+*
+* Copyright (C)
+*
+*/
+
+#include "vkthreadpool.h"
+
+namespace vks
+{
+	/**
+	* Count a job that has been added to the group
+	*/
+	void JobGroup::add()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending++;
+	}
+
+	/**
+	* Mark a job of the group as finished
+	*/
+	void JobGroup::done()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--pending == 0)
+		{
+			idle.notify_all();
+		}
+	}
+
+	/**
+	* Block until all jobs added to the group so far have finished
+	*/
+	void JobGroup::wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this] { return pending == 0; });
+	}
+
+	/**
+	* Start the worker threads
+	*
+	* @param threadCount Number of workers, 0 uses one less than the number of hardware threads so the main thread keeps a core
+	*/
+	void ThreadPool::prepare(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+		{
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+		stopping = false;
+		threads.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			threads.emplace_back(&ThreadPool::run, this);
+		}
+	}
+
+	/**
+	* Finish all queued jobs and join the worker threads
+	*/
+	void ThreadPool::destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		threads.clear();
+	}
+
+	/**
+	* Queue a job for the next idle worker
+	*/
+	void ThreadPool::push(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(std::move(job));
+			outstanding++;
+		}
+		jobAvailable.notify_one();
+	}
+
+	/**
+	* Queue a job that is part of a group, so its caller can wait for the group instead of the whole pool
+	*/
+	void ThreadPool::push(std::function<void()> job, JobGroup& group)
+	{
+		group.add();
+		push([job = std::move(job), &group]
+		{
+			job();
+			group.done();
+		});
+	}
+
+	/**
+	* Block until all jobs pushed so far have finished
+	*
+	* @note Must not be called from a job of this pool
+	*/
+	void ThreadPool::wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this] { return outstanding == 0; });
+	}
+
+	/**
+	* @return Number of worker threads
+	*/
+	uint32_t ThreadPool::size() const
+	{
+		return static_cast<uint32_t>(threads.size());
+	}
+
+	void ThreadPool::run()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+				// Queued jobs are drained before shutting down, so destroy() never drops work
+				if (jobs.empty())
+				{
+					return;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--outstanding == 0)
+				{
+					idle.notify_all();
+				}
+			}
+		}
+	}
+}
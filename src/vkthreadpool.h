@@ -0,0 +1,73 @@
+/*
+* Worker thread pool
+*
+* Fixed set of worker threads that run jobs from a shared queue
+*
+* Copyright (C)
+*
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vks
+{
+	/**
+	* @brief Jobs of a pool that can be waited for on their own
+	*
+	* Lets a caller wait for the jobs it pushed without waiting for the jobs others pushed to a shared pool
+	*/
+	class JobGroup
+	{
+	public:
+		void add();
+		void done();
+		void wait();
+
+	private:
+		std::mutex mutex;
+		/** @brief Signaled when the last job of the group has finished */
+		std::condition_variable idle;
+		uint32_t pending = 0;
+	};
+
+	/**
+	* @brief Pool of worker threads for CPU side jobs
+	*
+	* Jobs are pushed to a single queue and picked up by whichever worker is idle, so the pool
+	* is suited for many small, independent jobs like decoding the images of a model.
+	*
+	* @note Jobs must not block on other jobs of the same pool, as all workers may be waiting then
+	*/
+	class ThreadPool
+	{
+	public:
+		void prepare(uint32_t threadCount = 0);
+		void destroy();
+
+		void push(std::function<void()> job);
+		void push(std::function<void()> job, JobGroup& group);
+		void wait();
+		uint32_t size() const;
+
+	private:
+		std::vector<std::thread> threads;
+		std::deque<std::function<void()>> jobs;
+		std::mutex mutex;
+		/** @brief Signaled when a job was pushed or the pool is shutting down */
+		std::condition_variable jobAvailable;
+		/** @brief Signaled when the last outstanding job has finished */
+		std::condition_variable idle;
+		/** @brief Jobs that have been pushed but have not finished yet */
+		uint32_t outstanding = 0;
+		bool stopping = false;
+
+		void run();
+	};
+}
@@ -71,6 +71,9 @@ namespace vks
 		// Returns if a given format support LINEAR filtering
 		VkBool32 formatIsFilterable(VkPhysicalDevice physicalDevice, VkFormat format, VkImageTiling tiling);
 
+		/** @brief Returns the size in bytes of a texel (or compressed block) of a color format, buffer offsets of buffer to image copies have to be a multiple of it */
+		uint32_t formatTexelBlockSize(VkFormat format);
+
 		// Put an image memory barrier for setting an image layout on the sub resource into the given command buffer
 		void setImageLayout(
 			VkCommandBuffer cmdbuffer,
@@ -113,5 +116,26 @@ namespace vks
 		bool fileExists(const std::string& filename);
 
 		uint32_t alignedSize(uint32_t value, uint32_t alignment);
+
+		/** @brief Read only memory mapping of a whole file, unmapped on close() or destruction */
+		class MappedFile
+		{
+		public:
+			MappedFile() = default;
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			~MappedFile();
+			bool open(const std::string& filename);
+			void close();
+			const unsigned char* data() const { return mapped; }
+			size_t size() const { return mappedSize; }
+		private:
+			const unsigned char* mapped = nullptr;
+			size_t mappedSize = 0;
+#if defined(_WIN32)
+			HANDLE file = INVALID_HANDLE_VALUE;
+			HANDLE mapping = nullptr;
+#endif
+		};
 	}
 }
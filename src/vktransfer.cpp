@@ -0,0 +1,378 @@
+/*
+* Vulkan transfer context
+*
+* Collects upload command recordings into batched submits with pooled command buffers and fences
+*
+* Copyright (C)
+*
+*/
+
+#include "vktransfer.h"
+#include "vkdevice.h"
+
+namespace vks
+{
+	/**
+	* @return True if the batch of this ticket has been handed to the queue
+	*/
+	bool TransferTicket::submitted() const
+	{
+		return !context || context->submitted(value);
+	}
+
+	/**
+	* @return True if the batch of this ticket has finished executing (does not block)
+	*/
+	bool TransferTicket::finished() const
+	{
+		return !context || context->finished(value);
+	}
+
+	/**
+	* Block until the batch of this ticket has finished executing, submits the batch first if it is still recording
+	*/
+	void TransferTicket::wait() const
+	{
+		if (context)
+		{
+			context->wait(value);
+		}
+	}
+
+	/**
+	* Create the command pool the batches are allocated from
+	*
+	* @param device Vulkan device to submit the batches on
+	* @param queueFamilyIndex Family of the queues the batches will be submitted to
+	*/
+	void TransferContext::prepare(vks::VulkanDevice* device, uint32_t queueFamilyIndex)
+	{
+		this->device = device;
+		this->queueFamilyIndex = queueFamilyIndex;
+		commandPool = device->createCommandPool(queueFamilyIndex);
+	}
+
+	/**
+	* Wait for all outstanding batches and release the pooled command buffers and fences
+	*/
+	void TransferContext::destroy()
+	{
+		if (!device)
+		{
+			return;
+		}
+		waitIdle();
+		for (auto& batch : freeBatches)
+		{
+			vkDestroyFence(device->logicalDevice, batch.fence, nullptr);
+		}
+		freeBatches.clear();
+		for (auto semaphore : freeSemaphores)
+		{
+			vkDestroySemaphore(device->logicalDevice, semaphore, nullptr);
+		}
+		freeSemaphores.clear();
+		// Destroying the pool also frees the command buffers allocated from it
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		device = nullptr;
+	}
+
+	/**
+	* Open a new batch if none is recording, submit the open one first if it targets another queue
+	*/
+	void TransferContext::beginBatch(VkQueue queue)
+	{
+		if (recording && queue != this->queue)
+		{
+			submit();
+		}
+		if (recording)
+		{
+			return;
+		}
+		retireCompleted();
+		if (!freeBatches.empty())
+		{
+			current = std::move(freeBatches.back());
+			freeBatches.pop_back();
+		}
+		else
+		{
+			current.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, false);
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &current.fence));
+		}
+		current.value = nextValue++;
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(current.commandBuffer, &cmdBufInfo));
+		this->queue = queue;
+		recording = true;
+	}
+
+	/**
+	* Get the command buffer of the open batch, opens a new batch if none is recording
+	*
+	* @param queue Queue the batch will be submitted to
+	*
+	* @return Command buffer in the recording state
+	*/
+	VkCommandBuffer TransferContext::getCommandBuffer(VkQueue queue)
+	{
+		assert(device);
+		beginBatch(queue);
+		return current.commandBuffer;
+	}
+
+	/**
+	* Get a ticket for the open batch, opens a new batch if none is recording
+	*
+	* @param queue Queue the batch will be submitted to
+	*
+	* @return Ticket that finishes together with the commands recorded into the current command buffer
+	*/
+	TransferTicket TransferContext::currentTicket(VkQueue queue)
+	{
+		assert(device);
+		beginBatch(queue);
+		return TransferTicket{ this, current.value };
+	}
+
+	/**
+	* Submit all commands recorded since the last submit as one batch, does not wait for completion
+	*
+	* @return Ticket of the submitted batch, or of the last submitted batch if nothing has been recorded since
+	*/
+	TransferTicket TransferContext::submit()
+	{
+		if (!recording)
+		{
+			return TransferTicket{ this, nextValue - 1 };
+		}
+		// Binary semaphores must have their signal submitted before the wait
+		for (auto& dependency : current.dependencies)
+		{
+			if (!dependency.submitted())
+			{
+				dependency.context->submit();
+			}
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(current.commandBuffer));
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &current.commandBuffer;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(current.waitSemaphores.size());
+		submitInfo.pWaitSemaphores = current.waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = current.waitStageMasks.data();
+		if (current.signalSemaphore != VK_NULL_HANDLE)
+		{
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &current.signalSemaphore;
+		}
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, current.fence));
+		TransferTicket ticket{ this, current.value };
+		inFlight.push_back(std::move(current));
+		current = Batch();
+		recording = false;
+		return ticket;
+	}
+
+	bool TransferContext::submitted(uint64_t value) const
+	{
+		return !recording || value < current.value;
+	}
+
+	/**
+	* Add a semaphore wait to the open batch, reusing the semaphore if the batch already waits on it
+	*
+	* @return Semaphore the producer has to signal
+	*/
+	VkSemaphore TransferContext::waitFor(VkQueue queue, VkSemaphore semaphore, VkPipelineStageFlags stageMask, TransferTicket producer)
+	{
+		beginBatch(queue);
+		for (size_t i = 0; i < current.waitSemaphores.size(); i++)
+		{
+			if (current.waitSemaphores[i] == semaphore)
+			{
+				current.waitStageMasks[i] |= stageMask;
+				return semaphore;
+			}
+		}
+		if (!freeSemaphores.empty())
+		{
+			semaphore = freeSemaphores.back();
+			freeSemaphores.pop_back();
+		}
+		else
+		{
+			VkSemaphoreCreateInfo semaphoreInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreInfo, nullptr, &semaphore));
+		}
+		current.waitSemaphores.push_back(semaphore);
+		current.waitStageMasks.push_back(stageMask);
+		current.dependencies.push_back(producer);
+		return semaphore;
+	}
+
+	/**
+	* Transfer queue family ownership of uploaded resources to another context
+	*
+	* Records the release barriers into the open batch of this context and the matching acquire barriers into the open batch of dst.
+	* The dst batch waits on a semaphore signaled by this batch and submits this batch first if it is still recording.
+	*
+	* @param queue Queue this context's batch is submitted to
+	* @param dst Context of the queue family that takes over the resources
+	* @param dstQueue Queue the dst batch is submitted to
+	* @param dstStageMask Pipeline stages that first access the resources on the dst queue
+	* @param bufferMemoryBarrierCount Number of buffer barriers
+	* @param pBufferMemoryBarriers Buffer barriers with srcAccessMask set to the upload writes and dstAccessMask to the first access on the dst queue
+	* @param imageMemoryBarrierCount Number of image barriers
+	* @param pImageMemoryBarriers Image barriers as above, the layout transition is part of the hand-off
+	*
+	* @note Queue family indices of the barriers are filled in, the release is made after the transfer stage of this batch
+	* @note All hand-offs of one batch must go to the same dst context, as a batch signals a single semaphore
+	*/
+	void TransferContext::handOff(
+		VkQueue                      queue,
+		TransferContext&             dst,
+		VkQueue                      dstQueue,
+		VkPipelineStageFlags         dstStageMask,
+		uint32_t                     bufferMemoryBarrierCount,
+		const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+		uint32_t                     imageMemoryBarrierCount,
+		const VkImageMemoryBarrier*  pImageMemoryBarriers)
+	{
+		// Open the dst batch first, switching its queue submits its old batch along with the batches it depends on
+		VkCommandBuffer acquireCmd = dst.getCommandBuffer(dstQueue);
+		VkCommandBuffer releaseCmd = getCommandBuffer(queue);
+		current.signalSemaphore = dst.waitFor(dstQueue, current.signalSemaphore, dstStageMask, TransferTicket{ this, current.value });
+
+		std::vector<VkBufferMemoryBarrier> bufferBarriers(pBufferMemoryBarriers, pBufferMemoryBarriers + bufferMemoryBarrierCount);
+		std::vector<VkImageMemoryBarrier> imageBarriers(pImageMemoryBarriers, pImageMemoryBarriers + imageMemoryBarrierCount);
+
+		// Release: make the writes available, the access mask of the other family is ignored
+		for (auto& barrier : bufferBarriers)
+		{
+			barrier.srcQueueFamilyIndex = queueFamilyIndex;
+			barrier.dstQueueFamilyIndex = dst.queueFamilyIndex;
+		}
+		for (auto& barrier : imageBarriers)
+		{
+			barrier.srcQueueFamilyIndex = queueFamilyIndex;
+			barrier.dstQueueFamilyIndex = dst.queueFamilyIndex;
+		}
+		std::vector<VkBufferMemoryBarrier> releaseBuffers(bufferBarriers);
+		std::vector<VkImageMemoryBarrier> releaseImages(imageBarriers);
+		for (auto& barrier : releaseBuffers)
+		{
+			barrier.dstAccessMask = 0;
+		}
+		for (auto& barrier : releaseImages)
+		{
+			barrier.dstAccessMask = 0;
+		}
+		vkCmdPipelineBarrier(releaseCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr,
+			static_cast<uint32_t>(releaseBuffers.size()), releaseBuffers.data(),
+			static_cast<uint32_t>(releaseImages.size()), releaseImages.data());
+
+		// Acquire: make the writes visible, the semaphore wait orders it after the release
+		// The barrier's src stages are the stages the wait blocks (dstStageMask), so the acquire and its layout transition
+		// can't start before the semaphore has been signaled, the release's writes were made available before the signal
+		for (auto& barrier : bufferBarriers)
+		{
+			barrier.srcAccessMask = 0;
+		}
+		for (auto& barrier : imageBarriers)
+		{
+			barrier.srcAccessMask = 0;
+		}
+		vkCmdPipelineBarrier(acquireCmd, dstStageMask, dstStageMask, 0,
+			0, nullptr,
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	/**
+	* @return True if the batch with the given value has finished executing (does not block)
+	*/
+	bool TransferContext::finished(uint64_t value)
+	{
+		if (value > completedValue)
+		{
+			retireCompleted();
+		}
+		return value <= completedValue;
+	}
+
+	/**
+	* Block until the batch with the given value has finished executing
+	*
+	* @note Submits the open batch first if the value belongs to it
+	*/
+	void TransferContext::wait(uint64_t value)
+	{
+		if (!submitted(value))
+		{
+			submit();
+		}
+		while (completedValue < value && !inFlight.empty())
+		{
+			retireOldest();
+		}
+	}
+
+	/**
+	* Submit pending commands and block until all batches have finished
+	*/
+	void TransferContext::waitIdle()
+	{
+		submit();
+		while (!inFlight.empty())
+		{
+			retireOldest();
+		}
+	}
+
+	/**
+	* @return True if commands have been recorded that are not submitted yet
+	*/
+	bool TransferContext::pending() const
+	{
+		return recording;
+	}
+
+	void TransferContext::retire(Batch& batch)
+	{
+		completedValue = batch.value;
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &batch.fence));
+		VK_CHECK_RESULT(vkResetCommandBuffer(batch.commandBuffer, 0));
+		// The waits have completed, so the semaphores are unsignaled and can be handed out again
+		freeSemaphores.insert(freeSemaphores.end(), batch.waitSemaphores.begin(), batch.waitSemaphores.end());
+		batch.waitSemaphores.clear();
+		batch.waitStageMasks.clear();
+		batch.dependencies.clear();
+		batch.signalSemaphore = VK_NULL_HANDLE;
+		freeBatches.push_back(std::move(batch));
+	}
+
+	/**
+	* Recycle all batches that have already finished, without blocking
+	*/
+	void TransferContext::retireCompleted()
+	{
+		while (!inFlight.empty() && vkGetFenceStatus(device->logicalDevice, inFlight.front().fence) == VK_SUCCESS)
+		{
+			retire(inFlight.front());
+			inFlight.pop_front();
+		}
+	}
+
+	void TransferContext::retireOldest()
+	{
+		assert(!inFlight.empty());
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &inFlight.front().fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+		retire(inFlight.front());
+		inFlight.pop_front();
+	}
+}
@@ -0,0 +1,121 @@
+/*
+* Vulkan transfer context
+*
+* Collects upload command recordings into batched submits with pooled command buffers and fences
+*
+* Copyright (C)
+*
+*/
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "vktools.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+	class TransferContext;
+
+	/**
+	* @brief Waitable handle to a batch of a transfer context
+	*
+	* Batch values increase monotonically and batches complete in submission order,
+	* so a ticket is finished once the context's completed value has reached it
+	*/
+	struct TransferTicket
+	{
+		/** @brief Context the batch belongs to, nullptr for an empty ticket */
+		TransferContext* context = nullptr;
+		/** @brief Value of the batch, 0 for an empty ticket (always finished) */
+		uint64_t value = 0;
+
+		operator bool() const
+		{
+			return value != 0;
+		}
+		bool submitted() const;
+		bool finished() const;
+		void wait() const;
+	};
+
+	/**
+	* @brief Batched submission of upload commands
+	*
+	* Upload paths record into the command buffer of the currently open batch instead of
+	* creating, submitting and waiting on their own one-off command buffer. All recordings
+	* made between two submits go to the queue with a single vkQueueSubmit. Command buffers
+	* and fences are recycled once their batch has finished, and submit() returns a ticket
+	* so callers only block when they actually need the result.
+	*
+	* Resources uploaded on one queue family can be handed to a context of another family with handOff(),
+	* which records the queue family ownership release and acquire barriers and chains the two batches
+	* with a semaphore.
+	*
+	* @note Command buffers are allocated from a pool of the family passed to prepare(), so all queues used with a context must be of that family
+	*/
+	class TransferContext
+	{
+	public:
+		void prepare(vks::VulkanDevice* device, uint32_t queueFamilyIndex);
+		void destroy();
+
+		VkCommandBuffer getCommandBuffer(VkQueue queue);
+		TransferTicket currentTicket(VkQueue queue);
+		TransferTicket submit();
+		bool submitted(uint64_t value) const;
+		bool finished(uint64_t value);
+		void wait(uint64_t value);
+		void waitIdle();
+		bool pending() const;
+		void handOff(
+			VkQueue                      queue,
+			TransferContext&             dst,
+			VkQueue                      dstQueue,
+			VkPipelineStageFlags         dstStageMask,
+			uint32_t                     bufferMemoryBarrierCount,
+			const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+			uint32_t                     imageMemoryBarrierCount,
+			const VkImageMemoryBarrier*  pImageMemoryBarriers);
+
+		/** @brief Queue family the batches of this context are submitted to */
+		uint32_t queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+	private:
+		struct Batch
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			uint64_t value = 0;
+			/** @brief Semaphores of hand-offs from other contexts, owned by this context and recycled when the batch retires */
+			std::vector<VkSemaphore> waitSemaphores;
+			std::vector<VkPipelineStageFlags> waitStageMasks;
+			/** @brief Batches of other contexts that signal the wait semaphores and have to be submitted first */
+			std::vector<TransferTicket> dependencies;
+			/** @brief Semaphore signaled for the context this batch hands resources off to */
+			VkSemaphore signalSemaphore = VK_NULL_HANDLE;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkQueue queue = VK_NULL_HANDLE;
+		bool recording = false;
+		Batch current;
+		std::deque<Batch> inFlight;
+		std::vector<Batch> freeBatches;
+		std::vector<VkSemaphore> freeSemaphores;
+		/** @brief Value handed to the next batch that is opened */
+		uint64_t nextValue = 1;
+		/** @brief Value of the most recent batch known to have finished */
+		uint64_t completedValue = 0;
+
+		void beginBatch(VkQueue queue);
+		VkSemaphore waitFor(VkQueue queue, VkSemaphore semaphore, VkPipelineStageFlags stageMask, TransferTicket producer);
+		void retire(Batch& batch);
+		void retireCompleted();
+		void retireOldest();
+	};
+}